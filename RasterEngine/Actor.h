@@ -10,5 +10,8 @@ public:
 	void Update() override;
 	void Render() override;
 	void Destroy() override;
+
+	// Handle of this actor in the engines actor pool, set by GEngine::Spawn.
+	PoolHandle Handle;
 };
 
@@ -0,0 +1,52 @@
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+	// Only the threads being checked count, workers and the window thread allocate as they please.
+	thread_local bool IsCounting = false;
+	thread_local size_t Count = 0;
+
+	void* Allocate(const size_t Size) {
+		if (IsCounting) Count++;
+
+		// Zero sized allocations still have to return a unique pointer.
+		if (auto* memory = std::malloc(Size ? Size : 1)) return memory;
+		throw std::bad_alloc();
+	}
+}
+
+void* operator new(const size_t Size) {
+	return Allocate(Size);
+}
+
+void* operator new[](const size_t Size) {
+	return Allocate(Size);
+}
+
+void operator delete(void* Memory) noexcept {
+	std::free(Memory);
+}
+
+void operator delete[](void* Memory) noexcept {
+	std::free(Memory);
+}
+
+void operator delete(void* Memory, size_t) noexcept {
+	std::free(Memory);
+}
+
+void operator delete[](void* Memory, size_t) noexcept {
+	std::free(Memory);
+}
+
+void AllocationCounter::Begin() {
+	Count = 0;
+	IsCounting = true;
+}
+
+size_t AllocationCounter::End() {
+	IsCounting = false;
+	return Count;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+
+/**
+ * \brief Counts the calls a thread makes to the global operator new, to check that steady state frames stay off the
+ * heap. The engine replaces operator new and delete with ones that forward to malloc and free, so counting works in
+ * every build and costs a thread local flag test per allocation when nothing is counted.
+ */
+class AllocationCounter
+{
+public:
+	/**
+	 * \brief Starts counting the allocations of the calling thread from 0.
+	 */
+	static void Begin();
+
+	/**
+	 * \brief Stops counting on the calling thread.
+	 * \return Allocations made since Begin.
+	 */
+	static size_t End();
+};
@@ -3,19 +3,34 @@
 #include "Component.h"
 #include "StaticMeshComponent.h"
 
-BaseObject::BaseObject(): Id(-1) {
-	GEngine::Get()->StartEvent.Subscribe(L"Test", [&]{ Start(); });
-	GEngine::Get()->UpdateEvent.Subscribe(L"Test", [&]{ Update(); });
-	GEngine::Get()->RenderEvent.Subscribe(L"Test", [&]{ Render(); });
-	GEngine::Get()->DestroyEvent.Subscribe(L"Test", [&]{ Destroy(); });
+BaseObject::BaseObject(): IsStatic(false), SpatialSlot(SpatialIndex::InvalidSlot), Id(-1), TransformNode(GEngine::Get()->Transforms.Create(this)) {
+	SubscribeEvents();
 }
 
-BaseObject::~BaseObject() = default;
+BaseObject::~BaseObject() {
+	auto* engine = GEngine::Get();
+	engine->StartEvent.Unsubscribe(StartHandle);
+	engine->UpdateEvent.Unsubscribe(UpdateHandle);
+	engine->RenderEvent.Unsubscribe(RenderHandle);
+	engine->DestroyEvent.Unsubscribe(DestroyHandle);
+	engine->Transforms.Destroy(TransformNode);
 
-BaseObject::BaseObject(const BaseObject& Other) = default;
+	// Hand back components of objects that were never destroyed through the engine.
+	BaseObject::Destroy();
+}
+
+// Components belong to the object that added them, copies start without any.
+BaseObject::BaseObject(const BaseObject& Other): IsStatic(Other.IsStatic), SpatialSlot(SpatialIndex::InvalidSlot), Id(Other.Id) {
+	SubscribeEvents();
+	CopyTransform(Other);
+}
 
 BaseObject::BaseObject(BaseObject&& Other) noexcept {
 	this->Id = Other.Id;
+	this->IsStatic = Other.IsStatic;
+	this->SpatialSlot = SpatialIndex::InvalidSlot;
+	SubscribeEvents();
+	CopyTransform(Other);
 }
 
 BaseObject& BaseObject::operator=(const BaseObject& Other) {
@@ -29,26 +44,32 @@ BaseObject& BaseObject::operator=(BaseObject&& Other) noexcept {
 
 void BaseObject::Start() {
 	for (const auto& component : Components) {
-		component->Start();
+		component.Instance->Start();
 	}
 }
 
 void BaseObject::Update() {
 	for (const auto& component : Components) {
-		component->Update();
+		component.Instance->Update();
 	}
 }
 
 void BaseObject::Render() {
 	for (const auto& component : Components) {
-		component->Render();
+		component.Instance->Render();
+	}
+}
+
+void BaseObject::RenderOcclusion() {
+	for (const auto& component : Components) {
+		component.Instance->RenderOcclusion();
 	}
 }
 
 void BaseObject::Destroy() {
 	for (const auto& component : Components) {
-		component->Destroy();
-		delete component;
+		component.Instance->Destroy();
+		component.Release(component.Handle);
 	}
 	Components.clear();
 }
@@ -61,15 +82,95 @@ void BaseObject::SetId(const int Id) {
 	this->Id = Id;
 }
 
-Component* BaseObject::AddComponent(Component* C) {
-	C->SetParent(this);
+Component* BaseObject::GetComponent(const unsigned Index) const {
+	if(Index >= Components.size()) { throw std::exception("Array out of bounds"); }
 
-	Components.emplace_back(C);
-	return Components.back();
+	return Components[Index].Instance;
 }
 
-Component* BaseObject::GetComponent(const unsigned Index) const {
-	if(Index > Components.size()) { throw std::exception("Array out of bounds"); }
+bool BaseObject::GetWorldBounds(Aabb& Bounds) const {
+	Bounds = Aabb();
+
+	for (const auto& component : Components) {
+		Aabb local;
+		if (component.Instance->GetLocalBounds(local)) Bounds.Grow(local.GetTransformed(GetWorldTransform()));
+	}
+
+	return !Bounds.IsEmpty();
+}
+
+bool BaseObject::Raycast(const Vec3F& Origin, const Vec3F& Direction, RayHit& Hit) {
+	auto isHit = false;
+	for (const auto& component : Components) {
+		if (component.Instance->Raycast(Origin, Direction, Hit)) isHit = true;
+	}
+
+	if (isHit) Hit.Object = this;
+	return isHit;
+}
+
+void BaseObject::SetParent(BaseObject* const Parent) {
+	auto& transforms = GEngine::Get()->Transforms;
+	transforms.SetParent(TransformNode, Parent ? Parent->TransformNode : TransformHierarchy::InvalidNode);
+}
+
+BaseObject* BaseObject::GetParent() const {
+	auto& transforms = GEngine::Get()->Transforms;
+	return transforms.GetOwner(transforms.GetParent(TransformNode));
+}
+
+void BaseObject::SetTransform(const Transform& Local) {
+	GEngine::Get()->Transforms.SetLocal(TransformNode, Local);
+}
+
+const Transform& BaseObject::GetTransform() const {
+	return GEngine::Get()->Transforms.GetLocal(TransformNode);
+}
+
+void BaseObject::SetPosition(const Vec3F& Position) {
+	auto local = GetTransform();
+	local.Translation = Position;
+	SetTransform(local);
+}
+
+void BaseObject::SetRotation(const Quat& Rotation) {
+	auto local = GetTransform();
+	local.Rotation = Rotation;
+	SetTransform(local);
+}
+
+void BaseObject::SetScale(const Vec3F& Scale) {
+	auto local = GetTransform();
+	local.Scale = Scale;
+	SetTransform(local);
+}
+
+Vec3F BaseObject::GetPosition() const {
+	return GetTransform().Translation;
+}
+
+Quat BaseObject::GetRotation() const {
+	return GetTransform().Rotation;
+}
+
+Vec3F BaseObject::GetScale() const {
+	return GetTransform().Scale;
+}
+
+const Mat4& BaseObject::GetWorldTransform() const {
+	return GEngine::Get()->Transforms.GetWorld(TransformNode);
+}
+
+void BaseObject::SubscribeEvents() {
+	auto* engine = GEngine::Get();
+	StartHandle = engine->StartEvent.Subscribe([this] { Start(); });
+	UpdateHandle = engine->UpdateEvent.Subscribe([this] { Update(); });
+	RenderHandle = engine->RenderEvent.Subscribe([this] { Render(); });
+	DestroyHandle = engine->DestroyEvent.Subscribe([this] { Destroy(); });
+}
 
-	return Components[Index];
+void BaseObject::CopyTransform(const BaseObject& Other) {
+	auto& transforms = GEngine::Get()->Transforms;
+	TransformNode = transforms.Create(this, transforms.GetParent(Other.TransformNode));
+	transforms.SetLocal(TransformNode, Other.GetTransform());
 }
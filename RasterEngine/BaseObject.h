@@ -9,6 +9,8 @@
 
 #include "Component.h"
 #include "EngineDefines.h"
+#include "Event.h"
+#include "ObjectPool.h"
 
 class BaseObject
 {
@@ -28,18 +30,107 @@ public:
 	virtual void Render();
 	virtual void Destroy();
 
+	/**
+	 * \brief Lets every component draw its occluders, called by the engine before rendering each frame.
+	 */
+	virtual void RenderOcclusion();
+
 	int GetId() const;
 	void SetId(int Id);
 
-	Component* AddComponent(Component* C);
+	/**
+	 * \brief Creates a component in the shared pool of its type and attaches it to this object, which owns it from
+	 * then on and gives it back to the pool in Destroy.
+	 * \param Arguments Passed on to the constructor of the component.
+	 * \return The new component.
+	 */
+	template<typename T, typename... Args>
+	T* AddComponent(Args&&... Arguments) {
+		auto& pool = ObjectPool<T>::GetShared();
+		const auto handle = pool.Create(std::forward<Args>(Arguments)...);
+		auto* component = pool.Get(handle);
+		component->SetParent(this);
+
+		const auto release = [](const PoolHandle& Handle) { ObjectPool<T>::GetShared().Destroy(Handle); };
+		Components.push_back({component, handle, release});
+		return component;
+	}
+
 	Component* GetComponent(unsigned Index) const;
 
-	Mat4 WorldTransform;
+	/**
+	 * \brief Gets the world space box around the bounds of every component.
+	 * \return False if no component takes up any space.
+	 */
+	bool GetWorldBounds(Aabb& Bounds) const;
+
+	/**
+	 * \brief Finds where a world space ray first hits any component.
+	 * \param Hit Limits the query to Hit.Distance and receives the closest hit nearer than that, with Object set to
+	 * this object.
+	 * \return True if Hit was updated.
+	 */
+	bool Raycast(const Vec3F& Origin, const Vec3F& Direction, RayHit& Hit);
+
+	/**
+	 * \brief Attaches this object to another so it follows it, keeping its local transform.
+	 * \param Parent Object to attach to, or nullptr to detach it.
+	 */
+	void SetParent(BaseObject* Parent);
+	BaseObject* GetParent() const;
+
+	/**
+	 * \brief Sets the scale, rotation and translation relative to the parent, or to the world without one.
+	 */
+	void SetTransform(const Transform& Local);
+	const Transform& GetTransform() const;
+
+	void SetPosition(const Vec3F& Position);
+	void SetRotation(const Quat& Rotation);
+	void SetScale(const Vec3F& Scale);
+
+	Vec3F GetPosition() const;
+	Quat GetRotation() const;
+	Vec3F GetScale() const;
+
+	/**
+	 * \brief Gets the matrix from the space of this object to world space, only recomputed after it or a parent moved.
+	 */
+	const Mat4& GetWorldTransform() const;
+
+	// Static objects are expected not to move, the spatial index only rebuilds their bounds when invalidated.
+	bool IsStatic;
+
+	// Slot of this object in the engines spatial index, kept by SpatialIndex so removing the object needs no search.
+	unsigned SpatialSlot;
 
 private:
 	int Id;
 
-	std::vector<Component*> Components;
+	// Node of this object in the engines transform hierarchy.
+	unsigned TransformNode;
+
+	// Subscriptions to the engine events, removed again when the object is deleted.
+	EventHandle StartHandle;
+	EventHandle UpdateHandle;
+	EventHandle RenderHandle;
+	EventHandle DestroyHandle;
+
+	void SubscribeEvents();
+
+	/**
+	 * \brief Creates the transform node of a copy of an object, with the same parent and local transform.
+	 */
+	void CopyTransform(const BaseObject& Other);
+
+	// Components with the handle and pool to give them back to.
+	struct OwnedComponent {
+		Component* Instance;
+		PoolHandle Handle;
+		void (*Release)(const PoolHandle& Handle);
+	};
+
+	std::vector<OwnedComponent> Components;
 };
 
 
@@ -0,0 +1,184 @@
+#include "Bvh.h"
+
+#include <algorithm>
+
+namespace {
+	float GetAxis(const Vec3F& V, const unsigned Axis) {
+		return Axis == 0 ? V.X : Axis == 1 ? V.Y : V.Z;
+	}
+
+	unsigned GetBin(const float Center, const float MinCenter, const float BinScale) {
+		const auto bin = (unsigned)((Center - MinCenter) * BinScale);
+		return bin < Bvh::BinCount ? bin : Bvh::BinCount - 1;
+	}
+
+	float GetGrowth(const Aabb& Bounds, const Aabb& Box) {
+		auto grown = Bounds;
+		grown.Grow(Box);
+		return grown.GetSurfaceArea() - Bounds.GetSurfaceArea();
+	}
+}
+
+void Bvh::Build(const std::vector<Aabb>& Boxes, const float ItemCost) {
+	Clear();
+	if (Boxes.empty()) return;
+
+	const auto count = (unsigned)Boxes.size();
+	Items.resize(count);
+	std::vector<Vec3F> centers(count);
+	for (unsigned i = 0; i < count; ++i) {
+		Items[i] = i;
+		centers[i] = Boxes[i].GetCenter();
+	}
+
+	Nodes.reserve(count * 2);
+	Nodes.push_back({{}, 0, count});
+
+	struct Task {
+		unsigned NodeIndex;
+		unsigned Depth;
+	};
+	std::vector<Task> tasks = {{0, 0}};
+
+	while (!tasks.empty()) {
+		const auto task = tasks.back();
+		tasks.pop_back();
+
+		const auto first = Nodes[task.NodeIndex].First;
+		const auto itemCount = Nodes[task.NodeIndex].Count;
+
+		Aabb bounds, centerBounds;
+		for (auto i = first; i < first + itemCount; ++i) {
+			bounds.Grow(Boxes[Items[i]]);
+			centerBounds.Grow(centers[Items[i]]);
+		}
+		Nodes[task.NodeIndex].Bounds = bounds;
+
+		if (itemCount <= 1 || task.Depth + 1 >= MaxDepth) continue;
+
+		// Sort the item centers into bins along each axis and sweep the planes between bins for the cheapest split.
+		auto bestCost = FLT_MAX;
+		unsigned bestAxis = 0, bestPlane = 0;
+		for (unsigned axis = 0; axis < 3; ++axis) {
+			const auto minCenter = GetAxis(centerBounds.Min, axis);
+			const auto extent = GetAxis(centerBounds.Max, axis) - minCenter;
+			if (extent <= 0.0f) continue;
+
+			const auto binScale = (float)BinCount / extent;
+			Aabb binBounds[BinCount];
+			unsigned binCounts[BinCount] = {};
+			for (auto i = first; i < first + itemCount; ++i) {
+				const auto bin = GetBin(GetAxis(centers[Items[i]], axis), minCenter, binScale);
+				binBounds[bin].Grow(Boxes[Items[i]]);
+				binCounts[bin]++;
+			}
+
+			// Right side costs are accumulated from the last bin down, then the left sides are swept up against them.
+			float rightCosts[BinCount];
+			Aabb right;
+			unsigned rightCount = 0;
+			for (auto plane = BinCount - 1; plane > 0; --plane) {
+				right.Grow(binBounds[plane]);
+				rightCount += binCounts[plane];
+				rightCosts[plane] = right.GetSurfaceArea() * (float)rightCount;
+			}
+
+			Aabb left;
+			unsigned leftCount = 0;
+			for (unsigned plane = 1; plane < BinCount; ++plane) {
+				left.Grow(binBounds[plane - 1]);
+				leftCount += binCounts[plane - 1];
+
+				const auto cost = left.GetSurfaceArea() * (float)leftCount + rightCosts[plane];
+				if (leftCount && leftCount < itemCount && cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestPlane = plane;
+				}
+			}
+		}
+
+		// Every center in the same spot, there is no plane between them.
+		if (bestCost == FLT_MAX) continue;
+
+		// Small leaves stay whole unless entering two children and testing what they hold is cheaper.
+		const auto splitCost = 1.0f + ItemCost * bestCost / Max(bounds.GetSurfaceArea(), FLT_MIN);
+		if (itemCount <= MaxLeafItems && splitCost >= ItemCost * (float)itemCount) continue;
+
+		const auto minCenter = GetAxis(centerBounds.Min, bestAxis);
+		const auto binScale = (float)BinCount / (GetAxis(centerBounds.Max, bestAxis) - minCenter);
+		const auto isLeft = [&](const unsigned I) {
+			return GetBin(GetAxis(centers[I], bestAxis), minCenter, binScale) < bestPlane;
+		};
+		const auto middle = std::partition(Items.begin() + first, Items.begin() + first + itemCount, isLeft);
+		const auto leftCount = (unsigned)(middle - Items.begin()) - first;
+
+		const auto leftIndex = (unsigned)Nodes.size();
+		Nodes.push_back({{}, first, leftCount});
+		Nodes.push_back({{}, first + leftCount, itemCount - leftCount});
+		Nodes[task.NodeIndex].First = leftIndex;
+		Nodes[task.NodeIndex].Count = 0;
+
+		tasks.push_back({leftIndex, task.Depth + 1});
+		tasks.push_back({leftIndex + 1, task.Depth + 1});
+	}
+}
+
+void Bvh::Refit(const std::vector<Aabb>& Boxes) {
+	// Children always come after their parent, so walking backwards finishes both children before the parent.
+	for (auto i = Nodes.size(); i-- > 0;) {
+		auto& node = Nodes[i];
+		Aabb bounds;
+
+		if (node.Count) {
+			for (auto item = node.First; item < node.First + node.Count; ++item) bounds.Grow(Boxes[Items[item]]);
+		}
+		else {
+			bounds.Grow(Nodes[node.First].Bounds);
+			bounds.Grow(Nodes[node.First + 1].Bounds);
+		}
+
+		node.Bounds = bounds;
+	}
+}
+
+bool Bvh::Insert(const unsigned Item, const Aabb& Box) {
+	if (Nodes.empty()) {
+		Nodes.push_back({Box, (unsigned)Items.size(), 1});
+		Items.emplace_back(Item);
+		return true;
+	}
+
+	// Find the leaf first so nothing changes when it is too deep to split.
+	unsigned path[MaxDepth];
+	unsigned depth = 0, nodeIndex = 0;
+	while (!Nodes[nodeIndex].Count) {
+		path[depth++] = nodeIndex;
+
+		const auto left = Nodes[nodeIndex].First;
+		const auto isLeft = GetGrowth(Nodes[left].Bounds, Box) <= GetGrowth(Nodes[left + 1].Bounds, Box);
+		nodeIndex = isLeft ? left : left + 1;
+	}
+
+	if (depth + 1 >= MaxDepth) return false;
+
+	for (unsigned i = 0; i < depth; ++i) Nodes[path[i]].Bounds.Grow(Box);
+
+	// The children go at the end, which keeps every node before its children for refitting.
+	const auto leaf = Nodes[nodeIndex];
+	const auto leftIndex = (unsigned)Nodes.size();
+	Nodes.push_back(leaf);
+	Nodes.push_back({Box, (unsigned)Items.size(), 1});
+	Items.emplace_back(Item);
+
+	auto& node = Nodes[nodeIndex];
+	node.Bounds.Grow(Box);
+	node.First = leftIndex;
+	node.Count = 0;
+	return true;
+}
+
+void Bvh::Clear() {
+	Nodes.clear();
+	Items.clear();
+}
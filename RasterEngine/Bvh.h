@@ -0,0 +1,132 @@
+#pragma once
+#include <vector>
+
+#include "EngineDefines.h"
+
+/**
+ * \brief Bounding volume hierarchy over a list of boxes, split with the binned surface area heuristic. The two
+ * children of a node are stored next to each other and after it, so refitting the tree to boxes that moved is one
+ * backwards pass over the nodes.
+ */
+class Bvh
+{
+public:
+	struct Node {
+		Aabb Bounds;
+
+		// Leaves hold Count items starting at First in Items. Interior nodes have a Count of 0 and First is their left
+		// child, with the right child right after it.
+		unsigned First;
+		unsigned Count;
+	};
+
+	// Leaves are not split any further once they hold this few items and splitting would not pay for itself.
+	static constexpr unsigned MaxLeafItems = 4;
+
+	// Deeper nodes are always leaves, which bounds the traversal stack.
+	static constexpr unsigned MaxDepth = 48;
+
+	// Candidate split planes tested per axis.
+	static constexpr unsigned BinCount = 12;
+
+	std::vector<Node> Nodes;
+
+	// Indices into the boxes the tree was built from, grouped by leaf.
+	std::vector<unsigned> Items;
+
+	/**
+	 * \brief Builds the tree from scratch.
+	 * \param Boxes Bounds of every item, items are referred to by their index in this list.
+	 * \param ItemCost Cost of testing one item relative to entering a node, lower values keep leaves fuller.
+	 */
+	void Build(const std::vector<Aabb>& Boxes, float ItemCost = 1.0f);
+
+	/**
+	 * \brief Updates the node bounds to boxes that moved without changing the shape of the tree. Cheaper than a build
+	 * but the tree gets looser the further items move from where they were built.
+	 * \param Boxes Bounds of the same items the tree was built from.
+	 */
+	void Refit(const std::vector<Aabb>& Boxes);
+
+	/**
+	 * \brief Adds one item without rebuilding, descending to the leaf whose bounds grow the least and splitting it
+	 * into its old items and the new one. Like refitting, the tree gets looser with every item inserted.
+	 * \param Item Index of the item in the boxes the tree refers to.
+	 * \return False if the leaf found is at MaxDepth and can not be split, the tree is left unchanged.
+	 */
+	bool Insert(unsigned Item, const Aabb& Box);
+
+	void Clear();
+
+	/**
+	 * \brief Walks the tree depth first, skipping every node whose bounds fail the test.
+	 * \param Test Takes the bounds of a node and returns whether to enter it.
+	 * \param Visit Called with the index of every item in the leaves that pass the test.
+	 */
+	template<typename NodeTest, typename ItemVisit>
+	void Traverse(const NodeTest& Test, const ItemVisit& Visit) const {
+		if (Nodes.empty()) return;
+
+		unsigned stack[MaxDepth * 2];
+		unsigned size = 0;
+		stack[size++] = 0;
+
+		while (size) {
+			const auto& node = Nodes[stack[--size]];
+			if (!Test(node.Bounds)) continue;
+
+			if (node.Count) {
+				for (auto i = node.First; i < node.First + node.Count; ++i) Visit(Items[i]);
+			}
+			else {
+				stack[size++] = node.First + 1;
+				stack[size++] = node.First;
+			}
+		}
+	}
+
+	/**
+	 * \brief Walks the leaves a ray passes through, nearest first, skipping every node the ray only enters past
+	 * MaxDistance.
+	 * \param InverseDirection One over every component of the ray direction.
+	 * \param MaxDistance Furthest distance along the ray to visit, read again at every node so Visit can shorten it.
+	 * \param Visit Called with the index of every leaf node reached.
+	 */
+	template<typename LeafVisit>
+	void TraverseRay(const Vec3F& Origin, const Vec3F& InverseDirection, const float& MaxDistance,
+					 const LeafVisit& Visit) const {
+		float distance;
+		if (Nodes.empty() || !Nodes[0].Bounds.IntersectsRay(Origin, InverseDirection, MaxDistance, distance)) return;
+
+		struct Entry {
+			unsigned NodeIndex;
+			float Distance;
+		};
+
+		Entry stack[MaxDepth * 2];
+		unsigned size = 0;
+		stack[size++] = {0, distance};
+
+		while (size) {
+			const auto entry = stack[--size];
+			if (entry.Distance > MaxDistance) continue;
+
+			const auto& node = Nodes[entry.NodeIndex];
+			if (node.Count) {
+				Visit(entry.NodeIndex);
+				continue;
+			}
+
+			Entry closer = {node.First, 0.0f}, further = {node.First + 1, 0.0f};
+			const auto isCloserHit = Nodes[closer.NodeIndex].Bounds.IntersectsRay(Origin, InverseDirection,
+																				  MaxDistance, closer.Distance);
+			const auto isFurtherHit = Nodes[further.NodeIndex].Bounds.IntersectsRay(Origin, InverseDirection,
+																					 MaxDistance, further.Distance);
+
+			// Push the further child first so the closer one is visited first and can shorten the ray for it.
+			if (isCloserHit && isFurtherHit && further.Distance < closer.Distance) Swap(closer, further);
+			if (isFurtherHit) stack[size++] = further;
+			if (isCloserHit) stack[size++] = closer;
+		}
+	}
+};
@@ -12,8 +12,18 @@ bool Component::HasParent() const {
 	return (Parent != nullptr) ? true : false; 
 }
 
+void Component::RenderOcclusion() {}
+
+bool Component::GetLocalBounds(Aabb& /*Bounds*/) const {
+	return false;
+}
+
+bool Component::Raycast(const Vec3F& /*Origin*/, const Vec3F& /*Direction*/, RayHit& /*Hit*/) const {
+	return false;
+}
+
 void Component::SetParent(BaseObject* P) {
-	delete Parent;
+	// The parent owns its components, not the other way around.
 	Parent = P;
 }
 
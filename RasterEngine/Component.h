@@ -1,5 +1,8 @@
 #pragma once
 class BaseObject;
+struct Aabb;
+struct RayHit;
+struct Vec3F;
 
 class Component
 {
@@ -18,6 +21,24 @@ public:
 	virtual void Render() = 0;
 	virtual void Destroy() = 0;
 
+	/**
+	 * \brief Draws into the occlusion buffer before the frame is rendered, does nothing unless overridden.
+	 */
+	virtual void RenderOcclusion();
+
+	/**
+	 * \brief Gets the bounds of the component in the space of its parent.
+	 * \return False if the component takes up no space, the default.
+	 */
+	virtual bool GetLocalBounds(Aabb& Bounds) const;
+
+	/**
+	 * \brief Finds where a world space ray first hits the component.
+	 * \param Hit Limits the query to Hit.Distance and receives the closest hit nearer than that.
+	 * \return True if Hit was updated, never by default.
+	 */
+	virtual bool Raycast(const Vec3F& Origin, const Vec3F& Direction, RayHit& Hit) const;
+
 private:
 	BaseObject* Parent;
 };
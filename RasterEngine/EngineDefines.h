@@ -6,9 +6,13 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cfloat>
 #include <cmath>
 #include <corecrt_math_defines.h>
+#include <initializer_list>
 #include <vector>
+#include <xmmintrin.h>
 
 #include "RenderHelper.h"
 
@@ -327,23 +331,23 @@ struct Mat4 {
 		*this = LoadIdentity();
 	}
 
-	explicit Mat4(std::vector<float> M)
-		: M(std::move(M)) {}
+	explicit Mat4(const std::initializer_list<float> Values) {
+		std::copy(Values.begin(), Values.begin() + (Values.size() < 16 ? Values.size() : 16), M);
+	}
 
 #pragma region Operators
 	float& operator[](const unsigned Index) {
-		if (Index > M.size()) { throw std::exception("Array out of bounds"); }
+		if (Index >= 16) { throw std::exception("Array out of bounds"); }
 		return M[Index];
 	}
 
 	Mat4 operator+(const Mat4& Other) const {
-		std::vector<float> tmp{};
-		tmp.assign(16, 0.0f);
+		Mat4 result;
 		for (int i = 0; i < 16; ++i) {
-			tmp[i] = M[i] + Other.M[i];
+			result.M[i] = M[i] + Other.M[i];
 		}
 
-		return Mat4(tmp);
+		return result;
 	}
 
 	Mat4& operator+=(const Mat4& Other) {
@@ -352,8 +356,8 @@ struct Mat4 {
 	}
 
 	Mat4 operator*(const Mat4& Other) const {
-		std::vector<float> tmp{};
-		tmp.assign(16, 0.0f);
+		Mat4 result;
+		auto* tmp = result.M;
 
 		// Row 1
 		tmp[0] = this->M[0] * Other.M[0] + this->M[1] * Other.M[4] + this->M[2] * Other.M[8] + this->M[3] * Other.M[12];
@@ -379,7 +383,7 @@ struct Mat4 {
 		tmp[14] = this->M[12] * Other.M[2] + this->M[13] * Other.M[6] + this->M[14] * Other.M[10] + this->M[15] * Other.M[14];
 		tmp[15] = this->M[12] * Other.M[3] + this->M[13] * Other.M[7] + this->M[14] * Other.M[11] + this->M[15] * Other.M[15];
 
-		return Mat4(tmp);
+		return result;
 	}
 
 	Vec3F Project(const Vec3F& V) const {
@@ -397,6 +401,12 @@ struct Mat4 {
 		*this = *this * Other;
 		return *this;
 	}
+
+	friend bool operator==(const Mat4& Lhs, const Mat4& Rhs) {
+		return std::equal(Lhs.M, Lhs.M + 16, Rhs.M);
+	}
+
+	friend bool operator!=(const Mat4& Lhs, const Mat4& Rhs) { return !(Lhs == Rhs); }
 #pragma endregion
 
 #pragma region Member Functions
@@ -405,7 +415,7 @@ struct Mat4 {
 	 * \return Identity matrix.
 	 */
 	Mat4& LoadIdentity() {
-		M.assign(16, 0.0f);
+		std::fill(M, M + 16, 0.0f);
 		M[0] = M[5] = M[10] = M[15] = 1.0f;
 
 		return *this;
@@ -446,18 +456,12 @@ struct Mat4 {
 	}
 
 	/**
-	 * \brief Rotates this matrix by the given X, Y, and Z degree angles with the correct composition.
+	 * \brief Rotates this matrix by the given X, Y, and Z degree angles, composed in order of Z, Y, X through a single
+	 * quaternion.
 	 * \param Rotation Degrees in X, Y, and Z to rotate by.
 	 * \return Rotated matrix.
 	 */
-	Mat4& Rotate(const Vec3F& Rotation) {
-		// Compose the rotation matrices in order of Z, Y, X to get to the final rotation of this matrix.
-		*this *= GetZRotation(Deg2Rad(ClampAngle(Rotation.Z)));
-		*this *= GetYRotation(Deg2Rad(ClampAngle(Rotation.Y)));
-		*this *= GetXRotation(Deg2Rad(ClampAngle(Rotation.X)));
-
-		return *this;
-	}
+	Mat4& Rotate(const Vec3F& Rotation);
 
 	/**
 	 * \brief Gets the first row of the matrix, the right facing vector.
@@ -602,8 +606,8 @@ struct Mat4 {
 #pragma endregion
 
 private:
-	// Valid for index 0-15, in row major format.
-	std::vector<float> M;
+	// Valid for index 0-15, in row major format. Held inline so matrices and their temporaries never allocate.
+	float M[16];
 
 #pragma region Static Helpers
 public:
@@ -661,6 +665,276 @@ public:
 #pragma endregion
 };
 
+/**
+ * \brief A rotation stored as a unit quaternion. Composes in the same order as Mat4, A * B rotates by A and then by B.
+ */
+struct Quat {
+	Quat(): X(0.0f), Y(0.0f), Z(0.0f), W(1.0f) {}
+
+	Quat(const float X, const float Y, const float Z, const float W)
+		: X(X),
+		  Y(Y),
+		  Z(Z),
+		  W(W) {}
+
+	float X, Y, Z, W;
+
+#pragma region Operators
+	Quat operator*(const Quat& Other) const {
+		// Hamilton product of Other by this, so this rotation is the one applied first.
+		const auto a = _mm_loadu_ps(&Other.X);
+		const auto b = _mm_loadu_ps(&X);
+
+		auto result = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b);
+		result = _mm_add_ps(result, _mm_xor_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)),
+															_mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 1, 2, 3))),
+												 _mm_set_ps(-0.0f, 0.0f, -0.0f, 0.0f)));
+		result = _mm_add_ps(result, _mm_xor_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)),
+															_mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))),
+												 _mm_set_ps(-0.0f, -0.0f, 0.0f, 0.0f)));
+		result = _mm_add_ps(result, _mm_xor_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)),
+															_mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1))),
+												 _mm_set_ps(-0.0f, 0.0f, 0.0f, -0.0f)));
+
+		Quat q;
+		_mm_storeu_ps(&q.X, result);
+		return q;
+	}
+
+	Quat& operator*=(const Quat& Other) {
+		*this = *this * Other;
+		return *this;
+	}
+#pragma endregion
+
+#pragma region Member Functions
+	float Dot(const Quat& Other) const {
+		return X * Other.X + Y * Other.Y + Z * Other.Z + W * Other.W;
+	}
+
+	/**
+	 * \brief Scales this quaternion back to unit length, undoing the rounding error built up by composing rotations.
+	 * \return Normalized quaternion.
+	 */
+	Quat& Normalize() {
+		const auto length = std::sqrt(Dot(*this));
+		X /= length;
+		Y /= length;
+		Z /= length;
+		W /= length;
+
+		return *this;
+	}
+
+	Quat GetNormalized() const {
+		auto q = *this;
+		return q.Normalize();
+	}
+
+	/**
+	 * \brief Gets the opposite rotation.
+	 * \return Conjugate of this quaternion, the inverse while it has unit length.
+	 */
+	Quat GetInverse() const {
+		return {-X, -Y, -Z, W};
+	}
+
+	/**
+	 * \brief Rotates a direction or point around the origin.
+	 * \return Rotated vector with a W of 1.
+	 */
+	Vec3F Rotate(const Vec3F& V) const {
+		Vec3F result;
+		_mm_storeu_ps(&result.X, Rotate(_mm_loadu_ps(&X), _mm_set_ps(0.0f, V.Z, V.Y, V.X)));
+		result.W = 1.0f;
+
+		return result;
+	}
+
+	/**
+	 * \brief Converts the rotation to a matrix in one step.
+	 * \return Rotation matrix.
+	 */
+	Mat4 ToMat4() const {
+		const auto xx = X * X, yy = Y * Y, zz = Z * Z;
+		const auto xy = X * Y, xz = X * Z, yz = Y * Z;
+		const auto wx = W * X, wy = W * Y, wz = W * Z;
+
+		return Mat4({
+			1 - 2 * (yy + zz), 2 * (xy + wz), 2 * (xz - wy), 0,
+			2 * (xy - wz), 1 - 2 * (xx + zz), 2 * (yz + wx), 0,
+			2 * (xz + wy), 2 * (yz - wx), 1 - 2 * (xx + yy), 0,
+			0, 0, 0, 1
+		});
+	}
+#pragma endregion
+
+#pragma region Static Helpers
+	/**
+	 * \brief Creates a rotation around an axis.
+	 * \param Axis Unit length axis to rotate around.
+	 * \param Radians Angle of rotation, counter clockwise looking down the axis.
+	 * \return Rotation quaternion.
+	 */
+	static Quat FromAxisAngle(const Vec3F& Axis, const float Radians) {
+		const auto s = std::sin(Radians * 0.5f);
+		return {Axis.X * s, Axis.Y * s, Axis.Z * s, std::cos(Radians * 0.5f)};
+	}
+
+	/**
+	 * \brief Creates the same rotation as Mat4::Rotate from X, Y, and Z degree angles.
+	 * \param Rotation Degrees in X, Y, and Z to rotate by.
+	 * \return Rotation quaternion.
+	 */
+	static Quat FromEuler(const Vec3F& Rotation) {
+		// The matrix rotations turn clockwise around X and Z and counter clockwise around Y, and apply Z first.
+		return FromAxisAngle({0, 0, 1}, -Deg2Rad(Rotation.Z))
+			* FromAxisAngle({0, 1, 0}, Deg2Rad(Rotation.Y))
+			* FromAxisAngle({1, 0, 0}, -Deg2Rad(Rotation.X));
+	}
+
+	/**
+	 * \brief Interpolates between two rotations at a constant angular speed along the shortest arc.
+	 * \param Ratio 0 for A, 1 for B.
+	 * \return Unit length rotation between A and B.
+	 */
+	static Quat Slerp(const Quat& A, const Quat& B, const float Ratio) {
+		// Q and -Q are the same rotation, flip B to the same side as A to take the short way round.
+		auto cosAngle = A.Dot(B);
+		const auto sign = cosAngle < 0.0f ? -1.0f : 1.0f;
+		cosAngle *= sign;
+
+		// Nearly parallel rotations divide by a vanishing sine, a normalized lerp is just as accurate there.
+		auto weightA = 1.0f - Ratio, weightB = Ratio;
+		if (cosAngle < 0.9995f) {
+			const auto angle = std::acos(cosAngle);
+			const auto sinAngle = std::sin(angle);
+			weightA = std::sin(weightA * angle) / sinAngle;
+			weightB = std::sin(weightB * angle) / sinAngle;
+		}
+
+		weightB *= sign;
+		return Quat(A.X * weightA + B.X * weightB, A.Y * weightA + B.Y * weightB, A.Z * weightA + B.Z * weightB,
+					A.W * weightA + B.W * weightB).Normalize();
+	}
+
+	/**
+	 * \brief Rotates a vector held in the first three lanes, the fourth lane of the result is undefined.
+	 */
+	static __m128 Rotate(const __m128 Q, const __m128 V) {
+		// V + 2W(Q x V) + Q x 2(Q x V), the quaternion sandwich product without the zero terms.
+		const auto t = Cross(Q, V);
+		const auto t2 = _mm_add_ps(t, t);
+		const auto w = _mm_shuffle_ps(Q, Q, _MM_SHUFFLE(3, 3, 3, 3));
+
+		return _mm_add_ps(_mm_add_ps(V, _mm_mul_ps(w, t2)), Cross(Q, t2));
+	}
+
+	/**
+	 * \brief Cross product of the first three lanes of A and B.
+	 */
+	static __m128 Cross(const __m128 A, const __m128 B) {
+		const auto aYzx = _mm_shuffle_ps(A, A, _MM_SHUFFLE(3, 0, 2, 1));
+		const auto bYzx = _mm_shuffle_ps(B, B, _MM_SHUFFLE(3, 0, 2, 1));
+		const auto c = _mm_sub_ps(_mm_mul_ps(A, bYzx), _mm_mul_ps(aYzx, B));
+
+		return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+	}
+#pragma endregion
+};
+
+/**
+ * \brief A transform kept as scale, rotation and translation, applied in that order. Cheaper to compose and
+ * interpolate than a Mat4 and converted to one only when a matrix is needed.
+ */
+struct Transform {
+	Transform(): Scale(1.0f, 1.0f, 1.0f) {}
+
+	Transform(const Vec3F& Translation, const Quat& Rotation, const Vec3F& Scale)
+		: Translation(Translation),
+		  Rotation(Rotation),
+		  Scale(Scale) {}
+
+	Vec3F Translation;
+	Quat Rotation;
+	Vec3F Scale;
+
+#pragma region Operators
+	/**
+	 * \brief Composes two transforms in the same order as Mat4, applying this one first and then Parent. Exact unless
+	 * Parent scales unevenly and this transform is rotated, which a matrix would turn into a shear.
+	 */
+	Transform operator*(const Transform& Parent) const {
+		const auto parentScale = _mm_loadu_ps(&Parent.Scale.X);
+		const auto parentRotation = _mm_loadu_ps(&Parent.Rotation.X);
+		const auto translation = Quat::Rotate(parentRotation, _mm_mul_ps(_mm_loadu_ps(&Translation.X), parentScale));
+
+		Transform result;
+		_mm_storeu_ps(&result.Translation.X, _mm_add_ps(translation, _mm_loadu_ps(&Parent.Translation.X)));
+		_mm_storeu_ps(&result.Scale.X, _mm_mul_ps(_mm_loadu_ps(&Scale.X), parentScale));
+		result.Translation.W = result.Scale.W = 1.0f;
+
+		// Renormalize every time so rotations accumulated over many frames do not drift away from unit length.
+		result.Rotation = (Rotation * Parent.Rotation).Normalize();
+
+		return result;
+	}
+
+	Transform& operator*=(const Transform& Parent) {
+		*this = *this * Parent;
+		return *this;
+	}
+#pragma endregion
+
+#pragma region Member Functions
+	Vec3F TransformPoint(const Vec3F& P) const {
+		return Rotation.Rotate(Vec3F::Scale(P, Scale)) + Translation;
+	}
+
+	/**
+	 * \brief Converts the transform to a matrix in one step, without composing separate scale, rotation and
+	 * translation matrices.
+	 * \return Matrix applying the scale, rotation and translation of this transform.
+	 */
+	Mat4 ToMat4() const {
+		auto m = Rotation.ToMat4();
+		m[0] *= Scale.X;
+		m[1] *= Scale.X;
+		m[2] *= Scale.X;
+		m[4] *= Scale.Y;
+		m[5] *= Scale.Y;
+		m[6] *= Scale.Y;
+		m[8] *= Scale.Z;
+		m[9] *= Scale.Z;
+		m[10] *= Scale.Z;
+		m[12] = Translation.X;
+		m[13] = Translation.Y;
+		m[14] = Translation.Z;
+
+		return m;
+	}
+#pragma endregion
+
+#pragma region Static Helpers
+	/**
+	 * \brief Interpolates translation and scale linearly and rotation along the shortest arc.
+	 * \param Ratio 0 for A, 1 for B.
+	 */
+	static Transform Lerp(const Transform& A, const Transform& B, const float Ratio) {
+		return {
+			A.Translation + (B.Translation - A.Translation) * Ratio,
+			Quat::Slerp(A.Rotation, B.Rotation, Ratio),
+			A.Scale + (B.Scale - A.Scale) * Ratio
+		};
+	}
+#pragma endregion
+};
+
+inline Mat4& Mat4::Rotate(const Vec3F& Rotation) {
+	*this *= Quat::FromEuler(Rotation).ToMat4();
+	return *this;
+}
+
 struct Color {
 	Color() { *this = Color(Color::White); }
 
@@ -690,6 +964,13 @@ struct Color {
 		return Color{ Floor(Foreground.A) << 24 | Floor(red) << 16 | Floor(green) << 8 | Floor(blue) };
 	}
 
+	/**
+	 * \brief Multiplies every channel, alpha included, by the matching channel of the tint with 255 as one.
+	 */
+	static Color Modulate(const Color& Base, const Color& Tint) {
+		return {Base.A * Tint.A / 255.0f, Base.R * Tint.R / 255.0f, Base.G * Tint.G / 255.0f, Base.B * Tint.B / 255.0f};
+	}
+
 	Color operator+(const float Other) const {
 		return {A+Other, R+Other, G+Other, B+Other};
 	}
@@ -756,6 +1037,59 @@ public:
 	Vec3F Light;
 };
 
+/**
+ * \brief Surface attributes of one pixel written by the deferred rasterizer and shaded in a later pass.
+ */
+struct GBufferTexel {
+	GBufferTexel() : U(0.0f), V(0.0f), UvFootprint(0.0f), Normal(0), Light(0), Albedo(0), Material(0) {}
+
+	// Perspective correct texture coordinate.
+	float U, V;
+
+	// Distance the texture coordinate moves per pixel, textures sampled while resolving pick their mip level from it.
+	float UvFootprint;
+
+	// Interpolated vertex normal, 10 bits per axis.
+	unsigned Normal;
+
+	// Interpolated vertex light, 8 bits per channel in 0-1.
+	unsigned Light;
+
+	// Interpolated vertex color in AARRGGBB.
+	unsigned Albedo;
+
+	// Id of the material shading this pixel, 0 if no surface was drawn.
+	unsigned short Material;
+
+	static unsigned PackNormal(const float X, const float Y, const float Z) {
+		return ClampAndRound((X * 0.5f + 0.5f) * 1023.0f, 0.0f, 1023.0f) << 20
+			 | ClampAndRound((Y * 0.5f + 0.5f) * 1023.0f, 0.0f, 1023.0f) << 10
+			 | ClampAndRound((Z * 0.5f + 0.5f) * 1023.0f, 0.0f, 1023.0f);
+	}
+
+	static Vec3F UnpackNormal(const unsigned N) {
+		return {
+			(float)((N >> 20) & 0x3FF) / 1023.0f * 2.0f - 1.0f,
+			(float)((N >> 10) & 0x3FF) / 1023.0f * 2.0f - 1.0f,
+			(float)(N & 0x3FF) / 1023.0f * 2.0f - 1.0f
+		};
+	}
+
+	static unsigned PackLight(const float R, const float G, const float B) {
+		return ClampAndRound(R * 255.0f, 0.0f, 255.0f) << 16
+			 | ClampAndRound(G * 255.0f, 0.0f, 255.0f) << 8
+			 | ClampAndRound(B * 255.0f, 0.0f, 255.0f);
+	}
+
+	static Vec3F UnpackLight(const unsigned L) {
+		return {
+			(float)((L >> 16) & 0xFF) / 255.0f,
+			(float)((L >> 8) & 0xFF) / 255.0f,
+			(float)(L & 0xFF) / 255.0f
+		};
+	}
+};
+
 struct Camera {
 	Camera(const float NearPlane, const float FarPlane, const float FieldOfView, const unsigned ScreenWidth,
 		const unsigned ScreenHeight, Mat4 WorldTransform)
@@ -816,6 +1150,52 @@ struct Camera {
 		V.Pos = newPos;
 	}
 
+	/**
+	 * \brief Gets how many pixels tall one unit appears at a view depth, used to turn world space errors into screen
+	 * space ones.
+	 */
+	float GetPixelsPerUnit(const float Depth) const {
+		return (float)ScreenHeight * 0.5f * GetPerspectiveProjection()[5] / Max(Depth, NearPlane);
+	}
+
+	/**
+	 * \brief Projects a view space position onto the screen. The position must be in front of the near plane.
+	 * \return Screen position with the view depth stored in Z.
+	 */
+	Vec2F ViewToScreen(const Vec3F& ViewPos) const {
+		auto newPos = PerspectiveProjection.Project(ViewPos);
+
+		Vec2F ret = {
+			(newPos.X / newPos.W * 0.5f + 0.5f) * (float)ScreenWidth,
+			(1.0f - (newPos.Y / newPos.W * 0.5f + 0.5f)) * (float)ScreenHeight
+		};
+		ret.Z = newPos.W;
+
+		return ret;
+	}
+
+	/**
+	 * \brief Gets the ray from the camera through a pixel, aimed where the rasterizer samples it.
+	 * \param X Column of the pixel, fractions aim between pixels.
+	 * \param Y Row of the pixel from the top of the screen.
+	 * \param Origin Receives the world position of the camera.
+	 * \param Direction Receives the normalized world direction through the pixel.
+	 */
+	void GetPixelRay(const float X, const float Y, Vec3F& Origin, Vec3F& Direction) const {
+		const auto ndcX = X / (float)ScreenWidth * 2.0f - 1.0f;
+		const auto ndcY = 1.0f - Y / (float)ScreenHeight * 2.0f;
+
+		// Undo the projection scale to get the view direction at a depth of 1, then rotate it into the world.
+		auto projection = PerspectiveProjection;
+		Vec3F viewDirection = {ndcX / projection[0], ndcY / projection[5], 1.0f};
+		viewDirection.W = 0.0f;
+
+		Origin = WorldTransform.GetPosition();
+		Direction = WorldTransform.Project(viewDirection);
+		Direction.W = 0.0f;
+		Vec3F::Normalize(Direction);
+	}
+
 	static Vec2F WorldToScreen(const Camera& C, const Vert& P, Mat4& PTransform) {
 		// Rotate the parent object.
 		Vert p0 = P;
@@ -830,6 +1210,147 @@ struct Camera {
 	}
 };
 
+/**
+ * \brief Axis aligned bounding box. A default box is empty and inside out, so growing it by anything gives exactly
+ * the bounds of what it grew by.
+ */
+struct Aabb {
+	Aabb(): Min(FLT_MAX, FLT_MAX, FLT_MAX), Max(-FLT_MAX, -FLT_MAX, -FLT_MAX) {}
+
+	Aabb(const Vec3F& Min, const Vec3F& Max)
+		: Min(Min),
+		  Max(Max) {}
+
+	Vec3F Min, Max;
+
+	bool IsEmpty() const {
+		return Min.X > Max.X || Min.Y > Max.Y || Min.Z > Max.Z;
+	}
+
+	Vec3F GetCenter() const {
+		return (Min + Max) * 0.5f;
+	}
+
+	float GetSurfaceArea() const {
+		if (IsEmpty()) return 0.0f;
+
+		const auto size = Max - Min;
+		return 2.0f * (size.X * size.Y + size.Y * size.Z + size.Z * size.X);
+	}
+
+	void Grow(const Vec3F& P) {
+		Min = {::Min(Min.X, P.X), ::Min(Min.Y, P.Y), ::Min(Min.Z, P.Z)};
+		Max = {::Max(Max.X, P.X), ::Max(Max.Y, P.Y), ::Max(Max.Z, P.Z)};
+	}
+
+	void Grow(const Aabb& Other) {
+		Min = {::Min(Min.X, Other.Min.X), ::Min(Min.Y, Other.Min.Y), ::Min(Min.Z, Other.Min.Z)};
+		Max = {::Max(Max.X, Other.Max.X), ::Max(Max.Y, Other.Max.Y), ::Max(Max.Z, Other.Max.Z)};
+	}
+
+	bool Intersects(const Aabb& Other) const {
+		return Min.X <= Other.Max.X && Max.X >= Other.Min.X &&
+			Min.Y <= Other.Max.Y && Max.Y >= Other.Min.Y &&
+			Min.Z <= Other.Max.Z && Max.Z >= Other.Min.Z;
+	}
+
+	bool Intersects(const Vec3F& Center, const float Radius) const {
+		// Distance from the center to the nearest point of the box.
+		const auto dx = Center.X - Clamp(Center.X, Min.X, Max.X);
+		const auto dy = Center.Y - Clamp(Center.Y, Min.Y, Max.Y);
+		const auto dz = Center.Z - Clamp(Center.Z, Min.Z, Max.Z);
+
+		return dx * dx + dy * dy + dz * dz <= Radius * Radius;
+	}
+
+	/**
+	 * \brief Clips a ray against the three pairs of planes of the box.
+	 * \param InverseDirection One over every component of the ray direction.
+	 * \param MaxDistance Distance along the ray past which hits are ignored.
+	 * \param Distance Receives the distance along the ray the box is entered at, 0 if the ray starts inside it.
+	 * \return True if the ray passes through the box before MaxDistance.
+	 */
+	bool IntersectsRay(const Vec3F& Origin, const Vec3F& InverseDirection, const float MaxDistance,
+					   float& Distance) const {
+		const auto x0 = (Min.X - Origin.X) * InverseDirection.X;
+		const auto x1 = (Max.X - Origin.X) * InverseDirection.X;
+		const auto y0 = (Min.Y - Origin.Y) * InverseDirection.Y;
+		const auto y1 = (Max.Y - Origin.Y) * InverseDirection.Y;
+		const auto z0 = (Min.Z - Origin.Z) * InverseDirection.Z;
+		const auto z1 = (Max.Z - Origin.Z) * InverseDirection.Z;
+
+		const auto enter = ::Max(::Max(::Min(x0, x1), ::Min(y0, y1)), ::Max(::Min(z0, z1), 0.0f));
+		const auto exit = ::Min(::Min(::Max(x0, x1), ::Max(y0, y1)), ::Min(::Max(z0, z1), MaxDistance));
+
+		Distance = enter;
+		return enter <= exit;
+	}
+
+	/**
+	 * \brief Gets the box around this one after it is transformed, larger than it whenever the transform rotates.
+	 */
+	Aabb GetTransformed(const Mat4& Transform) const {
+		if (IsEmpty()) return {};
+
+		Aabb ret;
+		for (unsigned i = 0; i < 8; ++i) {
+			ret.Grow(Transform.Project({(i & 1) ? Max.X : Min.X, (i & 2) ? Max.Y : Min.Y, (i & 4) ? Max.Z : Min.Z}));
+		}
+
+		return ret;
+	}
+};
+
+/**
+ * \brief The six planes around the view volume of a camera in world space, facing inward and normalized so sphere
+ * tests can compare distances directly.
+ */
+struct Frustum {
+	explicit Frustum(const Camera& C) {
+		auto m = C.GetViewMatrix() * C.GetPerspectiveProjection();
+
+		// Positions are row vectors, so every clip space coordinate is a dot with a column of the matrix. A point is
+		// inside while -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+		const auto column = [&m](const unsigned I, const unsigned P) { return m[P * 4 + I]; };
+		for (unsigned p = 0; p < 4; ++p) {
+			Planes[0][p] = column(3, p) + column(0, p);
+			Planes[1][p] = column(3, p) - column(0, p);
+			Planes[2][p] = column(3, p) + column(1, p);
+			Planes[3][p] = column(3, p) - column(1, p);
+			Planes[4][p] = column(2, p);
+			Planes[5][p] = column(3, p) - column(2, p);
+		}
+
+		for (auto& plane : Planes) {
+			const auto length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+			for (auto& p : plane) p /= length;
+		}
+	}
+
+	// Normal X, Y, Z and offset of every plane.
+	float Planes[6][4];
+
+	bool Intersects(const Aabb& Box) const {
+		for (const auto& plane : Planes) {
+			// The corner furthest along the plane normal is the last one to leave.
+			const auto x = plane[0] >= 0.0f ? Box.Max.X : Box.Min.X;
+			const auto y = plane[1] >= 0.0f ? Box.Max.Y : Box.Min.Y;
+			const auto z = plane[2] >= 0.0f ? Box.Max.Z : Box.Min.Z;
+			if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.0f) return false;
+		}
+
+		return true;
+	}
+
+	bool Intersects(const Vec3F& Center, const float Radius) const {
+		for (const auto& plane : Planes) {
+			if (plane[0] * Center.X + plane[1] * Center.Y + plane[2] * Center.Z + plane[3] < -Radius) return false;
+		}
+
+		return true;
+	}
+};
+
 static bool Within(const float X)
 {
 	return 0 <= X && X <= 1;
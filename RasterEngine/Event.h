@@ -6,21 +6,112 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
-#include <map>
 #include <mutex>
+#include <vector>
 
+// Identifies one subscription to an event, unique for the lifetime of that event.
+using EventHandle = unsigned;
+
+/**
+ * \brief Calls every subscriber in the order they subscribed, passing along the payload given to Notify. Subscribers
+ * are kept in one contiguous array that Notify reads without locking. Subscribing and unsubscribing only queue the
+ * change, from any thread and even from inside a callback, and queued changes are applied at the start of the next
+ * Notify. Notify itself must only be called from one thread at a time.
+ * \tparam Args Payload passed to every subscriber.
+ */
+template<typename... Args>
 class Event
 {
-	std::map<const wchar_t*, std::function<void()>> Subscribers;
-	std::mutex NotifyMux;
-
 public:
-	Event();
+	using Callback = std::function<void(Args...)>;
 
-	bool IsSubscribed(const wchar_t* FuncName);
-	void Subscribe(const wchar_t* FuncName, const std::function<void()>& Func);
-	void Notify();
-	void Unsubscribe(const wchar_t* FuncName);
-};
+	Event(): NextHandle(0), HasPending(false) {}
+
+	/**
+	 * \brief Adds a subscriber, called from the next Notify on.
+	 * \return Handle to unsubscribe with.
+	 */
+	EventHandle Subscribe(Callback Func) {
+		std::lock_guard<std::mutex> lock(PendingMux);
+
+		const auto handle = NextHandle++;
+		PendingAdds.push_back({handle, std::move(Func)});
+		HasPending = true;
+
+		return handle;
+	}
+
+	/**
+	 * \brief Removes a subscriber before the next Notify. Unknown handles are ignored.
+	 */
+	void Unsubscribe(const EventHandle Handle) {
+		std::lock_guard<std::mutex> lock(PendingMux);
+
+		PendingRemoves.push_back(Handle);
+		HasPending = true;
+	}
+
+	/**
+	 * \brief Checks whether a handle is subscribed, counting changes that are still queued.
+	 */
+	bool IsSubscribed(const EventHandle Handle) {
+		std::lock_guard<std::mutex> lock(PendingMux);
+
+		if (std::find(PendingRemoves.begin(), PendingRemoves.end(), Handle) != PendingRemoves.end()) return false;
 
+		const auto isHandle = [Handle](const Subscriber& S) { return S.Handle == Handle; };
+		return std::any_of(Subscribers.begin(), Subscribers.end(), isHandle)
+			|| std::any_of(PendingAdds.begin(), PendingAdds.end(), isHandle);
+	}
+
+	void Notify(Args... Payload) {
+		if (HasPending) ApplyPending();
+
+		// Indexing rather than iterating stays valid however the callbacks use this event, since changes are queued.
+		const auto count = Subscribers.size();
+		for (size_t i = 0; i < count; ++i) {
+			Subscribers[i].Func(Payload...);
+		}
+	}
+
+private:
+	struct Subscriber {
+		EventHandle Handle;
+		Callback Func;
+	};
+
+	std::vector<Subscriber> Subscribers;
+
+	std::vector<Subscriber> PendingAdds;
+	std::vector<EventHandle> PendingRemoves;
+	std::mutex PendingMux;
+
+	EventHandle NextHandle;
+	std::atomic<bool> HasPending;
+
+	void ApplyPending() {
+		std::lock_guard<std::mutex> lock(PendingMux);
+
+		for (auto& subscriber : PendingAdds) {
+			Subscribers.emplace_back(std::move(subscriber));
+		}
+		PendingAdds.clear();
+
+		// Handles only grow, so subscribers stay sorted by handle and each removal is a binary search.
+		if (!PendingRemoves.empty()) {
+			const auto isRemoved = [this](const Subscriber& S) {
+				const auto it = std::lower_bound(PendingRemoves.begin(), PendingRemoves.end(), S.Handle);
+				return it != PendingRemoves.end() && *it == S.Handle;
+			};
+
+			std::sort(PendingRemoves.begin(), PendingRemoves.end());
+			Subscribers.erase(std::remove_if(Subscribers.begin(), Subscribers.end(), isRemoved), Subscribers.end());
+			PendingRemoves.clear();
+		}
+
+		HasPending = false;
+	}
+};
@@ -0,0 +1,85 @@
+#include "FrameArena.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+	char* AlignUp(char* Pointer, const size_t Alignment) {
+		const auto address = (uintptr_t)Pointer;
+		return (char*)((address + Alignment - 1) & ~(uintptr_t)(Alignment - 1));
+	}
+}
+
+FrameArena::FrameArena(): Current(nullptr), Top(nullptr), End(nullptr), Capacity(0), UsedBefore(0) {}
+
+FrameArena::~FrameArena() {
+	FreeBlocks();
+}
+
+FrameArena& FrameArena::Get() {
+	static thread_local FrameArena arena;
+	return arena;
+}
+
+void* FrameArena::Allocate(const size_t Size, const size_t Alignment) {
+	auto* memory = AlignUp(Top, Alignment);
+	if (!Current || memory + Size > End) {
+		AddBlock(Size + Alignment);
+		memory = AlignUp(Top, Alignment);
+	}
+
+	Top = memory + Size;
+	return memory;
+}
+
+void FrameArena::Free(void* Memory, const size_t Size) {
+	if ((char*)Memory + Size == Top) Top = (char*)Memory;
+}
+
+void FrameArena::Reset() {
+	if (!Current) return;
+
+	if (Current->Previous) {
+		const auto capacity = Capacity;
+		FreeBlocks();
+		AddBlock(capacity);
+		return;
+	}
+
+	Top = (char*)(Current + 1);
+	UsedBefore = 0;
+}
+
+size_t FrameArena::GetUsed() const {
+	return Current ? UsedBefore + (size_t)(Top - (char*)(Current + 1)) : 0;
+}
+
+void FrameArena::AddBlock(const size_t MinSize) {
+	// Doubling the capacity with every block keeps the number of blocks a frame needs small.
+	auto size = Capacity > InitialSize ? Capacity : InitialSize;
+	if (size < MinSize) size = MinSize;
+
+	auto* block = (Block*)std::malloc(sizeof(Block) + size);
+	if (!block) throw std::bad_alloc();
+
+	if (Current) UsedBefore += (size_t)(Top - (char*)(Current + 1));
+
+	block->Previous = Current;
+	Current = block;
+	Top = (char*)(block + 1);
+	End = Top + size;
+	Capacity += size;
+}
+
+void FrameArena::FreeBlocks() {
+	while (Current) {
+		auto* previous = Current->Previous;
+		std::free(Current);
+		Current = previous;
+	}
+
+	Top = End = nullptr;
+	Capacity = 0;
+	UsedBefore = 0;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/**
+ * \brief Linear allocator for data that only lives until the end of the frame. Allocating bumps a pointer through a
+ * block of memory, nothing is freed on its own and the whole arena is reset at once when the frame ends. Every thread
+ * has its own arena, so workers never contend for it.
+ */
+class FrameArena
+{
+public:
+	// Size of the first block, the arena grows to whatever a frame needs within the first few frames.
+	static constexpr size_t InitialSize = 1 << 20;
+
+	FrameArena();
+	~FrameArena();
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	/**
+	 * \brief Gets the arena of the calling thread.
+	 */
+	static FrameArena& Get();
+
+	void* Allocate(size_t Size, size_t Alignment);
+
+	/**
+	 * \brief Allocates uninitialized room for Count objects that stay until the arena is reset, for data recorded now
+	 * and read later in the frame. Never freed on its own, so a FrameVector must not be used for that.
+	 */
+	template<typename T>
+	T* AllocateArray(const size_t Count) {
+		static_assert(std::is_trivially_destructible<T>::value, "Frame arrays are never destroyed");
+		return static_cast<T*>(Allocate(Count * sizeof(T), alignof(T)));
+	}
+
+	/**
+	 * \brief Gives memory back only if it was the last allocation, such as a vector freed right after the allocation
+	 * it made. A growing vector allocates its new buffer before freeing the old one, so the old space stays used until
+	 * Reset, reserve up front where the size is known.
+	 */
+	void Free(void* Memory, size_t Size);
+
+	/**
+	 * \brief Releases everything allocated since the last reset, every pointer handed out becomes invalid. A frame
+	 * that overflowed into more blocks has them replaced by one block large enough for all of them, so frames after it
+	 * no longer touch the global allocator.
+	 */
+	void Reset();
+
+	/**
+	 * \return Bytes handed out since the last reset, including alignment padding.
+	 */
+	size_t GetUsed() const;
+
+private:
+	// Blocks are chained through a header at their start, newest first.
+	struct Block {
+		Block* Previous;
+	};
+
+	Block* Current;
+	char* Top;
+	char* End;
+
+	// Total size of every block and the bytes used in the blocks before the current one.
+	size_t Capacity;
+	size_t UsedBefore;
+
+	void AddBlock(size_t MinSize);
+	void FreeBlocks();
+};
+
+/**
+ * \brief Allocator handing out memory from the frame arena of the thread that created it, for containers that are
+ * dropped before the frame ends.
+ */
+template<typename T>
+struct FrameAllocator {
+	using value_type = T;
+
+	FrameAllocator(): Arena(&FrameArena::Get()) {}
+
+	template<typename U>
+	FrameAllocator(const FrameAllocator<U>& Other): Arena(Other.Arena) {}
+
+	T* allocate(const size_t Count) {
+		return static_cast<T*>(Arena->Allocate(Count * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* Pointer, const size_t Count) {
+		Arena->Free(Pointer, Count * sizeof(T));
+	}
+
+	template<typename U>
+	bool operator==(const FrameAllocator<U>& Other) const { return Arena == Other.Arena; }
+
+	template<typename U>
+	bool operator!=(const FrameAllocator<U>& Other) const { return Arena != Other.Arena; }
+
+	FrameArena* Arena;
+};
+
+// Vector of transient render data, must not outlive the frame it was made in.
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
@@ -1,10 +1,12 @@
 #include "GEngine.h"
 
-#include <iostream>
+#include <crtdbg.h>
 #include <random>
 
 #include "Actor.h"
+#include "AllocationCounter.h"
 #include "EngineDefines.h"
+#include "FrameArena.h"
 #include "RasterSurface.h"
 #include "BaseObject.h"
 #include "RenderHelper.h"
@@ -17,11 +19,46 @@ GEngine* GEngine::Instance = nullptr;
 Shader* RenderHelper::CurrentShader = nullptr;
 
 void GEngine::Start(const unsigned NewWidth, const unsigned NewHeight) {
+	if (!Initialize(NewWidth, NewHeight)) return;
+
+	do {
+		Update();
+		Render();
+	}
+	while (RS_Update(&OldPixels[0], OldPixels.size()));
+
+	Destroy();
+}
+
+size_t GEngine::CheckAllocations(const unsigned NewWidth, const unsigned NewHeight, const unsigned WarmupFrames,
+								 const unsigned CheckedFrames) {
+	if (!Initialize(NewWidth, NewHeight)) return 0;
+
+	// Frame arenas and reused buffers grow to what the scene needs over the first frames, only later ones are counted.
+	size_t allocations = 0;
+	auto isOpen = true;
+	for (unsigned frame = 0; isOpen && frame < WarmupFrames + CheckedFrames; ++frame) {
+		const auto isChecked = frame >= WarmupFrames;
+		if (isChecked) AllocationCounter::Begin();
+		Update();
+		Render();
+		if (isChecked) allocations += AllocationCounter::End();
+
+		isOpen = RS_Update(&OldPixels[0], OldPixels.size());
+	}
+
+	Destroy();
+
+	_ASSERTE(allocations == 0);
+	return allocations;
+}
+
+bool GEngine::Initialize(const unsigned NewWidth, const unsigned NewHeight) {
 	IsInitialized =  RS_Initialize("Dustin Roden", NewWidth, NewHeight);
 
 	if(!IsInitialized) {
 		Destroy();
-		return;
+		return false;
 	}
 
 	IsRunning = false;
@@ -32,13 +69,17 @@ void GEngine::Start(const unsigned NewWidth, const unsigned NewHeight) {
 	Pixels.assign(this->Width * this->Height, 0xFF000000);
 	OldPixels = Pixels;
 	Depth.assign(this->Width * this->Height, 1000000.0f);
-	Stars.assign(3000, {});
+	GBuffer.assign(this->Width * this->Height, {});
+	Stars.Clear();
+	Stars.Reserve(3000);
 
 	DeltaTimer.Restart();
 	DeltaTime = 0.0f;
 	ElapsedTime += DeltaTime;
 
-	MainCamera = new Camera(0.01f, 10.0f, Deg2Rad(90.0f), Width, Height, Mat4().Rotate({ -18.0f, 0.0f, 0 }).Translate({ 0, 0.5, -4.0 }));
+	// Move back and up, then tilt down around the origin.
+	CameraTransform = Transform({ 0, 0.5f, -4.0f }, {}, { 1.0f, 1.0f, 1.0f }) * Transform({}, Quat::FromEuler({ -18.0f, 0.0f, 0 }), { 1.0f, 1.0f, 1.0f });
+	MainCamera = new Camera(0.01f, 10.0f, Deg2Rad(90.0f), Width, Height, CameraTransform.ToMat4());
 
 	StartEvent.Notify();
 
@@ -46,20 +87,31 @@ void GEngine::Start(const unsigned NewWidth, const unsigned NewHeight) {
 
 	//constexpr auto halfScale = 0.5f / 2;
 	/*auto* a1 = Spawn();
-	auto* a1Comp = a1->AddComponent(new StaticMeshComponent(CUBE_MESH));
-	a1->WorldTransform.Translate({ 0, 0.25f, 0 });
-	dynamic_cast<StaticMeshComponent*>(a1Comp)->Material = CUBE_SHADER;*/
+	auto* a1Comp = a1->AddComponent<StaticMeshComponent>(LoadCubeMesh());
+	a1->SetPosition({ 0, 0.25f, 0 });
+	a1Comp->Material = CUBE_SHADER;*/
 
 
+	// Light the scene. The point light sits just above the StoneHenge and pulses over time.
+	Lights.SetAmbient(Color(0xaaaaaaaa), 0.05f);
+	Lights.AddLight(Light::MakeDirectional({-0.577f, -0.577f, 0.577f}, Color(0xFFC0C0F0), 0.25f));
+	const auto pointLight = Lights.AddLight(Light::MakePoint({0.5f, 0.3f, 0.05f}, Color(0xFFFF0000), 150.0f, 15.0f, true));
+	UpdateEvent.Subscribe([this, pointLight] {
+		Lights.GetDynamicLight(pointLight).Brightness = std::sin(ElapsedTime);
+	});
+
 	auto stoneHengeActor = Spawn();
-	stoneHengeActor->WorldTransform.Scale({0.1f, 0.1f, 0.1f});
-	auto stoneHengeSMComp = stoneHengeActor->AddComponent(new StaticMeshComponent(ModelParser::LoadMesh(StoneHenge_data, 1457, StoneHenge_indicies, 2532)));
-	dynamic_cast<StaticMeshComponent*>(stoneHengeSMComp)->Material = STONEHENGE_SHADER;
-	dynamic_cast<StaticMeshComponent*>(stoneHengeSMComp)->RenderWire = false;
+	stoneHengeActor->SetScale({0.1f, 0.1f, 0.1f});
+	const auto stoneHengeMesh = Meshes.Load("StoneHenge.h", [] {
+		return ModelParser::LoadMesh(StoneHenge_data, 1457, StoneHenge_indicies, 2532);
+	});
+	auto* stoneHengeSMComp = stoneHengeActor->AddComponent<StaticMeshComponent>(stoneHengeMesh);
+	stoneHengeSMComp->Material = STONEHENGE_SHADER;
+	stoneHengeSMComp->RenderWire = false;
 
 
 	// Calculate star positions.
-	for (Vert& star : Stars) {
+	for (unsigned i = 0; i < 3000; ++i) {
 		std::random_device rd;
 		std::mt19937 gen(rd());
 		std::uniform_int_distribution<> dist(-100, 100);
@@ -68,25 +120,23 @@ void GEngine::Start(const unsigned NewWidth, const unsigned NewHeight) {
 		const auto y = dist(gen) / 100.0f;
 		const auto z = dist(gen) / 100.0f;
 		const auto pos = Vec3F(x, y, z);
-		star.Pos = Vec3F::Scale(pos, 50.0f);
-		star.C = Color(Color::White);
-		star.Light = {1.0f, 1.0f, 1.0f};
-		star.Norm = Vec3F(0, 1.0f, 0);
+		Stars.AddPoint(Vec3F::Scale(pos, 50.0f), Color::White);
 	}
 
-	do {
-		Update();
-		Render();
-	}
-	while (RS_Update(&OldPixels[0], OldPixels.size()));
-
-	Destroy();
+	return true;
 }
 
 Actor* GEngine::Spawn() {
-	SpawnedObjects.push_back(new Actor());
+	const auto handle = Actors.Create();
+	auto* actor = Actors.Get(handle);
+	actor->Handle = handle;
+	Spatial.Insert(actor);
 
-	return SpawnedObjects.back();
+	return actor;
+}
+
+void GEngine::Despawn(Actor* Object) {
+	if (Object && Actors.Get(Object->Handle) == Object) PendingDespawns.emplace_back(Object->Handle);
 }
 
 int GEngine::AllocateObjectId() {
@@ -94,7 +144,7 @@ int GEngine::AllocateObjectId() {
 	return CurObjId;
 }
 
-GEngine::GEngine(): MainCamera(nullptr), IsInitialized(false), IsRunning(false), DeltaTime(0), ElapsedTime(0.0f), Width(0), Height(0), CurObjId(-1) {}
+GEngine::GEngine(): MainCamera(nullptr), IsInitialized(false), IsRunning(false), DeltaTime(0), ElapsedTime(0.0f), Width(0), Height(0), CurObjId(-1), CurrentRenderPath(RenderPath::Forward) {}
 
 void GEngine::Update() {
 	// Update engine delta time.
@@ -104,28 +154,58 @@ void GEngine::Update() {
 
 	UpdateEvent.Notify();
 
-	auto transform = MainCamera->WorldTransform;
-	auto worldPos = transform.GetPosition();
-	MainCamera->WorldTransform.Translate({-worldPos.X, -worldPos.Y, -worldPos.Z});
-	MainCamera->WorldTransform.Rotate({0, -5.0f * DeltaTime, 0});
-	MainCamera->WorldTransform.Translate(worldPos);
+	// Destroy despawned actors now that nothing is iterating them, handles despawned twice are already stale.
+	for (const auto& handle : PendingDespawns) {
+		auto* actor = Actors.Get(handle);
+		if (!actor) continue;
+
+		actor->Destroy();
+		Spatial.Remove(actor);
+		Actors.Destroy(handle);
+	}
+	PendingDespawns.clear();
+
+	// Objects have moved, bring their world matrices and then their bounds up to date before anything queries them.
+	Transforms.Update();
+	Spatial.Update();
+
+	// Orbit the camera around the world Y axis. Accumulating the rotation in a transform and converting it once keeps
+	// it from drifting the way multiplying into the matrix every frame does.
+	CameraTransform *= Transform({}, Quat::FromEuler({0, -5.0f * DeltaTime, 0}), {1.0f, 1.0f, 1.0f});
+	MainCamera->WorldTransform = CameraTransform.ToMat4();
 }
 
 void GEngine::Render() {
 	RenderHelper::ClearBuffer();
 
 	// Draw stars
-	for (Vert& star : Stars) {
-		// Convert to screen space position
-		Mat4 t = {};
-		const auto screenSpace = Camera::WorldToScreen(*MainCamera, star, t);
-		RenderHelper::DrawPixel(star.C.Get(), screenSpace.X, screenSpace.Y);
-	}
+	Stars.Render(*MainCamera, Mat4());
 
 
 	//RenderHelper::DrawWireCube(MainCamera, CubeTransform, 0.5f);
 	//RenderHelper::DrawGrid(MainCamera, 10, 10, 0.5, 0.5, 0xFF888888);
+
+	// Sort the dynamic lights into the clusters of this frames view.
+	Lights.BuildClusters(*MainCamera);
+
+	// Draw the occluders in view first so hidden objects can skip both passes.
+	Occlusion.Clear(*MainCamera);
+	Spatial.QueryFrustum(Frustum(*MainCamera), VisibleObjects);
+	for (const auto& object : VisibleObjects) {
+		object->RenderOcclusion();
+	}
+
+	// Objects only record their draws, which then run sorted by pass, material and depth. With a depth pre-pass the
+	// depth of the scene is laid down first so the shading pass only shades visible fragments.
 	RenderEvent.Notify();
+	Commands.Sort();
+	Commands.Execute(*MainCamera);
+	Commands.Clear();
+
+	// Shade the surfaces left in the G-buffer.
+	if (CurrentRenderPath == RenderPath::Deferred) {
+		RenderHelper::ResolveGBuffer();
+	}
 
 	//RenderHelper::DrawDepth(Depth);
 
@@ -136,10 +216,13 @@ void GEngine::Render() {
 	RenderHelper::DrawWireCube(MainCamera, T, 0.5f, DEFAULT_SHADER);*/
 
 	//const auto sm = dynamic_cast<StaticMeshComponent*>(SpawnedObjects.back()->GetComponent(0))->Sm;
-	//RenderHelper::DrawWireMesh(MainCamera, SpawnedObjects.back()->WorldTransform, sm.Vertices, sm.Indices);
+	//RenderHelper::DrawWireMesh(MainCamera, SpawnedObjects.back()->GetWorldTransform(), sm.Vertices, sm.Edges);
 
 	// Update the old pixels to match the next frame.
 	OldPixels = Pixels;
+
+	// Everything allocated for this frame is done with.
+	FrameArena::Get().Reset();
 }
 
 void GEngine::Destroy() {
@@ -147,10 +230,11 @@ void GEngine::Destroy() {
 
 	DestroyEvent.Notify();
 
-	for (const auto & object : SpawnedObjects) {
-		delete object;
-	}
-	SpawnedObjects.clear();
+	Spatial.Clear();
+	Actors.Clear();
+	PendingDespawns.clear();
+	Meshes.Clear();
+	Transforms.Clear();
 	delete MainCamera;
 	MainCamera = nullptr;
 
@@ -10,9 +10,18 @@
 
 #include "EngineDefines.h"
 #include "Event.h"
+#include "Light.h"
+#include "MeshRegistry.h"
+#include "ObjectPool.h"
+#include "OcclusionBuffer.h"
+#include "PointCloud.h"
+#include "RenderCommandBuffer.h"
+#include "SpatialIndex.h"
+#include "TransformHierarchy.h"
 #include "XTime.h"
 
 class Actor;
+class BaseObject;
 
 class GEngine {
 	static GEngine* Instance;
@@ -25,15 +34,35 @@ public:
 
 	void Start(unsigned NewWidth, unsigned NewHeight);
 
-	Event StartEvent;
-	Event UpdateEvent;
-	Event RenderEvent;
-	Event DestroyEvent;
+	/**
+	 * \brief Self check that runs the engine like Start but only for WarmupFrames, then counts the heap allocations
+	 * of the next CheckedFrames and shuts down. Steady state frames should make none, debug builds assert it.
+	 * \return Allocations made by the checked frames.
+	 */
+	size_t CheckAllocations(unsigned NewWidth, unsigned NewHeight, unsigned WarmupFrames, unsigned CheckedFrames);
+
+	Event<> StartEvent;
+	Event<> UpdateEvent;
+	Event<> RenderEvent;
+	Event<> DestroyEvent;
 
 	Camera* MainCamera;
 
+	// Placement of the main camera, converted to its world transform every update.
+	Transform CameraTransform;
+
+	LightRegistry Lights;
+
+	// Every loaded mesh, shared by handle between the components drawing it.
+	MeshRegistry Meshes;
+
 	Actor* Spawn();
 
+	/**
+	 * \brief Destroys a spawned actor once the current update is done, so it can be called from its own callbacks.
+	 */
+	void Despawn(Actor* Object);
+
 	void Update();
 	void Render();
 	void Destroy();
@@ -57,16 +86,47 @@ public:
 	std::vector<unsigned> Pixels;
 	std::vector<unsigned> OldPixels;
 
-	std::vector<Vert> Stars;
+	PointCloud Stars;
+
+	// Coarse depth of the designated occluders, rebuilt every frame before rendering.
+	OcclusionBuffer Occlusion;
 
-	std::vector<Actor*> SpawnedObjects;
+	// Every spawned actor, packed into chunks rather than allocated one by one.
+	ObjectPool<Actor> Actors;
+
+	// Actors despawned during this update, destroyed after it.
+	std::vector<PoolHandle> PendingDespawns;
+
+	// Local and world transforms of every object, world matrices are brought up to date after objects update.
+	TransformHierarchy Transforms;
+
+	// Bounds of the spawned objects for frustum, proximity and ray queries, updated every frame.
+	SpatialIndex Spatial;
+
+	// Objects overlapping the view this frame, reused between frames to keep its memory.
+	std::vector<BaseObject*> VisibleObjects;
+
+	// Draws recorded by objects during RenderEvent, sorted and executed once every object has rendered.
+	RenderCommandBuffer Commands;
 
 	// Collection for depth buffer.
 	std::vector<float> Depth;
 
+	// Surfaces waiting to be shaded when rendering deferred.
+	std::vector<GBufferTexel> GBuffer;
+
+	RenderPath CurrentRenderPath;
+
 	XTime DeltaTimer{};
 
 protected:
 	GEngine();
+
+private:
+	/**
+	 * \brief Opens the window and sets up the scene.
+	 * \return False if the window could not be opened, the engine is already destroyed then.
+	 */
+	bool Initialize(unsigned NewWidth, unsigned NewHeight);
 };
 
@@ -0,0 +1,207 @@
+#include "InstancedStaticMeshComponent.h"
+
+#include <cfloat>
+#include <new>
+
+#include "BaseObject.h"
+#include "FrameArena.h"
+#include "GEngine.h"
+
+namespace {
+	/**
+	 * \brief Gets the largest scale a transform applies along any of its axes.
+	 */
+	float GetMaxScale(Mat4& Transform) {
+		const auto scaleX = Vec3F(Transform[0], Transform[1], Transform[2]).Length();
+		const auto scaleY = Vec3F(Transform[4], Transform[5], Transform[6]).Length();
+		const auto scaleZ = Vec3F(Transform[8], Transform[9], Transform[10]).Length();
+		return Max(scaleX, Max(scaleY, scaleZ));
+	}
+}
+
+InstancedStaticMeshComponent::InstancedStaticMeshComponent(MeshHandle Mesh):
+	Mesh(std::move(Mesh)),
+	Material(DEFAULT_SHADER),
+	LodPixelError(1.0f),
+	IsBoundsDirty(true) {}
+
+void InstancedStaticMeshComponent::Start() {
+
+}
+
+void InstancedStaticMeshComponent::Update() {
+
+}
+
+void InstancedStaticMeshComponent::Render() {
+	const auto count = GetInstanceCount();
+	if (!Mesh || count == 0) return;
+
+	auto* engine = GEngine::Get();
+	const auto& camera = *engine->MainCamera;
+	const Frustum frustum(camera);
+	const auto view = camera.GetViewMatrix();
+	const auto parentTransform = GetParent()->GetWorldTransform();
+
+	const auto center = (Mesh->BoundsMin + Mesh->BoundsMax) * 0.5f;
+	const auto radius = (Mesh->BoundsMax - center).Length();
+	const auto levelCount = (unsigned)Mesh->Lods.size() + 1;
+
+	// Cull every instance against the view and the occluders and pick its LOD in one pass over the instances.
+	FrameVector<Mat4> worlds;
+	FrameVector<unsigned> visible, levels;
+	FrameVector<float> depths;
+	worlds.reserve(count);
+	visible.reserve(count);
+	levels.reserve(count);
+	depths.reserve(count);
+
+	FrameVector<unsigned> levelOffsets(levelCount + 1, 0);
+	for (unsigned i = 0; i < count; ++i) {
+		auto world = Transforms[i] * parentTransform;
+		const auto worldCenter = world.Project(center);
+		if (!frustum.Intersects(worldCenter, radius * GetMaxScale(world))) continue;
+		if (!engine->Occlusion.IsVisible(world, Mesh->BoundsMin, Mesh->BoundsMax)) continue;
+
+		const auto level = Mesh->SelectLod(world, camera, LodPixelError);
+		worlds.emplace_back(world);
+		visible.emplace_back(i);
+		levels.emplace_back(level);
+		depths.emplace_back(view.Project(worldCenter).Z);
+		levelOffsets[level + 1]++;
+	}
+
+	if (visible.empty()) return;
+
+	for (unsigned l = 0; l < levelCount; ++l) levelOffsets[l + 1] += levelOffsets[l];
+
+	// Group the instances by LOD into arrays that stay until the commands have run at the end of the frame.
+	auto& arena = FrameArena::Get();
+	auto* instances = arena.AllocateArray<Mat4>(visible.size());
+	auto* colors = arena.AllocateArray<Color>(visible.size());
+
+	FrameVector<unsigned> cursors(levelOffsets.begin(), levelOffsets.end() - 1);
+	FrameVector<float> nearest(levelCount, FLT_MAX);
+	for (unsigned v = 0; v < visible.size(); ++v) {
+		const auto level = levels[v];
+		const auto slot = cursors[level]++;
+		new (&instances[slot]) Mat4(worlds[v]);
+		new (&colors[slot]) Color(Colors[visible[v]]);
+		nearest[level] = Min(nearest[level], depths[v]);
+	}
+
+	for (unsigned l = 0; l < levelCount; ++l) {
+		const auto first = levelOffsets[l];
+		if (levelOffsets[l + 1] == first) continue;
+
+		RenderCommand command;
+		command.Kind = RenderCommand::Type::FillMeshInstanced;
+		command.Material = &Material;
+		command.Mesh = &Mesh->GetLod(l);
+		command.Instances = instances + first;
+		command.InstanceColors = colors + first;
+		command.InstanceCount = levelOffsets[l + 1] - first;
+
+		if (engine->CurrentRenderPath == RenderPath::DepthPrepass) {
+			engine->Commands.Submit(RenderPass::DepthPrepass, nearest[l], command);
+		}
+		engine->Commands.Submit(RenderPass::Opaque, nearest[l], command);
+	}
+}
+
+void InstancedStaticMeshComponent::Destroy() {
+
+}
+
+bool InstancedStaticMeshComponent::GetLocalBounds(Aabb& Bounds) const {
+	if (!Mesh || Mesh->Vertices.empty() || Transforms.empty()) return false;
+
+	if (IsBoundsDirty) {
+		const Aabb meshBounds(Mesh->BoundsMin, Mesh->BoundsMax);
+
+		this->Bounds = {};
+		for (const auto& transform : Transforms) {
+			this->Bounds.Grow(meshBounds.GetTransformed(transform));
+		}
+		IsBoundsDirty = false;
+	}
+
+	Bounds = this->Bounds;
+	return true;
+}
+
+bool InstancedStaticMeshComponent::Raycast(const Vec3F& Origin, const Vec3F& Direction, RayHit& Hit) const {
+	if (!Mesh) return false;
+
+	auto direction = Direction;
+	direction.W = 0.0f;
+
+	// Every instance is tested in its own model space, see StaticMeshComponent::Raycast.
+	const auto parentTransform = GetParent()->GetWorldTransform();
+	auto isHit = false;
+	for (const auto& transform : Transforms) {
+		const auto toModel = (transform * parentTransform).GetInverse();
+		if (Mesh->Triangles.Raycast(toModel.Project(Origin), toModel.Project(direction), Hit)) isHit = true;
+	}
+
+	return isHit;
+}
+
+unsigned InstancedStaticMeshComponent::AddInstance(const Mat4& Transform, const Color& Tint) {
+	Transforms.emplace_back(Transform);
+	Colors.emplace_back(Tint);
+	IsBoundsDirty = true;
+
+	return (unsigned)Transforms.size() - 1;
+}
+
+void InstancedStaticMeshComponent::SetInstances(const Mat4* Transforms, const Color* Colors, const unsigned Count) {
+	this->Transforms.assign(Transforms, Transforms + Count);
+	if (Colors) {
+		this->Colors.assign(Colors, Colors + Count);
+	}
+	else {
+		this->Colors.assign(Count, Color(Color::White));
+	}
+
+	IsBoundsDirty = true;
+}
+
+void InstancedStaticMeshComponent::SetInstanceTransform(const unsigned Index, const Mat4& Transform) {
+	if (Index >= Transforms.size()) throw std::exception("Array out of bounds");
+
+	Transforms[Index] = Transform;
+	IsBoundsDirty = true;
+}
+
+void InstancedStaticMeshComponent::SetInstanceColor(const unsigned Index, const Color& Tint) {
+	if (Index >= Colors.size()) throw std::exception("Array out of bounds");
+
+	Colors[Index] = Tint;
+}
+
+void InstancedStaticMeshComponent::RemoveInstance(const unsigned Index) {
+	if (Index >= Transforms.size()) throw std::exception("Array out of bounds");
+
+	Transforms[Index] = Transforms.back();
+	Transforms.pop_back();
+	Colors[Index] = Colors.back();
+	Colors.pop_back();
+	IsBoundsDirty = true;
+}
+
+void InstancedStaticMeshComponent::ClearInstances() {
+	Transforms.clear();
+	Colors.clear();
+	IsBoundsDirty = true;
+}
+
+const Mat4& InstancedStaticMeshComponent::GetInstanceTransform(const unsigned Index) const {
+	if (Index >= Transforms.size()) throw std::exception("Array out of bounds");
+
+	return Transforms[Index];
+}
+
+unsigned InstancedStaticMeshComponent::GetInstanceCount() const {
+	return (unsigned)Transforms.size();
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "Component.h"
+#include "EngineDefines.h"
+#include "MeshRegistry.h"
+#include "Shader.h"
+
+/**
+ * \brief Draws many copies of one shared mesh, each with its own transform relative to the parent and its own tint.
+ * Instances are kept in contiguous arrays that are culled, LOD selected and recorded in one pass every frame, and
+ * every LOD level becomes a single render command, so a thousand props cost one component instead of a thousand
+ * actors and mesh copies. Instances keep no per vertex data: static lighting is evaluated for each visible instance
+ * while it draws, see RenderHelper::FillMeshInstanced, so memory is the shared mesh plus a transform and a tint per
+ * instance.
+ */
+class InstancedStaticMeshComponent :
+    public Component
+{
+public:
+	explicit InstancedStaticMeshComponent(MeshHandle Mesh);
+
+	void Start() override;
+	void Update() override;
+	void Render() override;
+	void Destroy() override;
+	bool GetLocalBounds(Aabb& Bounds) const override;
+	bool Raycast(const Vec3F& Origin, const Vec3F& Direction, RayHit& Hit) const override;
+
+	/**
+	 * \brief Adds an instance.
+	 * \param Transform Transform of the instance relative to the parent object.
+	 * \return Index of the instance, stable until an instance is removed.
+	 */
+	unsigned AddInstance(const Mat4& Transform, const Color& Tint = Color(Color::White));
+
+	/**
+	 * \brief Replaces every instance with copies of the given arrays.
+	 * \param Colors Tint of every instance, or nullptr for white.
+	 */
+	void SetInstances(const Mat4* Transforms, const Color* Colors, unsigned Count);
+
+	void SetInstanceTransform(unsigned Index, const Mat4& Transform);
+	void SetInstanceColor(unsigned Index, const Color& Tint);
+
+	/**
+	 * \brief Removes an instance by moving the last one into its place.
+	 */
+	void RemoveInstance(unsigned Index);
+	void ClearInstances();
+
+	const Mat4& GetInstanceTransform(unsigned Index) const;
+	unsigned GetInstanceCount() const;
+
+	MeshHandle Mesh;
+
+	Shader Material;
+
+	// Largest error in pixels a LOD may show on screen before a more detailed level is used.
+	float LodPixelError;
+
+private:
+	std::vector<Mat4> Transforms;
+	std::vector<Color> Colors;
+
+	// Bounds of every instance in the space of the parent, rebuilt on the next query after instances change.
+	mutable Aabb Bounds;
+	mutable bool IsBoundsDirty;
+};
@@ -0,0 +1,300 @@
+#include "Light.h"
+
+#include "FrameArena.h"
+#include "VertexKernel.h"
+
+namespace {
+	unsigned ToCluster(const float Ndc, const unsigned Count) {
+		return Floor(Clamp((Ndc * 0.5f + 0.5f) * (float)Count, 0.0f, (float)(Count - 1)));
+	}
+
+	Vec3F ToLight(const Color& C) {
+		return {C.R / 255.0f, C.G / 255.0f, C.B / 255.0f};
+	}
+}
+
+Light::Light(): Type(LightType::Point), LightColor(Color::White), Intensity(1.0f), Radius(1.0f), InnerCone(1.0f),
+				OuterCone(0.0f), Brightness(1.0f), IsDynamic(false), IsEnabled(true) {}
+
+Light Light::MakeDirectional(Vec3F Direction, const Color& C, const float Intensity, const bool IsDynamic) {
+	Light l;
+	l.Type = LightType::Directional;
+	l.Direction = Vec3F::Normalize(Direction);
+	l.LightColor = C;
+	l.Intensity = Intensity;
+	l.IsDynamic = IsDynamic;
+
+	return l;
+}
+
+Light Light::MakePoint(const Vec3F& Position, const Color& C, const float Intensity, const float Radius,
+					   const bool IsDynamic) {
+	Light l;
+	l.Type = LightType::Point;
+	l.Position = Position;
+	l.LightColor = C;
+	l.Intensity = Intensity;
+	l.Radius = Radius;
+	l.IsDynamic = IsDynamic;
+
+	return l;
+}
+
+Light Light::MakeSpot(const Vec3F& Position, Vec3F Direction, const Color& C, const float Intensity,
+					  const float Radius, const float InnerAngle, const float OuterAngle, const bool IsDynamic) {
+	Light l = MakePoint(Position, C, Intensity, Radius, IsDynamic);
+	l.Type = LightType::Spot;
+	l.Direction = Vec3F::Normalize(Direction);
+	l.InnerCone = std::cos(Deg2Rad(InnerAngle));
+	l.OuterCone = std::cos(Deg2Rad(OuterAngle));
+
+	return l;
+}
+
+Color Light::Evaluate(const Vec3F& Pos, const Vec3F& Normal, const Color& Albedo) const {
+	if (Type == LightType::Directional) {
+		const auto ratio = Clamp(Vec3F::DotProduct(Direction * -1.0f, Normal));
+		return LightColor * Intensity * Albedo * ratio * Brightness;
+	}
+
+	auto toLight = Position - Pos;
+	const auto distance = toLight.Length();
+	if (distance >= Radius) return {0, 0, 0, 0};
+
+	const auto attenuation = 1.0f - Clamp(distance / Radius);
+	if (distance > 0.0f) toLight /= distance;
+
+	const auto ratio = Clamp(Vec3F::DotProduct(toLight, Normal));
+	if (ratio <= 0.0f) return {0, 0, 0, 0};
+
+	auto result = LightColor * Intensity * Albedo * ratio;
+	result *= attenuation * attenuation;
+
+	if (Type == LightType::Spot) {
+		// Fade between the inner and outer cone.
+		const auto cosAngle = Vec3F::DotProduct(toLight * -1.0f, Direction);
+		result *= Clamp((cosAngle - OuterCone) / Max(InnerCone - OuterCone, 0.0001f));
+	}
+
+	return result * Brightness;
+}
+
+LightRegistry::LightRegistry(): XScale(1.0f), YScale(1.0f), NearPlane(0.0f), FarPlane(0.0f), DepthSliceScale(0.0f),
+								AmbientColor(0, 0, 0, 0), AmbientIntensity(0.0f), StaticVersion(0) {}
+
+unsigned LightRegistry::AddLight(const Light& L) {
+	unsigned id;
+	if (FreeIds.empty()) {
+		id = (unsigned)Lights.size();
+		Lights.emplace_back(L);
+	}
+	else {
+		id = FreeIds.back();
+		FreeIds.pop_back();
+		Lights[id] = L;
+	}
+
+	RebuildLightLists();
+	return id;
+}
+
+void LightRegistry::RemoveLight(const unsigned Id) {
+	if (Id >= Lights.size() || !Lights[Id].IsEnabled) return;
+
+	Lights[Id].IsEnabled = false;
+	FreeIds.emplace_back(Id);
+
+	RebuildLightLists();
+}
+
+const Light& LightRegistry::GetLight(const unsigned Id) const {
+	if (Id >= Lights.size()) { throw std::exception("Array out of bounds"); }
+
+	return Lights[Id];
+}
+
+void LightRegistry::SetLight(const unsigned Id, const Light& L) {
+	if (Id >= Lights.size()) { throw std::exception("Array out of bounds"); }
+
+	Lights[Id] = L;
+	RebuildLightLists();
+}
+
+Light& LightRegistry::GetDynamicLight(const unsigned Id) {
+	if (Id >= Lights.size()) { throw std::exception("Array out of bounds"); }
+
+	return Lights[Id];
+}
+
+void LightRegistry::SetAmbient(const Color& C, const float Intensity) {
+	AmbientColor = C;
+	AmbientIntensity = Intensity;
+	StaticVersion++;
+}
+
+unsigned LightRegistry::GetStaticVersion() const {
+	return StaticVersion;
+}
+
+void LightRegistry::RebuildLightLists() {
+	StaticLights.clear();
+	DynamicGlobalLights.clear();
+	DynamicLocalLights.clear();
+
+	for (unsigned i = 0; i < Lights.size(); ++i) {
+		const auto& l = Lights[i];
+		if (!l.IsEnabled) continue;
+
+		if (!l.IsDynamic) {
+			StaticLights.emplace_back(i);
+		}
+		else if (l.Type == LightType::Directional) {
+			DynamicGlobalLights.emplace_back(i);
+		}
+		else {
+			DynamicLocalLights.emplace_back(i);
+		}
+	}
+
+	// Any change could have touched a static light, cached static lighting has to be rebuilt.
+	StaticVersion++;
+}
+
+void LightRegistry::BuildClusters(const Camera& C) {
+	ClusterView = C.GetViewMatrix();
+
+	auto projection = C.GetPerspectiveProjection();
+	XScale = projection[0];
+	YScale = projection[5];
+	NearPlane = C.NearPlane;
+	FarPlane = C.FarPlane;
+
+	// Depth slices grow exponentially so near clusters stay small on screen in every dimension.
+	DepthSliceScale = (float)ClusterCountZ / std::log(FarPlane / NearPlane);
+
+	Clusters.assign(ClusterCountX * ClusterCountY * ClusterCountZ, {0, 0});
+	ClusterRanges.clear();
+
+	// Count the lights touching each cluster.
+	for (const auto id : DynamicLocalLights) {
+		ClusterRange range{};
+		if (!GetClusterRange(Lights[id], range)) continue;
+
+		range.LightId = id;
+		ClusterRanges.emplace_back(range);
+
+		for (unsigned z = range.MinZ; z <= range.MaxZ; ++z) {
+			for (unsigned y = range.MinY; y <= range.MaxY; ++y) {
+				for (unsigned x = range.MinX; x <= range.MaxX; ++x) {
+					Clusters[(z * ClusterCountY + y) * ClusterCountX + x].Count++;
+				}
+			}
+		}
+	}
+
+	// Give every cluster its slice of the light list.
+	unsigned offset = 0;
+	for (auto& cluster : Clusters) {
+		cluster.Offset = offset;
+		offset += cluster.Count;
+		cluster.Count = 0;
+	}
+	ClusterLights.resize(offset);
+
+	for (const auto& range : ClusterRanges) {
+		for (unsigned z = range.MinZ; z <= range.MaxZ; ++z) {
+			for (unsigned y = range.MinY; y <= range.MaxY; ++y) {
+				for (unsigned x = range.MinX; x <= range.MaxX; ++x) {
+					auto& cluster = Clusters[(z * ClusterCountY + y) * ClusterCountX + x];
+					ClusterLights[cluster.Offset + cluster.Count++] = range.LightId;
+				}
+			}
+		}
+	}
+}
+
+bool LightRegistry::GetClusterRange(const Light& L, ClusterRange& Range) const {
+	const auto center = ClusterView.Project(L.Position);
+	const auto radius = L.Radius;
+
+	const auto minZ = Max(center.Z - radius, NearPlane);
+	const auto maxZ = Min(center.Z + radius, FarPlane);
+	if (minZ > maxZ) return false;
+
+	// X / Z over the box around the sphere is most extreme at one of its nearest or farthest corners.
+	const auto minX = Min((center.X - radius) / minZ, (center.X - radius) / maxZ) * XScale;
+	const auto maxX = Max((center.X + radius) / minZ, (center.X + radius) / maxZ) * XScale;
+	const auto minY = Min((center.Y - radius) / minZ, (center.Y - radius) / maxZ) * YScale;
+	const auto maxY = Max((center.Y + radius) / minZ, (center.Y + radius) / maxZ) * YScale;
+	if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f) return false;
+
+	Range.MinX = ToCluster(minX, ClusterCountX);
+	Range.MaxX = ToCluster(maxX, ClusterCountX);
+	Range.MinY = ToCluster(minY, ClusterCountY);
+	Range.MaxY = ToCluster(maxY, ClusterCountY);
+	Range.MinZ = Floor(Clamp(std::log(minZ / NearPlane) * DepthSliceScale, 0.0f, (float)(ClusterCountZ - 1)));
+	Range.MaxZ = Floor(Clamp(std::log(maxZ / NearPlane) * DepthSliceScale, 0.0f, (float)(ClusterCountZ - 1)));
+
+	return true;
+}
+
+const unsigned* LightRegistry::FindClusterLights(const Vec3F& WorldPos, unsigned& Count) const {
+	const auto view = ClusterView.Project(WorldPos);
+
+	if (!Clusters.empty() && view.Z >= NearPlane && view.Z <= FarPlane) {
+		const auto ndcX = view.X * XScale / view.Z;
+		const auto ndcY = view.Y * YScale / view.Z;
+
+		if (ndcX >= -1.0f && ndcX <= 1.0f && ndcY >= -1.0f && ndcY <= 1.0f) {
+			const auto x = ToCluster(ndcX, ClusterCountX);
+			const auto y = ToCluster(ndcY, ClusterCountY);
+			const auto z = Floor(Clamp(std::log(view.Z / NearPlane) * DepthSliceScale, 0.0f, (float)(ClusterCountZ - 1)));
+
+			const auto& cluster = Clusters[(z * ClusterCountY + y) * ClusterCountX + x];
+			Count = cluster.Count;
+			return ClusterLights.data() + cluster.Offset;
+		}
+	}
+
+	// Outside of the view the grid knows nothing, fall back to testing every dynamic light.
+	Count = (unsigned)DynamicLocalLights.size();
+	return DynamicLocalLights.data();
+}
+
+Vec3F LightRegistry::EvaluateStatic(const Vec3F& WorldPos, const Vec3F& WorldNormal, const Color& Albedo) const {
+	Color result{0, 0, 0, 0};
+	for (const auto id : StaticLights) {
+		result += Lights[id].Evaluate(WorldPos, WorldNormal, Albedo);
+	}
+
+	result += AmbientColor * AmbientIntensity;
+
+	return ToLight(result);
+}
+
+void LightRegistry::EvaluateStatic(const VertexStreams& Streams, const Mat4& Transform, const Color* Tint,
+								   Vec3F* Result) const {
+	FrameVector<const Light*> lights;
+	lights.reserve(StaticLights.size());
+	for (const auto id : StaticLights) {
+		lights.emplace_back(&Lights[id]);
+	}
+
+	VertexKernel::EvaluateLights(Streams, Transform, lights.data(), (unsigned)lights.size(),
+								 AmbientColor * AmbientIntensity, Tint, Result);
+}
+
+Vec3F LightRegistry::EvaluateDynamic(const Vec3F& WorldPos, const Vec3F& WorldNormal, const Color& Albedo) const {
+	Color result{0, 0, 0, 0};
+	for (const auto id : DynamicGlobalLights) {
+		result += Lights[id].Evaluate(WorldPos, WorldNormal, Albedo);
+	}
+
+	unsigned count;
+	const auto* ids = FindClusterLights(WorldPos, count);
+	for (unsigned i = 0; i < count; ++i) {
+		result += Lights[ids[i]].Evaluate(WorldPos, WorldNormal, Albedo);
+	}
+
+	return ToLight(result);
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include <vector>
+
+#include "EngineDefines.h"
+
+struct VertexStreams;
+
+enum class LightType {
+	Directional,
+	Point,
+	Spot
+};
+
+/**
+ * \brief A light in world space. Static lights are baked into the static light caches of meshes, dynamic lights are
+ * assigned to the cluster grid every frame and evaluated by vertex shaders.
+ */
+struct Light {
+	Light();
+
+	LightType Type;
+
+	// Position of point and spot lights.
+	Vec3F Position;
+
+	// Normalized direction the light travels in for directional and spot lights.
+	Vec3F Direction;
+
+	Color LightColor;
+	float Intensity;
+
+	// Distance at which point and spot lights have faded out completely.
+	float Radius;
+
+	// Cosines of the angles at which spot lights start to fade and are fully faded.
+	float InnerCone, OuterCone;
+
+	// Multiplier applied to the final contribution of the light, used to animate dynamic lights.
+	float Brightness;
+
+	bool IsDynamic;
+	bool IsEnabled;
+
+	static Light MakeDirectional(Vec3F Direction, const Color& C, float Intensity, bool IsDynamic = false);
+
+	static Light MakePoint(const Vec3F& Position, const Color& C, float Intensity, float Radius, bool IsDynamic = false);
+
+	/**
+	 * \brief Creates a spot light.
+	 * \param InnerAngle Angle in degrees from the spot direction at which the light starts to fade.
+	 * \param OuterAngle Angle in degrees from the spot direction at which the light is fully faded.
+	 */
+	static Light MakeSpot(const Vec3F& Position, Vec3F Direction, const Color& C, float Intensity, float Radius,
+						  float InnerAngle, float OuterAngle, bool IsDynamic = false);
+
+	/**
+	 * \brief Calculates the light reaching a surface.
+	 * \param Pos World position of the surface.
+	 * \param Normal World normal of the surface.
+	 * \param Albedo Color of the surface.
+	 * \return Light color of the surface in 0-255.
+	 */
+	Color Evaluate(const Vec3F& Pos, const Vec3F& Normal, const Color& Albedo) const;
+};
+
+/**
+ * \brief Holds every light in the scene. Dynamic point and spot lights are sorted into a grid of view space clusters
+ * built from the camera each frame, so shading a vertex only visits the lights whose range overlaps its cluster.
+ */
+class LightRegistry
+{
+public:
+	LightRegistry();
+
+	static constexpr unsigned ClusterCountX = 16;
+	static constexpr unsigned ClusterCountY = 16;
+	static constexpr unsigned ClusterCountZ = 24;
+
+	/**
+	 * \brief Adds a light to the scene.
+	 * \return Id of the light, valid until it is removed.
+	 */
+	unsigned AddLight(const Light& L);
+	void RemoveLight(unsigned Id);
+
+	const Light& GetLight(unsigned Id) const;
+
+	/**
+	 * \brief Replaces a light. Changing a static light invalidates all cached static lighting.
+	 */
+	void SetLight(unsigned Id, const Light& L);
+
+	/**
+	 * \brief Gets a dynamic light to change freely between frames. Use SetLight to change whether it is dynamic.
+	 */
+	Light& GetDynamicLight(unsigned Id);
+
+	void SetAmbient(const Color& C, float Intensity);
+
+	/**
+	 * \brief Gets the version of the static lighting, incremented whenever it changes.
+	 */
+	unsigned GetStaticVersion() const;
+
+	/**
+	 * \brief Assigns the dynamic lights to the clusters of the cameras view. Called once per frame before rendering.
+	 */
+	void BuildClusters(const Camera& C);
+
+	/**
+	 * \brief Calculates the ambient and static lighting of a surface, iterating every static light.
+	 * \return Light of the surface in 0-1.
+	 */
+	Vec3F EvaluateStatic(const Vec3F& WorldPos, const Vec3F& WorldNormal, const Color& Albedo) const;
+
+	/**
+	 * \brief Calculates the ambient and static lighting of every vertex of a mesh eight at a time with the batched
+	 * lighting kernel, the same results as EvaluateStatic with the vertex colors as albedo.
+	 * \param Transform Model to world transform of the mesh.
+	 * \param Tint Multiplied into the vertex colors first like Color::Modulate, or nullptr.
+	 * \param Result Receives the light of every vertex in 0-1, must hold Streams.Count entries.
+	 */
+	void EvaluateStatic(const VertexStreams& Streams, const Mat4& Transform, const Color* Tint, Vec3F* Result) const;
+
+	/**
+	 * \brief Calculates the dynamic lighting of a surface using only the lights in its cluster.
+	 * \return Light of the surface in 0-1.
+	 */
+	Vec3F EvaluateDynamic(const Vec3F& WorldPos, const Vec3F& WorldNormal, const Color& Albedo) const;
+
+private:
+	struct Cluster {
+		unsigned Offset;
+		unsigned Count;
+	};
+
+	// Inclusive range of clusters touched by a light.
+	struct ClusterRange {
+		unsigned MinX, MaxX, MinY, MaxY, MinZ, MaxZ;
+		unsigned LightId;
+	};
+
+	std::vector<Light> Lights;
+	std::vector<unsigned> FreeIds;
+
+	// Ids of enabled lights split by how they are evaluated, rebuilt whenever a light is added, removed or set.
+	std::vector<unsigned> StaticLights;
+	std::vector<unsigned> DynamicGlobalLights;
+	std::vector<unsigned> DynamicLocalLights;
+
+	std::vector<Cluster> Clusters;
+	std::vector<unsigned> ClusterLights;
+	std::vector<ClusterRange> ClusterRanges;
+
+	// View the clusters were built from.
+	Mat4 ClusterView;
+	float XScale, YScale;
+	float NearPlane, FarPlane;
+	float DepthSliceScale;
+
+	Color AmbientColor;
+	float AmbientIntensity;
+
+	unsigned StaticVersion;
+
+	void RebuildLightLists();
+
+	bool GetClusterRange(const Light& L, ClusterRange& Range) const;
+
+	/**
+	 * \brief Finds the dynamic local lights that can reach a world position.
+	 * \param Count Receives the number of light ids.
+	 * \return The light ids of the cluster, or every dynamic local light if the position is outside the grid.
+	 */
+	const unsigned* FindClusterLights(const Vec3F& WorldPos, unsigned& Count) const;
+};
@@ -1,9 +1,16 @@
 
 
+#include <cstring>
+
 #include "GEngine.h"
 
-int main()
+int main(int argc, char* argv[])
 {
+    // Self check, renders the scene for a while and fails if steady state frames touch the heap.
+    if (argc > 1 && std::strcmp(argv[1], "--check-allocations") == 0) {
+        return GEngine::Get()->CheckAllocations(500, 500, 8, 32) == 0 ? 0 : 1;
+    }
+
     GEngine::Get()->Start(500, 500);
 }
 
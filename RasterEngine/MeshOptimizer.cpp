@@ -0,0 +1,308 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "EngineDefines.h"
+
+namespace {
+	/**
+	 * \brief Forsyth vertex score, favoring vertices recently used and vertices with few triangles left.
+	 * \param CachePosition Position in the LRU cache or -1 when not cached.
+	 */
+	float VertexScore(const int CachePosition, const unsigned RemainingValence) {
+		if (RemainingValence == 0) return -1.0f;
+
+		float score = 0.0f;
+		if (CachePosition >= 0) {
+			if (CachePosition < 3) {
+				// The last triangle's vertices get a fixed score so the next one does not always reuse the same edge.
+				score = 0.75f;
+			}
+			else {
+				const auto scaler = 1.0f / (float)(MeshOptimizer::CacheSize - 3);
+				score = std::pow(1.0f - (float)(CachePosition - 3) * scaler, 1.5f);
+			}
+		}
+
+		// Boost vertices with few triangles left so they are finished off instead of left stranded.
+		return score + 2.0f * std::pow((float)RemainingValence, -0.5f);
+	}
+
+	Vec3F TriangleNormal(const Vec3F& A, const Vec3F& B, const Vec3F& C) {
+		return Vec3F::CrossProduct(B - A, C - A);
+	}
+}
+
+void MeshOptimizer::Optimize(std::vector<Vert>& Vertices, std::vector<unsigned>& Indices, std::vector<Vec2F>& Uv) {
+	if (Indices.size() < 3) return;
+
+	const auto vertexCount = (unsigned)Vertices.size();
+
+	auto order = OptimizeVertexCache(Indices, vertexCount);
+	OptimizeOverdraw(Vertices, Indices, order);
+
+	// Move the indices and corner uvs of every triangle into its new slot.
+	std::vector<unsigned> indices(order.size() * 3);
+	std::vector<Vec2F> uv(Uv.size() == Indices.size() ? Uv.size() : 0);
+	for (unsigned i = 0; i < order.size(); ++i) {
+		for (unsigned c = 0; c < 3; ++c) {
+			indices[i * 3 + c] = Indices[order[i] * 3 + c];
+			if (!uv.empty()) uv[i * 3 + c] = Uv[order[i] * 3 + c];
+		}
+	}
+
+	const auto remap = OptimizeVertexFetch(indices, vertexCount);
+	std::vector<Vert> vertices;
+	vertices.reserve(remap.size());
+	for (const auto old : remap) {
+		vertices.emplace_back(Vertices[old]);
+	}
+
+	Vertices = std::move(vertices);
+	Indices = std::move(indices);
+	if (!uv.empty()) Uv = std::move(uv);
+}
+
+std::vector<unsigned> MeshOptimizer::OptimizeVertexCache(const std::vector<unsigned>& Indices,
+														 const unsigned VertexCount) {
+	const auto triangleCount = (unsigned)(Indices.size() / 3);
+
+	// Triangles using each vertex, packed into one list with an offset per vertex.
+	std::vector<unsigned> valence(VertexCount, 0);
+	for (unsigned i = 0; i < triangleCount * 3; ++i) {
+		valence[Indices[i]]++;
+	}
+
+	std::vector<unsigned> offsets(VertexCount + 1, 0);
+	for (unsigned v = 0; v < VertexCount; ++v) {
+		offsets[v + 1] = offsets[v] + valence[v];
+	}
+
+	std::vector<unsigned> adjacency(offsets.back());
+	std::vector<unsigned> fill(offsets.begin(), offsets.end() - 1);
+	for (unsigned t = 0; t < triangleCount; ++t) {
+		for (unsigned c = 0; c < 3; ++c) {
+			adjacency[fill[Indices[t * 3 + c]]++] = t;
+		}
+	}
+
+	std::vector<float> vertexScores(VertexCount);
+	for (unsigned v = 0; v < VertexCount; ++v) {
+		vertexScores[v] = VertexScore(-1, valence[v]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	for (unsigned t = 0; t < triangleCount; ++t) {
+		triangleScores[t] = vertexScores[Indices[t * 3]] + vertexScores[Indices[t * 3 + 1]] +
+			vertexScores[Indices[t * 3 + 2]];
+	}
+
+	std::vector<bool> isEmitted(triangleCount, false);
+	std::vector<unsigned> order;
+	order.reserve(triangleCount);
+
+	// LRU cache of vertex ids, with room for the three vertices pushed in front of it every step.
+	std::vector<unsigned> cache, nextCache;
+	cache.reserve(CacheSize + 3);
+	nextCache.reserve(CacheSize + 3);
+
+	unsigned inputCursor = 0;
+	auto best = triangleCount == 0 ? ~0u : 0u;
+
+	while (best != ~0u) {
+		isEmitted[best] = true;
+		order.emplace_back(best);
+
+		// Push the triangle's vertices to the front of the cache and take the triangle out of their lists.
+		nextCache.clear();
+		for (unsigned c = 0; c < 3; ++c) {
+			const auto v = Indices[best * 3 + c];
+			nextCache.emplace_back(v);
+
+			auto* first = adjacency.data() + offsets[v];
+			auto* last = first + valence[v];
+			*std::find(first, last, best) = *(last - 1);
+			valence[v]--;
+		}
+		for (const auto v : cache) {
+			if (v != nextCache[0] && v != nextCache[1] && v != nextCache[2]) nextCache.emplace_back(v);
+		}
+
+		// Vertices that fell out of the cache lose their cache score, and so do the triangles still using them.
+		for (size_t i = CacheSize; i < nextCache.size(); ++i) {
+			const auto v = nextCache[i];
+			const auto score = VertexScore(-1, valence[v]);
+			const auto delta = score - vertexScores[v];
+			vertexScores[v] = score;
+
+			for (auto a = offsets[v]; a < offsets[v] + valence[v]; ++a) {
+				triangleScores[adjacency[a]] += delta;
+			}
+		}
+		if (nextCache.size() > CacheSize) nextCache.resize(CacheSize);
+		std::swap(cache, nextCache);
+
+		// Rescore the cached vertices and the triangles around them, picking the best one to emit next.
+		best = ~0u;
+		auto bestScore = -1.0f;
+		for (unsigned i = 0; i < cache.size(); ++i) {
+			const auto v = cache[i];
+			const auto score = VertexScore((int)i, valence[v]);
+			const auto delta = score - vertexScores[v];
+			vertexScores[v] = score;
+
+			for (auto a = offsets[v]; a < offsets[v] + valence[v]; ++a) {
+				triangleScores[adjacency[a]] += delta;
+			}
+		}
+
+		for (const auto v : cache) {
+			for (auto a = offsets[v]; a < offsets[v] + valence[v]; ++a) {
+				const auto t = adjacency[a];
+				if (triangleScores[t] > bestScore) {
+					bestScore = triangleScores[t];
+					best = t;
+				}
+			}
+		}
+
+		// Nothing left around the cache, restart from the next triangle in input order.
+		if (best == ~0u) {
+			while (inputCursor < triangleCount && isEmitted[inputCursor]) inputCursor++;
+			if (inputCursor < triangleCount) best = inputCursor;
+		}
+	}
+
+	return order;
+}
+
+void MeshOptimizer::OptimizeOverdraw(const std::vector<Vert>& Vertices, const std::vector<unsigned>& Indices,
+									 std::vector<unsigned>& Order) {
+	if (Order.empty()) return;
+
+	// Start a new cluster wherever a triangle misses the cache on all three vertices, so moving clusters around
+	// keeps the vertex reuse inside each of them.
+	std::vector<unsigned> clusterStarts;
+	std::vector<unsigned> cacheTime(Vertices.size(), 0);
+	unsigned time = CacheSize + 1;
+	for (unsigned i = 0; i < Order.size(); ++i) {
+		unsigned misses = 0;
+		for (unsigned c = 0; c < 3; ++c) {
+			const auto v = Indices[Order[i] * 3 + c];
+			if (time - cacheTime[v] > CacheSize) {
+				cacheTime[v] = time++;
+				misses++;
+			}
+		}
+
+		if (misses == 3 || i == 0) clusterStarts.emplace_back(i);
+	}
+	clusterStarts.emplace_back((unsigned)Order.size());
+
+	Vec3F meshCenter{};
+	for (const auto& v : Vertices) {
+		meshCenter += v.Pos;
+	}
+	meshCenter /= (float)Vertices.size();
+
+	// Clusters far out along their facing direction are likely in front of the rest of the mesh.
+	const auto clusterCount = clusterStarts.size() - 1;
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c) {
+		Vec3F center{}, normal{};
+		auto area = 0.0f;
+
+		for (auto i = clusterStarts[c]; i < clusterStarts[c + 1]; ++i) {
+			const auto& a = Vertices[Indices[Order[i] * 3]].Pos;
+			const auto& b = Vertices[Indices[Order[i] * 3 + 1]].Pos;
+			const auto& d = Vertices[Indices[Order[i] * 3 + 2]].Pos;
+
+			const auto n = TriangleNormal(a, b, d);
+			const auto triangleArea = n.Length();
+
+			center += (a + b + d) * (triangleArea / 3.0f);
+			normal += n;
+			area += triangleArea;
+		}
+
+		if (area > 0.0f) center /= area;
+		const auto normalLength = normal.Length();
+		if (normalLength > 0.0f) normal /= normalLength;
+
+		sortKeys[c] = Vec3F::DotProduct(center - meshCenter, normal);
+	}
+
+	std::vector<unsigned> clusters(clusterCount);
+	std::iota(clusters.begin(), clusters.end(), 0);
+	std::stable_sort(clusters.begin(), clusters.end(), [&sortKeys](const unsigned A, const unsigned B) {
+		return sortKeys[A] > sortKeys[B];
+	});
+
+	std::vector<unsigned> order;
+	order.reserve(Order.size());
+	for (const auto c : clusters) {
+		order.insert(order.end(), Order.begin() + clusterStarts[c], Order.begin() + clusterStarts[c + 1]);
+	}
+
+	Order = std::move(order);
+}
+
+std::vector<unsigned> MeshOptimizer::OptimizeVertexFetch(std::vector<unsigned>& Indices, const unsigned VertexCount) {
+	std::vector<unsigned> newIndex(VertexCount, ~0u);
+	std::vector<unsigned> remap;
+	remap.reserve(VertexCount);
+
+	for (auto& index : Indices) {
+		if (newIndex[index] == ~0u) {
+			newIndex[index] = (unsigned)remap.size();
+			remap.emplace_back(index);
+		}
+
+		index = newIndex[index];
+	}
+
+	return remap;
+}
+
+std::vector<unsigned> MeshOptimizer::WeldPositions(const std::vector<Vert>& Vertices) {
+	std::vector<unsigned> order(Vertices.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&Vertices](const unsigned A, const unsigned B) {
+		const auto& a = Vertices[A].Pos;
+		const auto& b = Vertices[B].Pos;
+		if (a.X != b.X) return a.X < b.X;
+		if (a.Y != b.Y) return a.Y < b.Y;
+		if (a.Z != b.Z) return a.Z < b.Z;
+		return A < B;
+	});
+
+	std::vector<unsigned> welded(Vertices.size());
+	for (unsigned i = 0; i < order.size(); ++i) {
+		const auto& cur = Vertices[order[i]].Pos;
+		const auto& prev = Vertices[order[i == 0 ? 0 : i - 1]].Pos;
+		const auto isSame = i > 0 && cur.X == prev.X && cur.Y == prev.Y && cur.Z == prev.Z;
+		welded[order[i]] = isSame ? welded[order[i - 1]] : order[i];
+	}
+
+	return welded;
+}
+
+float MeshOptimizer::CalculateAcmr(const std::vector<unsigned>& Indices, const unsigned VertexCount,
+								   const unsigned FifoSize) {
+	if (Indices.size() < 3) return 0.0f;
+
+	std::vector<unsigned> cacheTime(VertexCount, 0);
+	unsigned time = FifoSize + 1;
+	unsigned misses = 0;
+
+	for (const auto index : Indices) {
+		if (time - cacheTime[index] > FifoSize) {
+			cacheTime[index] = time++;
+			misses++;
+		}
+	}
+
+	return (float)misses / (float)(Indices.size() / 3);
+}
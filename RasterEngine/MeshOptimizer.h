@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+
+struct Vert;
+struct Vec2F;
+
+/**
+ * \brief Reorders mesh data at load time so the rasterizer touches it in a cache friendly order. Triangles are
+ * ordered for vertex reuse, then clustered and sorted to reduce overdraw, then vertices are renumbered in the order
+ * the triangles first use them.
+ */
+class MeshOptimizer
+{
+public:
+	// Entries in the simulated post transform cache used for scoring and measuring.
+	static constexpr unsigned CacheSize = 32;
+
+	/**
+	 * \brief Runs every optimization pass over a mesh in place.
+	 * \param Uv Per corner texture coordinates, moved along with their triangles.
+	 */
+	static void Optimize(std::vector<Vert>& Vertices, std::vector<unsigned>& Indices, std::vector<Vec2F>& Uv);
+
+	/**
+	 * \brief Orders triangles with Forsyth's algorithm so vertices are reused while still in the cache.
+	 * \return Triangle ids in their new order.
+	 */
+	static std::vector<unsigned> OptimizeVertexCache(const std::vector<unsigned>& Indices, unsigned VertexCount);
+
+	/**
+	 * \brief Splits a cache optimized triangle order into clusters at cache misses, then sorts the clusters so
+	 * outward facing ones on the outside of the mesh draw first and hide what is behind them.
+	 * \param Order Triangle order from OptimizeVertexCache, reordered in place.
+	 */
+	static void OptimizeOverdraw(const std::vector<Vert>& Vertices, const std::vector<unsigned>& Indices,
+								 std::vector<unsigned>& Order);
+
+	/**
+	 * \brief Renumbers vertices in the order the indices first reference them, dropping unused vertices.
+	 * \return Old vertex index of every new vertex.
+	 */
+	static std::vector<unsigned> OptimizeVertexFetch(std::vector<unsigned>& Indices, unsigned VertexCount);
+
+	/**
+	 * \brief Welds vertices that only differ by normal, color or uv.
+	 * \return For every vertex, the lowest index of a vertex at exactly the same position.
+	 */
+	static std::vector<unsigned> WeldPositions(const std::vector<Vert>& Vertices);
+
+	/**
+	 * \brief Measures the average cache miss ratio of an index list, the number of vertices transformed per
+	 * triangle through a FIFO cache. 0.5 is the best possible and 3 the worst.
+	 */
+	static float CalculateAcmr(const std::vector<unsigned>& Indices, unsigned VertexCount, unsigned FifoSize = 16);
+};
@@ -0,0 +1,112 @@
+#include "MeshRegistry.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+namespace {
+	/**
+	 * \brief Folds raw bytes into a 64 bit FNV-1a hash.
+	 */
+	uint64_t HashBytes(uint64_t Hash, const void* Data, const size_t Size) {
+		const auto* bytes = static_cast<const unsigned char*>(Data);
+		for (size_t i = 0; i < Size; ++i) {
+			Hash ^= bytes[i];
+			Hash *= 1099511628211ull;
+		}
+
+		return Hash;
+	}
+
+	template<typename T>
+	bool IsSameData(const std::vector<T>& Lhs, const std::vector<T>& Rhs) {
+		if (Lhs.size() != Rhs.size()) return false;
+		return Lhs.empty() || std::memcmp(Lhs.data(), Rhs.data(), Lhs.size() * sizeof(T)) == 0;
+	}
+}
+
+MeshHandle MeshRegistry::Find(const std::string& Path) const {
+	std::lock_guard<std::mutex> lock(Mux);
+
+	const auto it = Paths.find(Path);
+	return it == Paths.end() ? nullptr : it->second;
+}
+
+MeshHandle MeshRegistry::Add(StaticMesh Mesh) {
+	const auto hash = Hash(Mesh);
+
+	std::lock_guard<std::mutex> lock(Mux);
+
+	// Equal hashes are only a hint, the data is compared before sharing.
+	const auto range = Contents.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		const auto& existing = it->second;
+		if (IsSameData(existing->Vertices, Mesh.Vertices) && IsSameData(existing->Indices, Mesh.Indices)
+			&& IsSameData(existing->Uv, Mesh.Uv)) {
+			return existing;
+		}
+	}
+
+	auto mesh = std::make_shared<const StaticMesh>(std::move(Mesh));
+	Contents.emplace(hash, mesh);
+	return mesh;
+}
+
+bool MeshRegistry::Unload(const std::string& Path) {
+	std::lock_guard<std::mutex> lock(Mux);
+
+	return Paths.erase(Path) > 0;
+}
+
+unsigned MeshRegistry::PurgeUnused() {
+	std::lock_guard<std::mutex> lock(Mux);
+
+	// Handles are only copied out of the registry while it is locked, so a mesh held by nothing but its entry stays
+	// unused until the lock is released.
+	unsigned freed = 0;
+	for (auto it = Paths.begin(); it != Paths.end();) {
+		const auto isUnused = it->second.use_count() == 1;
+		freed += isUnused;
+		it = isUnused ? Paths.erase(it) : std::next(it);
+	}
+
+	for (auto it = Contents.begin(); it != Contents.end();) {
+		const auto isUnused = it->second.use_count() == 1;
+		freed += isUnused;
+		it = isUnused ? Contents.erase(it) : std::next(it);
+	}
+
+	return freed;
+}
+
+unsigned MeshRegistry::GetCount() const {
+	std::lock_guard<std::mutex> lock(Mux);
+
+	// The same mesh may be registered by path and by contents, count it once.
+	std::vector<const StaticMesh*> meshes;
+	for (const auto& entry : Paths) {
+		meshes.emplace_back(entry.second.get());
+	}
+	for (const auto& entry : Contents) {
+		meshes.emplace_back(entry.second.get());
+	}
+
+	std::sort(meshes.begin(), meshes.end());
+	return (unsigned)(std::unique(meshes.begin(), meshes.end()) - meshes.begin());
+}
+
+void MeshRegistry::Clear() {
+	std::lock_guard<std::mutex> lock(Mux);
+
+	Paths.clear();
+	Contents.clear();
+}
+
+uint64_t MeshRegistry::Hash(const StaticMesh& Mesh) {
+	auto hash = 14695981039346656037ull;
+	hash = HashBytes(hash, Mesh.Vertices.data(), Mesh.Vertices.size() * sizeof(Vert));
+	hash = HashBytes(hash, Mesh.Indices.data(), Mesh.Indices.size() * sizeof(unsigned));
+	hash = HashBytes(hash, Mesh.Uv.data(), Mesh.Uv.size() * sizeof(Vec2F));
+	return hash;
+}
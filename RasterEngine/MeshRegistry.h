@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "StaticMesh.h"
+
+// Shared, immutable reference to a loaded mesh. The mesh is freed once the registry and every handle let go of it.
+using MeshHandle = std::shared_ptr<const StaticMesh>;
+
+/**
+ * \brief Loads every mesh once and hands out shared handles to it, so memory grows with the number of unique meshes
+ * rather than with the number of components drawing them. Meshes are found by asset path, or by a hash of their
+ * contents for meshes built at runtime. The registry keeps its own reference, so a mesh stays loaded while nothing
+ * draws it and spawning it again never repeats the import. Meshes are only freed by Unload, PurgeUnused or Clear.
+ * Safe to use from any thread.
+ */
+class MeshRegistry
+{
+public:
+	/**
+	 * \brief Gets the mesh loaded from an asset, calling Loader to build it if it is not loaded.
+	 * \param Path Key of the asset, usually its file path.
+	 * \param Loader Called without arguments, returns the StaticMesh to register. Runs without the registry locked.
+	 */
+	template<typename MeshLoader>
+	MeshHandle Load(const std::string& Path, const MeshLoader& Loader) {
+		auto mesh = Find(Path);
+		if (mesh) return mesh;
+
+		auto loaded = std::make_shared<const StaticMesh>(Loader());
+
+		// Another thread may have loaded the same asset meanwhile, everyone has to end up sharing one of them.
+		std::lock_guard<std::mutex> lock(Mux);
+		auto& entry = Paths[Path];
+		if (!entry) entry = std::move(loaded);
+
+		return entry;
+	}
+
+	/**
+	 * \return Mesh loaded from an asset, nullptr if it is not loaded.
+	 */
+	MeshHandle Find(const std::string& Path) const;
+
+	/**
+	 * \brief Registers a mesh built at runtime, returning the registered one instead if it has the same vertices,
+	 * indices and uvs.
+	 */
+	MeshHandle Add(StaticMesh Mesh);
+
+	/**
+	 * \brief Drops the registry's reference to the mesh loaded from an asset. Handles already given out stay valid
+	 * and the next Load imports it again.
+	 * \return Whether the asset was loaded.
+	 */
+	bool Unload(const std::string& Path);
+
+	/**
+	 * \brief Frees every mesh no handle outside the registry refers to any more, for example between levels.
+	 * \return Number of meshes freed.
+	 */
+	unsigned PurgeUnused();
+
+	/**
+	 * \return Number of unique meshes loaded.
+	 */
+	unsigned GetCount() const;
+
+	/**
+	 * \brief Forgets every mesh, handles already given out stay valid.
+	 */
+	void Clear();
+
+	/**
+	 * \brief Hashes the vertices, indices and uvs of a mesh, the data that makes two meshes the same.
+	 */
+	static uint64_t Hash(const StaticMesh& Mesh);
+
+private:
+	std::unordered_map<std::string, MeshHandle> Paths;
+	std::unordered_multimap<uint64_t, MeshHandle> Contents;
+
+	mutable std::mutex Mux;
+};
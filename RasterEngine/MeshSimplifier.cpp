@@ -0,0 +1,277 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+#include "EngineDefines.h"
+#include "MeshOptimizer.h"
+
+namespace {
+	/**
+	 * \brief Symmetric 4x4 matrix summing squared distances to a set of planes.
+	 */
+	struct Quadric {
+		double A2 = 0, AB = 0, AC = 0, AD = 0, B2 = 0, BC = 0, BD = 0, C2 = 0, CD = 0, D2 = 0;
+
+		// Total weight of the planes, dividing by it turns the error into an average squared distance.
+		double Weight = 0;
+
+		static Quadric FromPlane(const double A, const double B, const double C, const double D, const double Weight) {
+			Quadric q;
+			q.A2 = A * A * Weight; q.AB = A * B * Weight; q.AC = A * C * Weight; q.AD = A * D * Weight;
+			q.B2 = B * B * Weight; q.BC = B * C * Weight; q.BD = B * D * Weight;
+			q.C2 = C * C * Weight; q.CD = C * D * Weight;
+			q.D2 = D * D * Weight;
+			q.Weight = Weight;
+			return q;
+		}
+
+		Quadric& operator+=(const Quadric& Q) {
+			A2 += Q.A2; AB += Q.AB; AC += Q.AC; AD += Q.AD;
+			B2 += Q.B2; BC += Q.BC; BD += Q.BD;
+			C2 += Q.C2; CD += Q.CD;
+			D2 += Q.D2;
+			Weight += Q.Weight;
+			return *this;
+		}
+
+		double Error(const Vec3F& P) const {
+			const double x = P.X, y = P.Y, z = P.Z;
+			return x * x * A2 + y * y * B2 + z * z * C2 + 2 * (x * y * AB + x * z * AC + y * z * BC) +
+				2 * (x * AD + y * BD + z * CD) + D2;
+		}
+	};
+
+	struct Collapse {
+		double Cost;
+		double Distance;
+		unsigned From, To;
+		unsigned FromVersion, ToVersion;
+
+		bool operator>(const Collapse& Other) const { return Cost > Other.Cost; }
+	};
+
+	Vec3F Normal(const Vec3F& A, const Vec3F& B, const Vec3F& C) {
+		return Vec3F::CrossProduct(B - A, C - A);
+	}
+}
+
+float MeshSimplifier::Simplify(std::vector<Vert>& Vertices, std::vector<unsigned>& Indices, std::vector<Vec2F>& Uv,
+							   const unsigned TargetTriangles) {
+	const auto triangleCount = (unsigned)(Indices.size() / 3);
+	if (triangleCount <= TargetTriangles) return 0.0f;
+
+	// Work on welded positions, triangle t's corners are corners[3t] to corners[3t + 2].
+	const auto welded = MeshOptimizer::WeldPositions(Vertices);
+	std::vector<unsigned> corners(Indices.size());
+	for (size_t i = 0; i < Indices.size(); ++i) {
+		corners[i] = welded[Indices[i]];
+	}
+
+	std::vector<Vec3F> positions(Vertices.size());
+	for (unsigned v = 0; v < Vertices.size(); ++v) {
+		positions[v] = Vertices[v].Pos;
+	}
+
+	std::vector<std::vector<unsigned>> vertexTriangles(Vertices.size());
+	for (unsigned t = 0; t < triangleCount; ++t) {
+		for (unsigned c = 0; c < 3; ++c) {
+			vertexTriangles[corners[t * 3 + c]].emplace_back(t);
+		}
+	}
+
+	// Every vertex starts with the planes of the triangles around it, weighted by their area.
+	std::vector<Quadric> quadrics(Vertices.size());
+	for (unsigned t = 0; t < triangleCount; ++t) {
+		const auto& a = positions[corners[t * 3]];
+		auto n = Normal(a, positions[corners[t * 3 + 1]], positions[corners[t * 3 + 2]]);
+		const auto area = n.Length();
+		if (area <= 0.0f) continue;
+
+		n /= area;
+		const auto plane = Quadric::FromPlane(n.X, n.Y, n.Z, -Vec3F::DotProduct(n, a), area * 0.5);
+		for (unsigned c = 0; c < 3; ++c) {
+			quadrics[corners[t * 3 + c]] += plane;
+		}
+	}
+
+	// Open edges get a heavy plane standing on them so the outline of the mesh holds its shape.
+	for (unsigned t = 0; t < triangleCount; ++t) {
+		const auto faceNormal = Normal(positions[corners[t * 3]], positions[corners[t * 3 + 1]],
+									   positions[corners[t * 3 + 2]]);
+
+		for (unsigned c = 0; c < 3; ++c) {
+			const auto a = corners[t * 3 + c];
+			const auto b = corners[t * 3 + (c + 1) % 3];
+
+			auto shared = 0;
+			for (const auto other : vertexTriangles[a]) {
+				for (unsigned k = 0; k < 3; ++k) {
+					if (corners[other * 3 + k] == b) shared++;
+				}
+			}
+			if (shared > 1) continue;
+
+			const auto& pa = positions[a];
+			const auto edge = positions[b] - pa;
+			auto n = Vec3F::CrossProduct(edge, faceNormal);
+			if (n.Length() <= 0.0f) continue;
+
+			Vec3F::Normalize(n);
+			const auto lengthSquared = Vec3F::DotProduct(edge, edge);
+			const auto plane = Quadric::FromPlane(n.X, n.Y, n.Z, -Vec3F::DotProduct(n, pa), lengthSquared * 10.0);
+			quadrics[a] += plane;
+			quadrics[b] += plane;
+		}
+	}
+
+	std::vector<unsigned> versions(Vertices.size(), 0);
+	std::vector<bool> isTriangleAlive(triangleCount, true);
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+
+	// Collapsing an edge moves one end onto the other, whichever way round is cheaper.
+	const auto pushEdge = [&](const unsigned A, const unsigned B) {
+		auto q = quadrics[A];
+		q += quadrics[B];
+		const auto toB = q.Error(positions[B]);
+		const auto toA = q.Error(positions[A]);
+
+		const auto weight = q.Weight > 0.0 ? q.Weight : 1.0;
+		if (toB <= toA) heap.push({toB, toB / weight, A, B, versions[A], versions[B]});
+		else heap.push({toA, toA / weight, B, A, versions[B], versions[A]});
+	};
+
+	for (unsigned t = 0; t < triangleCount; ++t) {
+		for (unsigned c = 0; c < 3; ++c) {
+			const auto a = corners[t * 3 + c];
+			const auto b = corners[t * 3 + (c + 1) % 3];
+			if (a < b) pushEdge(a, b);
+		}
+	}
+
+	auto aliveTriangles = triangleCount;
+	auto maxError = 0.0;
+
+	while (aliveTriangles > TargetTriangles && !heap.empty()) {
+		const auto collapse = heap.top();
+		heap.pop();
+
+		const auto from = collapse.From;
+		const auto to = collapse.To;
+		if (versions[from] != collapse.FromVersion || versions[to] != collapse.ToVersion) continue;
+
+		// Refuse collapses that would turn a triangle around.
+		auto isFlipping = false;
+		for (const auto t : vertexTriangles[from]) {
+			if (!isTriangleAlive[t]) continue;
+
+			Vec3F before[3], after[3];
+			auto hasTo = false;
+			for (unsigned c = 0; c < 3; ++c) {
+				const auto v = corners[t * 3 + c];
+				hasTo |= v == to;
+				before[c] = positions[v];
+				after[c] = positions[v == from ? to : v];
+			}
+			if (hasTo) continue;
+
+			const auto oldNormal = Normal(before[0], before[1], before[2]);
+			const auto newNormal = Normal(after[0], after[1], after[2]);
+			if (Vec3F::DotProduct(oldNormal, newNormal) <= 0.0f) {
+				isFlipping = true;
+				break;
+			}
+		}
+		if (isFlipping) continue;
+
+		for (const auto t : vertexTriangles[from]) {
+			if (!isTriangleAlive[t]) continue;
+
+			auto hasTo = false;
+			for (unsigned c = 0; c < 3; ++c) {
+				hasTo |= corners[t * 3 + c] == to;
+			}
+
+			// Triangles on the edge disappear, the rest now use the kept vertex.
+			if (hasTo) {
+				isTriangleAlive[t] = false;
+				aliveTriangles--;
+				continue;
+			}
+
+			for (unsigned c = 0; c < 3; ++c) {
+				if (corners[t * 3 + c] == from) corners[t * 3 + c] = to;
+			}
+			vertexTriangles[to].emplace_back(t);
+		}
+
+		quadrics[to] += quadrics[from];
+		versions[from]++;
+		versions[to]++;
+		maxError = std::max(maxError, collapse.Distance);
+
+		// Drop dead triangles from the kept vertex and queue its edges at their new cost.
+		auto& around = vertexTriangles[to];
+		around.erase(std::remove_if(around.begin(), around.end(), [&](const unsigned T) {
+			return !isTriangleAlive[T];
+		}), around.end());
+		std::sort(around.begin(), around.end());
+		around.erase(std::unique(around.begin(), around.end()), around.end());
+
+		for (const auto t : around) {
+			for (unsigned c = 0; c < 3; ++c) {
+				const auto v = corners[t * 3 + c];
+				if (v != to) pushEdge(to, v);
+			}
+		}
+	}
+
+	// Every welded position lists the original vertices at it, so moved corners can pick the best facing one.
+	std::vector<std::vector<unsigned>> weldedVertices(Vertices.size());
+	for (unsigned v = 0; v < Vertices.size(); ++v) {
+		weldedVertices[welded[v]].emplace_back(v);
+	}
+
+	std::vector<unsigned> indices;
+	std::vector<Vec2F> uv;
+	indices.reserve(aliveTriangles * 3);
+	uv.reserve(Uv.empty() ? 0 : aliveTriangles * 3);
+
+	for (unsigned t = 0; t < triangleCount; ++t) {
+		if (!isTriangleAlive[t]) continue;
+
+		for (unsigned c = 0; c < 3; ++c) {
+			const auto original = Indices[t * 3 + c];
+			auto vertex = original;
+
+			if (welded[original] != corners[t * 3 + c]) {
+				auto bestFacing = -2.0f;
+				for (const auto candidate : weldedVertices[corners[t * 3 + c]]) {
+					const auto facing = Vec3F::DotProduct(Vertices[candidate].Norm, Vertices[original].Norm);
+					if (facing > bestFacing) {
+						bestFacing = facing;
+						vertex = candidate;
+					}
+				}
+			}
+
+			indices.emplace_back(vertex);
+			if (!Uv.empty()) uv.emplace_back(Uv[t * 3 + c]);
+		}
+	}
+
+	Indices = std::move(indices);
+	Uv = std::move(uv);
+
+	// Drop the vertices no triangle uses anymore.
+	const auto remap = MeshOptimizer::OptimizeVertexFetch(Indices, (unsigned)Vertices.size());
+	std::vector<Vert> vertices;
+	vertices.reserve(remap.size());
+	for (const auto old : remap) {
+		vertices.emplace_back(Vertices[old]);
+	}
+	Vertices = std::move(vertices);
+
+	return (float)std::sqrt(std::max(maxError, 0.0));
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <vector>
+
+struct Vert;
+struct Vec2F;
+
+/**
+ * \brief Reduces meshes with quadric error metric edge collapses. Vertices are welded by position first so uv seams
+ * do not tear, and every corner keeps its own uv and the normal of the vertex it is moved onto that faces most like
+ * its original one.
+ */
+class MeshSimplifier
+{
+public:
+	/**
+	 * \brief Collapses edges, cheapest first, until the mesh has no more than the target number of triangles or no
+	 * collapse is left that would not flip a triangle.
+	 * \param Uv Per corner texture coordinates, reduced along with the triangles.
+	 * \param TargetTriangles Number of triangles to stop at.
+	 * \return Root mean square distance in model space of the worst collapse from the planes of the source triangles it
+	 * merged, the error to compare against a screen space tolerance.
+	 */
+	static float Simplify(std::vector<Vert>& Vertices, std::vector<unsigned>& Indices, std::vector<Vec2F>& Uv,
+						  unsigned TargetTriangles);
+};
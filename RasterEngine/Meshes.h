@@ -1,6 +1,7 @@
 #pragma once
 #include "EngineDefines.h"
-#include "StaticMesh.h"
+#include "GEngine.h"
+#include "MeshRegistry.h"
 
 /*
  *    G +------+ H
@@ -12,95 +13,101 @@
  *	 |/     |/
  * A +------+ B
  */
-const StaticMesh CUBE_MESH = StaticMesh({
-			Vert({-0.25, -0.25, -0.25}, Color()),
-			Vert({ 0.25, -0.25, -0.25}, Color()),
-			Vert({ 0.25,  0.25, -0.25}, Color()),
-			Vert({-0.25,  0.25, -0.25}, Color()),
-
-			Vert({ 0.25, -0.25,  0.25}, Color()),
-			Vert({-0.25, -0.25,  0.25}, Color()),
-			Vert({-0.25,  0.25,  0.25}, Color()),
-			Vert({ 0.25,  0.25,  0.25}, Color())
-	}, {
-		// Front
-		0, 2, 1, // A -> C -> B
-		0, 3, 2, // A -> D -> C
-
-		// Back
-		4, 6, 5, // E -> G -> F
-		4, 7, 6, // E -> H -> G
-
-		// Right
-		1, 7, 4, // B -> H -> E
-		1, 2, 7, // B -> C -> H
-
-		// Left
-		5, 3, 0, // F -> D -> A
-		5, 6, 3, // F -> G -> D
-
-		// Up
-		3, 7, 2, // D -> H -> C
-		3, 6, 7, // D -> G -> H
-
-		// Down
-		5, 1, 4, // F -> B -> E
-		5, 0, 1  // F -> A -> B
+
+/**
+ * \brief Gets the cube mesh shared by everything drawing it, built the first time it is asked for.
+ */
+inline MeshHandle LoadCubeMesh() {
+	return GEngine::Get()->Meshes.Load("Cube", [] {
+		return StaticMesh({
+				Vert({-0.25, -0.25, -0.25}, Color()),
+				Vert({ 0.25, -0.25, -0.25}, Color()),
+				Vert({ 0.25,  0.25, -0.25}, Color()),
+				Vert({-0.25,  0.25, -0.25}, Color()),
+
+				Vert({ 0.25, -0.25,  0.25}, Color()),
+				Vert({-0.25, -0.25,  0.25}, Color()),
+				Vert({-0.25,  0.25,  0.25}, Color()),
+				Vert({ 0.25,  0.25,  0.25}, Color())
+		}, {
+			// Front
+			0, 2, 1, // A -> C -> B
+			0, 3, 2, // A -> D -> C
+
+			// Back
+			4, 6, 5, // E -> G -> F
+			4, 7, 6, // E -> H -> G
+
+			// Right
+			1, 7, 4, // B -> H -> E
+			1, 2, 7, // B -> C -> H
+
+			// Left
+			5, 3, 0, // F -> D -> A
+			5, 6, 3, // F -> G -> D
+
+			// Up
+			3, 7, 2, // D -> H -> C
+			3, 6, 7, // D -> G -> H
+
+			// Down
+			5, 1, 4, // F -> B -> E
+			5, 0, 1  // F -> A -> B
 		
-	}, {
-		// Front
-		{0, 0},
-		{1, 1},
-		{1, 0},
-
-		{0, 0},
-		{0, 1},
-		{1, 1},
-
-		// Back
-		{0, 0},
-		{1, 1},
-		{1, 0},
-
-		{0, 0},
-		{0, 1},
-		{1, 1},
-
-		// Right
-		{0, 0},
-		{1, 1},
-		{1, 0},
-
-		{0, 0},
-		{0, 1},
-		{1, 1},
-
-		// Left
-		{0, 0},
-		{1, 1},
-		{1, 0},
-
-		{0, 0},
-		{0, 1},
-		{1, 1},
-
-		// Up
-		{0, 0},
-		{1, 1},
-		{1, 0},
-
-		{0, 0},
-		{0, 1},
-		{1, 1},
-
-		// Down
-		{0, 0},
-		{1, 1},
-		{1, 0},
-
-		{0, 0},
-		{0, 1},
-		{1, 1}
+		}, {
+			// Front
+			{0, 0},
+			{1, 1},
+			{1, 0},
+
+			{0, 0},
+			{0, 1},
+			{1, 1},
+
+			// Back
+			{0, 0},
+			{1, 1},
+			{1, 0},
+
+			{0, 0},
+			{0, 1},
+			{1, 1},
+
+			// Right
+			{0, 0},
+			{1, 1},
+			{1, 0},
+
+			{0, 0},
+			{0, 1},
+			{1, 1},
+
+			// Left
+			{0, 0},
+			{1, 1},
+			{1, 0},
+
+			{0, 0},
+			{0, 1},
+			{1, 1},
+
+			// Up
+			{0, 0},
+			{1, 1},
+			{1, 0},
+
+			{0, 0},
+			{0, 1},
+			{1, 1},
+
+			// Down
+			{0, 0},
+			{1, 1},
+			{1, 0},
+
+			{0, 0},
+			{0, 1},
+			{1, 1}
+		});
 	});
-
-const StaticMesh STONEHENGE_MESH = StaticMesh({}, {}, {});
+}
@@ -0,0 +1,235 @@
+#include "Meshlet.h"
+
+#include <cmath>
+
+#include "MeshOptimizer.h"
+
+namespace {
+	/**
+	 * \brief Fills in the bounding sphere and normal cone of a meshlet from its triangles and vertices.
+	 */
+	void CalculateBounds(Meshlet& M, const std::vector<Vert>& Vertices, const std::vector<unsigned>& Indices,
+						 const std::vector<unsigned>& TriangleIds, const std::vector<unsigned>& VertexIds) {
+		// Sphere around the center of the bounding box.
+		Vec3F minPos = Vertices[VertexIds[M.VertexOffset]].Pos;
+		Vec3F maxPos = minPos;
+		for (auto i = M.VertexOffset; i < M.VertexOffset + M.VertexCount; ++i) {
+			const auto& p = Vertices[VertexIds[i]].Pos;
+			minPos = {Min(minPos.X, p.X), Min(minPos.Y, p.Y), Min(minPos.Z, p.Z)};
+			maxPos = {Max(maxPos.X, p.X), Max(maxPos.Y, p.Y), Max(maxPos.Z, p.Z)};
+		}
+
+		M.Center = (minPos + maxPos) * 0.5f;
+		M.Radius = 0.0f;
+		for (auto i = M.VertexOffset; i < M.VertexOffset + M.VertexCount; ++i) {
+			M.Radius = Max(M.Radius, (Vertices[VertexIds[i]].Pos - M.Center).Length());
+		}
+
+		// Triangles facing the camera wind the same way as their cross product, see RasterizeTriangle.
+		std::vector<Vec3F> normals;
+		normals.reserve(M.TriangleCount);
+		Vec3F axis{};
+		for (auto i = M.TriangleOffset; i < M.TriangleOffset + M.TriangleCount; ++i) {
+			const auto t = TriangleIds[i];
+			const auto& a = Vertices[Indices[t * 3]].Pos;
+			const auto& b = Vertices[Indices[t * 3 + 1]].Pos;
+			const auto& c = Vertices[Indices[t * 3 + 2]].Pos;
+
+			auto n = Vec3F::CrossProduct(b - a, c - a);
+			if (n.Length() <= 0.0f) continue;
+
+			Vec3F::Normalize(n);
+			normals.emplace_back(n);
+			axis += n;
+		}
+
+		M.ConeAxis = axis;
+		M.ConeCutoff = 1.0f;
+		if (normals.empty() || axis.Length() <= 0.0f) return;
+
+		Vec3F::Normalize(M.ConeAxis);
+
+		auto minDot = 1.0f;
+		for (const auto& n : normals) {
+			minDot = Min(minDot, Vec3F::DotProduct(n, M.ConeAxis));
+		}
+
+		// Triangles spread past a right angle from the axis can face any direction.
+		if (minDot > 0.1f) M.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+MeshletList MeshletList::Build(const std::vector<Vert>& Vertices, const std::vector<unsigned>& Indices) {
+	MeshletList list;
+
+	const auto triangleCount = (unsigned)(Indices.size() / 3);
+	if (triangleCount == 0) return list;
+
+	// Triangles only touching through vertices split at uv seams are still neighbours, so weld by position.
+	const auto welded = MeshOptimizer::WeldPositions(Vertices);
+
+	// Triangles around each welded vertex, packed into one list with an offset per vertex.
+	std::vector<unsigned> offsets(Vertices.size() + 1, 0);
+	for (const auto index : Indices) {
+		offsets[welded[index] + 1]++;
+	}
+	for (unsigned v = 0; v < Vertices.size(); ++v) {
+		offsets[v + 1] += offsets[v];
+	}
+
+	std::vector<unsigned> adjacency(offsets.back());
+	std::vector<unsigned> fill(offsets.begin(), offsets.end() - 1);
+	for (unsigned t = 0; t < triangleCount; ++t) {
+		for (unsigned c = 0; c < 3; ++c) {
+			adjacency[fill[welded[Indices[t * 3 + c]]]++] = t;
+		}
+	}
+
+	std::vector<Vec3F> centers(triangleCount), normals(triangleCount);
+	for (unsigned t = 0; t < triangleCount; ++t) {
+		const auto& a = Vertices[Indices[t * 3]].Pos;
+		const auto& b = Vertices[Indices[t * 3 + 1]].Pos;
+		const auto& c = Vertices[Indices[t * 3 + 2]].Pos;
+
+		centers[t] = (a + b + c) / 3.0f;
+		normals[t] = Vec3F::CrossProduct(b - a, c - a);
+		if (normals[t].Length() > 0.0f) Vec3F::Normalize(normals[t]);
+	}
+
+	std::vector<bool> isUsed(triangleCount, false);
+
+	// Slot of each vertex in the meshlet being built, reset by stamping with the meshlet number.
+	std::vector<unsigned> stamp(Vertices.size(), ~0u);
+	std::vector<unsigned> candidates;
+	unsigned seedCursor = 0;
+
+	while (true) {
+		while (seedCursor < triangleCount && isUsed[seedCursor]) seedCursor++;
+		if (seedCursor == triangleCount) break;
+
+		const auto meshletId = (unsigned)list.Meshlets.size();
+		Meshlet current{};
+		current.TriangleOffset = (unsigned)list.TriangleIds.size();
+		current.VertexOffset = (unsigned)list.VertexIds.size();
+
+		Vec3F centerSum{}, axisSum{};
+		candidates.clear();
+		auto next = seedCursor;
+
+		while (next != ~0u) {
+			isUsed[next] = true;
+			list.TriangleIds.emplace_back(next);
+			current.TriangleCount++;
+			centerSum += centers[next];
+			axisSum += normals[next];
+
+			for (unsigned c = 0; c < 3; ++c) {
+				const auto v = Indices[next * 3 + c];
+				if (stamp[v] != meshletId) {
+					stamp[v] = meshletId;
+					list.VertexIds.emplace_back(v);
+					current.VertexCount++;
+				}
+
+				const auto w = welded[v];
+				for (auto a = offsets[w]; a < offsets[w + 1]; ++a) {
+					if (!isUsed[adjacency[a]]) candidates.emplace_back(adjacency[a]);
+				}
+			}
+
+			if (current.TriangleCount == MaxTriangles) break;
+
+			// Grow towards the closest neighbour facing the same way that still fits.
+			const auto center = centerSum / (float)current.TriangleCount;
+			auto axis = axisSum;
+			if (axis.Length() > 0.0f) Vec3F::Normalize(axis);
+
+			auto radius = 0.0f;
+			for (auto i = current.TriangleOffset; i < current.TriangleOffset + current.TriangleCount; ++i) {
+				radius = Max(radius, (centers[list.TriangleIds[i]] - center).Length());
+			}
+			radius = Max(radius, 0.0001f);
+
+			next = ~0u;
+			auto bestCost = 0.0f;
+			for (size_t i = 0; i < candidates.size();) {
+				const auto t = candidates[i];
+				if (isUsed[t]) {
+					candidates[i] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+				++i;
+
+				unsigned newVertices = 0;
+				for (unsigned c = 0; c < 3; ++c) {
+					if (stamp[Indices[t * 3 + c]] != meshletId) newVertices++;
+				}
+				if (current.VertexCount + newVertices > MaxVertices) continue;
+
+				// Triangles bending too far away would leave a cone too wide to ever cull.
+				const auto facing = Vec3F::DotProduct(normals[t], axis);
+				if (facing < MinConeFacing) continue;
+
+				const auto spread = 1.0f - facing;
+				const auto cost = (centers[t] - center).Length() / radius + spread * 4.0f;
+				if (next == ~0u || cost < bestCost) {
+					bestCost = cost;
+					next = t;
+				}
+			}
+		}
+
+		CalculateBounds(current, Vertices, Indices, list.TriangleIds, list.VertexIds);
+		list.Meshlets.emplace_back(current);
+	}
+
+	return list;
+}
+
+void MeshletList::Cull(const Camera& C, Mat4& Transform, FrameVector<unsigned>& Visible) const {
+	Visible.clear();
+
+	auto toView = Transform * C.GetViewMatrix();
+	auto projection = C.GetPerspectiveProjection();
+	const auto xScale = projection[0];
+	const auto yScale = projection[5];
+
+	// Side planes pass through the eye, the distance from one to a view space point is its dot with the plane normal.
+	const auto xNormalScale = 1.0f / std::sqrt(xScale * xScale + 1.0f);
+	const auto yNormalScale = 1.0f / std::sqrt(yScale * yScale + 1.0f);
+
+	// Spheres grow with the largest scale of the transform.
+	const auto scaleX = Vec3F(Transform[0], Transform[1], Transform[2]).Length();
+	const auto scaleY = Vec3F(Transform[4], Transform[5], Transform[6]).Length();
+	const auto scaleZ = Vec3F(Transform[8], Transform[9], Transform[10]).Length();
+	const auto scale = Max(scaleX, Max(scaleY, scaleZ));
+
+	const auto cameraPos = C.WorldTransform.Project(Vec3F(0.0f, 0.0f, 0.0f));
+
+	for (unsigned i = 0; i < Meshlets.size(); ++i) {
+		const auto& m = Meshlets[i];
+		const auto radius = m.Radius * scale;
+		const auto center = toView.Project(m.Center);
+
+		if (center.Z + radius < C.NearPlane || center.Z - radius > C.FarPlane) continue;
+		if ((center.X * xScale - center.Z) * xNormalScale > radius) continue;
+		if ((-center.X * xScale - center.Z) * xNormalScale > radius) continue;
+		if ((center.Y * yScale - center.Z) * yNormalScale > radius) continue;
+		if ((-center.Y * yScale - center.Z) * yNormalScale > radius) continue;
+
+		if (m.ConeCutoff < 1.0f) {
+			// Every triangle faces away when the camera sits inside the cone behind the meshlet.
+			const auto worldCenter = Transform.Project(m.Center);
+			auto axis = m.ConeAxis;
+			axis.W = 0.0f;
+			auto worldAxis = Transform.Project(axis);
+			Vec3F::Normalize(worldAxis);
+
+			const auto toCenter = worldCenter - cameraPos;
+			if (Vec3F::DotProduct(toCenter, worldAxis) >= m.ConeCutoff * toCenter.Length() + radius) continue;
+		}
+
+		Visible.emplace_back(i);
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+
+#include "EngineDefines.h"
+#include "FrameArena.h"
+
+/**
+ * \brief A small cluster of neighbouring triangles with bounds used to skip it before any of its vertices are
+ * shaded.
+ */
+struct Meshlet {
+	// Range of triangle ids in MeshletList::TriangleIds, triangle i uses indices 3i to 3i + 2 of the mesh.
+	unsigned TriangleOffset, TriangleCount;
+
+	// Range of the unique vertices of the triangles in MeshletList::VertexIds.
+	unsigned VertexOffset, VertexCount;
+
+	// Bounding sphere in model space.
+	Vec3F Center;
+	float Radius;
+
+	// Average facing of the triangles and the sine of how far they spread from it, 1 if the cone cannot cull.
+	Vec3F ConeAxis;
+	float ConeCutoff;
+};
+
+/**
+ * \brief The meshlets of a mesh. Each is grown from a seed triangle through its neighbours, preferring triangles
+ * close to it that face the same way so its bounds stay tight enough to cull.
+ */
+struct MeshletList {
+	static constexpr unsigned MaxTriangles = 64;
+	// Meshes split at uv seams often use two vertices per triangle.
+	static constexpr unsigned MaxVertices = 128;
+
+	// Lowest cosine between a triangles normal and the meshlets average normal for it to join the meshlet.
+	static constexpr float MinConeFacing = 0.7f;
+
+	std::vector<Meshlet> Meshlets;
+	std::vector<unsigned> TriangleIds;
+	std::vector<unsigned> VertexIds;
+
+	static MeshletList Build(const std::vector<Vert>& Vertices, const std::vector<unsigned>& Indices);
+
+	/**
+	 * \brief Finds the meshlets that can be seen, dropping those outside of the view frustum or facing away from
+	 * the camera.
+	 * \param Visible Receives the index of every visible meshlet.
+	 */
+	void Cull(const Camera& C, Mat4& Transform, FrameVector<unsigned>& Visible) const;
+};
@@ -1,6 +1,7 @@
 #include "ModelParser.h"
 
 #include "EngineDefines.h"
+#include "MeshOptimizer.h"
 
 StaticMesh ModelParser::LoadMesh(const _OBJ_VERT_* MeshData, const unsigned VertexCount, const unsigned* IndicesData, unsigned IndexCount) {
 	// For every vertex entry add it to the mesh vertices and uv lists
@@ -21,6 +22,12 @@ StaticMesh ModelParser::LoadMesh(const _OBJ_VERT_* MeshData, const unsigned Vert
 		meshUvs.emplace_back(uv);
 	}
 
-	// Construct a static mesh from the mesh data.
-	return {meshVertices, indices, meshUvs};
+	// Reorder the triangles and vertices for the caches and overdraw before the mesh is built.
+	MeshOptimizer::Optimize(meshVertices, indices, meshUvs);
+
+	// Construct a static mesh from the mesh data along with its chain of simplified LODs.
+	StaticMesh mesh(meshVertices, indices, meshUvs);
+	mesh.BuildLods();
+
+	return mesh;
 }
@@ -0,0 +1,136 @@
+#pragma once
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief Refers to an object in an ObjectPool. The generation changes every time the slot is reused, so a handle
+ * kept after its object was destroyed never resolves to whatever took its place.
+ */
+struct PoolHandle {
+	unsigned Index = ~0u;
+	unsigned Generation = 0;
+
+	friend bool operator==(const PoolHandle& Lhs, const PoolHandle& Rhs) {
+		return Lhs.Index == Rhs.Index && Lhs.Generation == Rhs.Generation;
+	}
+
+	friend bool operator!=(const PoolHandle& Lhs, const PoolHandle& Rhs) { return !(Lhs == Rhs); }
+};
+
+/**
+ * \brief Stores objects of one type in fixed size chunks, reusing the slots of destroyed objects first so creating
+ * and destroying are constant time and the objects stay packed together. Chunks never move, pointers to an object
+ * stay valid until it is destroyed.
+ * \tparam T Type of the objects, only needs to be complete where the pool's members are used.
+ */
+template<typename T>
+class ObjectPool
+{
+public:
+	static constexpr unsigned ChunkSize = 256;
+
+	ObjectPool(): Count(0) {}
+
+	~ObjectPool() {
+		Clear();
+		for (auto* chunk : Chunks) ::operator delete(chunk);
+	}
+
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+
+	/**
+	 * \brief Gets the pool shared by everything creating objects of this type.
+	 */
+	static ObjectPool& GetShared() {
+		static ObjectPool pool;
+		return pool;
+	}
+
+	template<typename... Args>
+	PoolHandle Create(Args&&... Arguments) {
+		unsigned index;
+		if (FreeSlots.empty()) {
+			index = (unsigned)Generations.size();
+			if (index % ChunkSize == 0) Chunks.emplace_back(static_cast<T*>(::operator new(sizeof(T) * ChunkSize)));
+			Generations.emplace_back(0);
+		}
+		else {
+			index = FreeSlots.back();
+			FreeSlots.pop_back();
+		}
+
+		try {
+			new (GetSlot(index)) T(std::forward<Args>(Arguments)...);
+		}
+		catch (...) {
+			FreeSlots.emplace_back(index);
+			throw;
+		}
+
+		// Odd generations are alive, even ones are free.
+		Count++;
+		return {index, ++Generations[index]};
+	}
+
+	/**
+	 * \brief Destroys the object a handle refers to, stale handles are ignored.
+	 */
+	void Destroy(const PoolHandle& Handle) {
+		if (!IsValid(Handle)) return;
+
+		GetSlot(Handle.Index)->~T();
+		Generations[Handle.Index]++;
+		FreeSlots.emplace_back(Handle.Index);
+		Count--;
+	}
+
+	/**
+	 * \return Object the handle refers to, nullptr once it has been destroyed.
+	 */
+	T* Get(const PoolHandle& Handle) const {
+		return IsValid(Handle) ? GetSlot(Handle.Index) : nullptr;
+	}
+
+	bool IsValid(const PoolHandle& Handle) const {
+		return Handle.Index < Generations.size() && Generations[Handle.Index] == Handle.Generation
+			&& (Generations[Handle.Index] & 1);
+	}
+
+	/**
+	 * \brief Calls Visit with every live object in slot order. Objects created while visiting may be skipped.
+	 */
+	template<typename ObjectVisit>
+	void ForEach(const ObjectVisit& Visit) const {
+		for (unsigned i = 0; i < Generations.size(); ++i) {
+			if (Generations[i] & 1) Visit(*GetSlot(i));
+		}
+	}
+
+	/**
+	 * \brief Destroys every object, keeping the chunks for new ones.
+	 */
+	void Clear() {
+		for (unsigned i = 0; i < Generations.size(); ++i) {
+			if (Generations[i] & 1) Destroy({i, Generations[i]});
+		}
+	}
+
+	unsigned GetCount() const {
+		return Count;
+	}
+
+private:
+	std::vector<T*> Chunks;
+
+	// Generation of every slot, bumped when an object is created in it and again when it is destroyed.
+	std::vector<unsigned> Generations;
+	std::vector<unsigned> FreeSlots;
+
+	unsigned Count;
+
+	T* GetSlot(const unsigned Index) const {
+		return Chunks[Index / ChunkSize] + Index % ChunkSize;
+	}
+};
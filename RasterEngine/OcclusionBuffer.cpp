@@ -0,0 +1,181 @@
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <xmmintrin.h>
+
+#include "FrameArena.h"
+#include "StaticMesh.h"
+
+namespace {
+	constexpr unsigned BatchSize = 4;
+}
+
+OcclusionBuffer::OcclusionBuffer(): Depth(Width * Height, 0.0f), XScale(1.0f), YScale(1.0f), NearPlane(0.0f) {}
+
+void OcclusionBuffer::Clear(const Camera& C) {
+	std::fill(Depth.begin(), Depth.end(), 0.0f);
+
+	View = C.GetViewMatrix();
+
+	auto projection = C.GetPerspectiveProjection();
+	XScale = projection[0];
+	YScale = projection[5];
+	NearPlane = C.NearPlane;
+}
+
+Vec2F OcclusionBuffer::ToBuffer(const Vec3F& ViewPos) const {
+	const auto inverseDepth = 1.0f / ViewPos.Z;
+
+	Vec2F ret = {
+		(ViewPos.X * XScale * inverseDepth * 0.5f + 0.5f) * (float)Width,
+		(0.5f - ViewPos.Y * YScale * inverseDepth * 0.5f) * (float)Height
+	};
+	ret.Z = inverseDepth;
+
+	return ret;
+}
+
+void OcclusionBuffer::DrawOccluder(Mat4& Transform, const StaticMesh& Mesh) {
+	const auto toView = Transform * View;
+
+	FrameVector<Vec3F> viewPositions(Mesh.Vertices.size());
+	for (unsigned i = 0; i < Mesh.Vertices.size(); ++i) {
+		viewPositions[i] = toView.Project(Mesh.Vertices[i].Pos);
+	}
+
+	for (unsigned i = 0; i + 2 < Mesh.Indices.size(); i += 3) {
+		const Vec3F corners[3] = {
+			viewPositions[Mesh.Indices[i]], viewPositions[Mesh.Indices[i + 1]], viewPositions[Mesh.Indices[i + 2]]
+		};
+
+		// Clip against the near plane, a triangle loses one corner to it at most twice so it becomes up to four.
+		Vec2F clipped[4];
+		unsigned count = 0;
+		for (unsigned c = 0; c < 3; ++c) {
+			const auto& from = corners[c];
+			const auto& to = corners[(c + 1) % 3];
+			const auto isFromInside = from.Z >= NearPlane;
+			const auto isToInside = to.Z >= NearPlane;
+
+			if (isFromInside) clipped[count++] = ToBuffer(from);
+			if (isFromInside != isToInside) {
+				const auto t = (NearPlane - from.Z) / (to.Z - from.Z);
+				clipped[count++] = ToBuffer(from + (to - from) * t);
+			}
+		}
+
+		for (unsigned c = 1; c + 1 < count; ++c) {
+			DrawTriangle(clipped[0], clipped[c], clipped[c + 1]);
+		}
+	}
+}
+
+void OcclusionBuffer::DrawTriangle(const Vec2F& A, const Vec2F& B, const Vec2F& C) {
+	// Keep the same winding as the rasterizer, back faces and degenerate triangles cover nothing.
+	const auto area = ImplicitLineEquation(A, B, C);
+	if (area <= 0.0f) return;
+
+	const auto minX = Min(A.X, Min(B.X, C.X));
+	const auto maxX = Max(A.X, Max(B.X, C.X));
+	const auto minY = Min(A.Y, Min(B.Y, C.Y));
+	const auto maxY = Max(A.Y, Max(B.Y, C.Y));
+	if (maxX <= 0.0f || maxY <= 0.0f || minX >= (float)Width || minY >= (float)Height) return;
+
+	// Rows are walked a batch at a time from a batch aligned column, Width is a multiple of the batch size.
+	const auto startX = (unsigned)Max(std::floor(minX), 0.0f) / BatchSize * BatchSize;
+	const auto endX = (unsigned)Min(std::ceil(maxX), (float)Width);
+	const auto startY = (unsigned)Max(std::floor(minY), 0.0f);
+	const auto endY = (unsigned)Min(std::ceil(maxY), (float)Height);
+
+	// Each edge function is a plane over the screen that is positive inside the triangle and weighs the opposite
+	// corner, so the inverse depth is a plane made from the same coefficients.
+	const auto inverseArea = 1.0f / area;
+	const float edgeX[3] = {B.Y - C.Y, C.Y - A.Y, A.Y - B.Y};
+	const float edgeY[3] = {C.X - B.X, A.X - C.X, B.X - A.X};
+	const float edgeC[3] = {B.X * C.Y - B.Y * C.X, C.X * A.Y - C.Y * A.X, A.X * B.Y - A.Y * B.X};
+
+	const auto depthX = (edgeX[0] * A.Z + edgeX[1] * B.Z + edgeX[2] * C.Z) * inverseArea;
+	const auto depthY = (edgeY[0] * A.Z + edgeY[1] * B.Z + edgeY[2] * C.Z) * inverseArea;
+	const auto depthC = (edgeC[0] * A.Z + edgeC[1] * B.Z + edgeC[2] * C.Z) * inverseArea;
+
+	// Store the farthest depth anywhere in the pixel rather than at its center, so no part of it seems nearer.
+	const auto depthBias = (std::abs(depthX) + std::abs(depthY)) * 0.5f;
+
+	const auto zero = _mm_setzero_ps();
+	const auto laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const auto step = _mm_set1_ps((float)BatchSize);
+	const __m128 stepX[4] = {
+		_mm_set1_ps(edgeX[0]), _mm_set1_ps(edgeX[1]), _mm_set1_ps(edgeX[2]), _mm_set1_ps(depthX)
+	};
+
+	for (auto y = startY; y < endY; ++y) {
+		const auto pixelY = (float)y + 0.5f;
+		const __m128 rowStart[4] = {
+			_mm_set1_ps(edgeY[0] * pixelY + edgeC[0]), _mm_set1_ps(edgeY[1] * pixelY + edgeC[1]),
+			_mm_set1_ps(edgeY[2] * pixelY + edgeC[2]), _mm_set1_ps(depthY * pixelY + depthC - depthBias)
+		};
+
+		auto* row = Depth.data() + y * Width;
+		auto pixelX = _mm_add_ps(_mm_set1_ps((float)startX), laneOffsets);
+		for (auto x = startX; x < endX; x += BatchSize) {
+			const auto edge0 = _mm_add_ps(_mm_mul_ps(pixelX, stepX[0]), rowStart[0]);
+			const auto edge1 = _mm_add_ps(_mm_mul_ps(pixelX, stepX[1]), rowStart[1]);
+			const auto edge2 = _mm_add_ps(_mm_mul_ps(pixelX, stepX[2]), rowStart[2]);
+			const auto isInside = _mm_cmpge_ps(_mm_min_ps(edge0, _mm_min_ps(edge1, edge2)), zero);
+
+			if (_mm_movemask_ps(isInside)) {
+				// Lanes outside the triangle offer a depth of 0, which never beats what is already stored.
+				const auto depth = _mm_and_ps(_mm_add_ps(_mm_mul_ps(pixelX, stepX[3]), rowStart[3]), isInside);
+				_mm_store_ps(row + x, _mm_max_ps(_mm_load_ps(row + x), depth));
+			}
+
+			pixelX = _mm_add_ps(pixelX, step);
+		}
+	}
+}
+
+bool OcclusionBuffer::IsVisible(Mat4& Transform, const Vec3F& BoundsMin, const Vec3F& BoundsMax) const {
+	const auto toView = Transform * View;
+
+	auto minX = (float)Width, maxX = 0.0f;
+	auto minY = (float)Height, maxY = 0.0f;
+	auto nearest = 0.0f;
+
+	for (unsigned i = 0; i < 8; ++i) {
+		const Vec3F corner = {
+			(i & 1) ? BoundsMax.X : BoundsMin.X, (i & 2) ? BoundsMax.Y : BoundsMin.Y, (i & 4) ? BoundsMax.Z : BoundsMin.Z
+		};
+		const auto viewCorner = toView.Project(corner);
+
+		// Boxes reaching the camera cover the whole screen and are never hidden.
+		if (viewCorner.Z < NearPlane) return true;
+
+		const auto p = ToBuffer(viewCorner);
+		minX = Min(minX, p.X);
+		maxX = Max(maxX, p.X);
+		minY = Min(minY, p.Y);
+		maxY = Max(maxY, p.Y);
+		nearest = Max(nearest, p.Z);
+	}
+
+	if (maxX <= 0.0f || maxY <= 0.0f || minX >= (float)Width || minY >= (float)Height) return false;
+
+	// Occluders cover pixels whose centers they cover, which can leave up to half a pixel along their edges open.
+	// Testing one pixel beyond every pixel the box touches reaches past those edges, and rounding out to whole batches
+	// can only find it visible more often.
+	const auto startX = (unsigned)Max(std::floor(minX) - 1.0f, 0.0f) / BatchSize * BatchSize;
+	const auto endX = (unsigned)Min(std::ceil(maxX) + 1.0f, (float)Width);
+	const auto startY = (unsigned)Max(std::floor(minY) - 1.0f, 0.0f);
+	const auto endY = (unsigned)Min(std::ceil(maxY) + 1.0f, (float)Height);
+
+	const auto boxDepth = _mm_set1_ps(nearest);
+	for (auto y = startY; y < endY; ++y) {
+		const auto* row = Depth.data() + y * Width;
+		for (auto x = startX; x < endX; x += BatchSize) {
+			if (_mm_movemask_ps(_mm_cmplt_ps(_mm_load_ps(row + x), boxDepth))) return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <vector>
+
+#include "EngineDefines.h"
+#include "VertexStreams.h"
+
+class StaticMesh;
+
+/**
+ * \brief Coarse software depth buffer for occlusion culling. Designated occluders are rasterized into it every frame
+ * before anything is shaded, then other meshes test their bounding box against it and skip rendering when the box is
+ * hidden everywhere it covers. Stores inverse view depth so it interpolates linearly across the screen and an empty
+ * buffer clears to 0.
+ */
+class OcclusionBuffer
+{
+public:
+	static constexpr unsigned Width = 256;
+	static constexpr unsigned Height = 128;
+
+	OcclusionBuffer();
+
+	/**
+	 * \brief Empties the buffer and takes the view to rasterize and test from. Called once per frame before any
+	 * occluders are drawn.
+	 */
+	void Clear(const Camera& C);
+
+	/**
+	 * \brief Rasterizes the front faces of a mesh into the buffer. Depth is only sampled at pixel centers, so
+	 * occluders should be solid meshes much larger than a pixel of the buffer.
+	 */
+	void DrawOccluder(Mat4& Transform, const StaticMesh& Mesh);
+
+	/**
+	 * \brief Tests a model space bounding box against the occluders drawn so far.
+	 * \return False if every pixel the box covers holds an occluder in front of the boxes nearest point, or the box is
+	 * off screen.
+	 */
+	bool IsVisible(Mat4& Transform, const Vec3F& BoundsMin, const Vec3F& BoundsMax) const;
+
+private:
+	// Inverse view depth of the nearest occluder, 32 byte aligned so rows load four pixels at a time.
+	std::vector<float, AlignedAllocator<float, 32>> Depth;
+
+	// View the buffer was cleared with.
+	Mat4 View;
+	float XScale, YScale;
+	float NearPlane;
+
+	/**
+	 * \brief Projects a view space position in front of the near plane into the buffer.
+	 * \return Buffer position with the inverse view depth in Z.
+	 */
+	Vec2F ToBuffer(const Vec3F& ViewPos) const;
+
+	void DrawTriangle(const Vec2F& A, const Vec2F& B, const Vec2F& C);
+};
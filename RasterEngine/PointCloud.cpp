@@ -0,0 +1,117 @@
+#include "PointCloud.h"
+
+#include <xmmintrin.h>
+
+#include "EngineDefines.h"
+#include "GEngine.h"
+
+namespace {
+	constexpr size_t BatchSize = 4;
+}
+
+void PointCloud::Reserve(const size_t Count) {
+	const auto padded = (Count + BatchSize - 1) / BatchSize * BatchSize;
+	X.reserve(padded);
+	Y.reserve(padded);
+	Z.reserve(padded);
+	Colors.reserve(padded);
+}
+
+void PointCloud::Clear() {
+	X.clear();
+	Y.clear();
+	Z.clear();
+	Colors.clear();
+	Count = 0;
+}
+
+void PointCloud::AddPoint(const Vec3F& Position, const unsigned PointColor) {
+	// Start a new batch of padding points whenever the last one is full, then fill in the next slot.
+	if (Count % BatchSize == 0) {
+		X.resize(Count + BatchSize, 0.0f);
+		Y.resize(Count + BatchSize, 0.0f);
+		Z.resize(Count + BatchSize, 0.0f);
+		Colors.resize(Count + BatchSize, 0);
+	}
+
+	X[Count] = Position.X;
+	Y[Count] = Position.Y;
+	Z[Count] = Position.Z;
+	Colors[Count] = PointColor | 0xFF000000;
+	Count++;
+}
+
+size_t PointCloud::Size() const {
+	return Count;
+}
+
+void PointCloud::Render(const Camera& C, const Mat4& Transform) const {
+	const auto engine = GEngine::Get();
+	auto* pixels = engine->Pixels.data();
+	auto* depth = engine->Depth.data();
+	const auto width = (int)engine->Width;
+	const auto height = (int)engine->Height;
+
+	// Fold the whole projection into one matrix, keeping the rows that produce screen x, screen y and depth.
+	auto m = Transform * C.GetViewMatrix() * C.GetPerspectiveProjection();
+	const auto halfWidth = _mm_set1_ps((float)C.ScreenWidth * 0.5f);
+	const auto halfHeight = _mm_set1_ps((float)C.ScreenHeight * 0.5f);
+	const auto nearPlane = _mm_set1_ps(C.NearPlane);
+	const auto zero = _mm_setzero_ps();
+	const auto maxX = _mm_set1_ps((float)width);
+	const auto maxY = _mm_set1_ps((float)height);
+
+	const __m128 col[4][4] = {
+		{_mm_set1_ps(m[0]), _mm_set1_ps(m[4]), _mm_set1_ps(m[8]), _mm_set1_ps(m[12])},
+		{_mm_set1_ps(m[1]), _mm_set1_ps(m[5]), _mm_set1_ps(m[9]), _mm_set1_ps(m[13])},
+		{_mm_set1_ps(m[2]), _mm_set1_ps(m[6]), _mm_set1_ps(m[10]), _mm_set1_ps(m[14])},
+		{_mm_set1_ps(m[3]), _mm_set1_ps(m[7]), _mm_set1_ps(m[11]), _mm_set1_ps(m[15])}
+	};
+
+	for (size_t i = 0; i < Count; i += BatchSize) {
+		// Lanes past the last point are padding, never draw them.
+		const auto laneCount = Count - i < BatchSize ? Count - i : BatchSize;
+		const auto laneMask = (1 << laneCount) - 1;
+
+		const auto x = _mm_loadu_ps(&X[i]);
+		const auto y = _mm_loadu_ps(&Y[i]);
+		const auto z = _mm_loadu_ps(&Z[i]);
+
+		const auto clipX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, col[0][0]), _mm_mul_ps(y, col[0][1])),
+									  _mm_add_ps(_mm_mul_ps(z, col[0][2]), col[0][3]));
+		const auto clipY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, col[1][0]), _mm_mul_ps(y, col[1][1])),
+									  _mm_add_ps(_mm_mul_ps(z, col[1][2]), col[1][3]));
+		const auto clipW = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, col[3][0]), _mm_mul_ps(y, col[3][1])),
+									  _mm_add_ps(_mm_mul_ps(z, col[3][2]), col[3][3]));
+
+		// Points behind the near plane would project mirrored, drop them before dividing.
+		auto visible = _mm_cmpge_ps(clipW, nearPlane);
+		if ((_mm_movemask_ps(visible) & laneMask) == 0) continue;
+
+		const auto invW = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(clipW, nearPlane));
+		const auto screenX = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(clipX, invW), _mm_set1_ps(1.0f)), halfWidth);
+		const auto screenY = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(clipY, invW)), halfHeight);
+
+		// Cull against the side planes by keeping only points landing on the screen.
+		visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpge_ps(screenX, zero), _mm_cmplt_ps(screenX, maxX)));
+		visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmpge_ps(screenY, zero), _mm_cmplt_ps(screenY, maxY)));
+
+		auto mask = _mm_movemask_ps(visible) & laneMask;
+		if (mask == 0) continue;
+
+		alignas(16) float sx[BatchSize], sy[BatchSize], sw[BatchSize];
+		_mm_store_ps(sx, screenX);
+		_mm_store_ps(sy, screenY);
+		_mm_store_ps(sw, clipW);
+
+		for (unsigned lane = 0; mask != 0; ++lane, mask >>= 1) {
+			if ((mask & 1) == 0) continue;
+
+			const auto index = (int)sy[lane] * width + (int)sx[lane];
+			if (depth[index] <= sw[lane]) continue;
+
+			depth[index] = sw[lane];
+			pixels[index] = Colors[i + lane];
+		}
+	}
+}
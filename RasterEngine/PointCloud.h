@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+struct Camera;
+struct Mat4;
+struct Vec3F;
+
+/**
+ * \brief A large set of single pixel points such as the star field or particles. Positions are stored as separate
+ * x, y and z streams so they can be transformed and culled four at a time.
+ */
+class PointCloud
+{
+public:
+	void Reserve(size_t Count);
+	void Clear();
+
+	/**
+	 * \brief Adds a point to the cloud.
+	 * \param Position Position of the point in the space of the transform it is rendered with.
+	 * \param PointColor Color of the point in AARRGGBB, drawn opaque.
+	 */
+	void AddPoint(const Vec3F& Position, unsigned PointColor);
+
+	size_t Size() const;
+
+	/**
+	 * \brief Projects the points in batches, culls them against the near and side planes and writes the survivors
+	 * that pass the depth test straight into the framebuffer. Points past the far plane are kept so distant
+	 * backdrops still draw.
+	 */
+	void Render(const Camera& C, const Mat4& Transform) const;
+
+private:
+	// Streams are padded to a multiple of the batch size, the padding lanes are masked off when rendering.
+	std::vector<float> X, Y, Z;
+	std::vector<unsigned> Colors;
+
+	size_t Count = 0;
+};
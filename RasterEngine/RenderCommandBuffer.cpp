@@ -0,0 +1,107 @@
+#include "RenderCommandBuffer.h"
+
+#include <cstring>
+#include <typeinfo>
+
+#include "RenderHelper.h"
+#include "Shader.h"
+#include "StaticMesh.h"
+
+void RenderCommandBuffer::Submit(const RenderPass Pass, const float Depth, const RenderCommand& Command) {
+	// Depth only decides visibility in the pre-pass, so nothing but distance orders it.
+	const auto material = Pass == RenderPass::DepthPrepass ? 0 : GetMaterialId(Command.Material);
+
+	Entries.push_back({MakeKey(Pass, material, Depth), (unsigned)Commands.size()});
+	Commands.emplace_back(Command);
+}
+
+void RenderCommandBuffer::Sort() {
+	const auto count = (unsigned)Entries.size();
+	if (count < 2) return;
+
+	// Count every byte of every key in one read, least significant byte first.
+	unsigned histograms[8][256] = {};
+	for (const auto& entry : Entries) {
+		for (unsigned b = 0; b < 8; ++b) histograms[b][(entry.Key >> (b * 8)) & 0xFF]++;
+	}
+
+	SortScratch.resize(count);
+	for (unsigned b = 0; b < 8; ++b) {
+		auto& histogram = histograms[b];
+
+		// A byte that is the same in every key would not move anything, which skips the unused and constant bits.
+		if (histogram[(Entries[0].Key >> (b * 8)) & 0xFF] == count) continue;
+
+		unsigned offset = 0;
+		for (auto& bucket : histogram) {
+			const auto size = bucket;
+			bucket = offset;
+			offset += size;
+		}
+
+		for (const auto& entry : Entries) {
+			SortScratch[histogram[(entry.Key >> (b * 8)) & 0xFF]++] = entry;
+		}
+		Entries.swap(SortScratch);
+	}
+}
+
+void RenderCommandBuffer::Execute(const Camera& C) {
+	for (const auto& entry : Entries) {
+		auto& command = Commands[entry.Command];
+		const auto pass = (RenderPass)(entry.Key >> 60);
+
+		RenderHelper::IsDepthPrepass = pass == RenderPass::DepthPrepass;
+		RenderHelper::CurrentShader = command.Material;
+
+		const auto& mesh = *command.Mesh;
+		switch (command.Kind) {
+		case RenderCommand::Type::FillMesh:
+			RenderHelper::FillMesh(&C, command.Transform, mesh, command.StaticLight);
+			break;
+		case RenderCommand::Type::DrawWireMesh:
+			RenderHelper::DrawWireMesh(&C, command.Transform, mesh.Vertices, mesh.Edges);
+			break;
+		case RenderCommand::Type::FillMeshInstanced:
+			RenderHelper::FillMeshInstanced(&C, mesh, command.Instances, command.InstanceColors, command.InstanceCount);
+			break;
+		}
+	}
+
+	RenderHelper::IsDepthPrepass = false;
+	RenderHelper::CurrentShader = nullptr;
+}
+
+void RenderCommandBuffer::Clear() {
+	Commands.clear();
+	Entries.clear();
+	Materials.clear();
+}
+
+unsigned RenderCommandBuffer::GetCount() const {
+	return (unsigned)Commands.size();
+}
+
+uint64_t RenderCommandBuffer::MakeKey(const RenderPass Pass, const unsigned MaterialId, const float Depth) {
+	// The bits of a positive float sort the same as its value, draws behind the camera all count as depth 0.
+	const auto depth = Depth > 0.0f ? Depth : 0.0f;
+	uint32_t depthBits;
+	std::memcpy(&depthBits, &depth, sizeof(depthBits));
+
+	const auto material = MaterialId < 0xFFF ? MaterialId : 0xFFF;
+
+	return (uint64_t)Pass << 60 | (uint64_t)material << 48 | (uint64_t)depthBits << 16;
+}
+
+unsigned RenderCommandBuffer::GetMaterialId(const Shader* Material) {
+	if (!Material) return 0;
+
+	// Materials are copies of the shaders they were made from, and copies keep the lambda types of the stages.
+	const auto identity = Material->PixelShader.target_type().hash_code();
+	for (unsigned i = 0; i < Materials.size(); ++i) {
+		if (Materials[i] == identity) return i + 1;
+	}
+
+	Materials.emplace_back(identity);
+	return (unsigned)Materials.size();
+}
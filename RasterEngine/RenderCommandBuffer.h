@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "EngineDefines.h"
+
+class Shader;
+class StaticMesh;
+
+/**
+ * \brief Passes of a frame in the order they execute, the highest bits of every sort key.
+ */
+enum class RenderPass : unsigned char {
+	// Writes only depth, used by RenderPath::DepthPrepass.
+	DepthPrepass,
+	Opaque,
+	// Lines do not write depth, so they go after every surface.
+	Wire
+};
+
+/**
+ * \brief One draw recorded for later. Everything it points to must stay alive until the buffer is executed.
+ */
+struct RenderCommand {
+	enum class Type : unsigned char {
+		FillMesh,
+		DrawWireMesh,
+		// Draws the mesh once per instance with Instances and InstanceColors, Transform is unused.
+		FillMeshInstanced
+	};
+
+	Type Kind = Type::FillMesh;
+
+	// Bound as RenderHelper::CurrentShader while drawing.
+	Shader* Material = nullptr;
+
+	Mat4 Transform;
+	const StaticMesh* Mesh = nullptr;
+
+	// Optional cached static lighting, see RenderHelper::FillMesh.
+	const std::vector<Vec3F>* StaticLight = nullptr;
+
+	// Per instance transforms and tints, usually allocated from the frame arena.
+	const Mat4* Instances = nullptr;
+	const Color* InstanceColors = nullptr;
+	unsigned InstanceCount = 0;
+};
+
+/**
+ * \brief Collects the draws of a frame so they run in an order that suits the rasterizer instead of the order objects
+ * render in. Every command gets a 64 bit key of its pass, material and depth, the keys are radix sorted and the
+ * commands executed in that order: pass by pass, materials batched within a pass and front to back within a material
+ * so the depth test rejects as much as possible before shading. Memory is kept between frames.
+ */
+class RenderCommandBuffer
+{
+public:
+	/**
+	 * \brief Records a draw.
+	 * \param Depth View space depth of the draw, usually of the center of its bounds. Nearer draws go first.
+	 */
+	void Submit(RenderPass Pass, float Depth, const RenderCommand& Command);
+
+	/**
+	 * \brief Sorts the recorded commands by their keys, stable for equal keys.
+	 */
+	void Sort();
+
+	/**
+	 * \brief Runs the commands in sorted order, setting the current shader and depth pre-pass state of RenderHelper for
+	 * each.
+	 */
+	void Execute(const Camera& C);
+
+	/**
+	 * \brief Drops every command, call once the frame has been executed.
+	 */
+	void Clear();
+
+	unsigned GetCount() const;
+
+	/**
+	 * \brief Packs a sort key, the pass in the top 4 bits, then 12 bits of material and 32 bits of depth. The lowest
+	 * 16 bits are unused and skipped by the sort.
+	 */
+	static uint64_t MakeKey(RenderPass Pass, unsigned MaterialId, float Depth);
+
+private:
+	struct SortEntry {
+		uint64_t Key;
+		unsigned Command;
+	};
+
+	std::vector<RenderCommand> Commands;
+	std::vector<SortEntry> Entries;
+
+	// Ping pong buffer of the radix sort.
+	std::vector<SortEntry> SortScratch;
+
+	// Identity of every material seen this frame, its id in the sort keys is its index here.
+	std::vector<size_t> Materials;
+
+	/**
+	 * \brief Finds the id of a material, materials created from the same shader stages share one.
+	 */
+	unsigned GetMaterialId(const Shader* Material);
+};
@@ -1,16 +1,39 @@
 #include "RenderHelper.h"
 
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <xmmintrin.h>
+
 #include "GEngine.h"
 #include "EngineDefines.h"
+#include "FrameArena.h"
 #include "Shader.h"
+#include "StaticMesh.h"
+#include "Texture.h"
+#include "VertexKernel.h"
+#include "WorkerPool.h"
 #include "tiles_12.h"
 
+std::vector<const Shader*> RenderHelper::Materials;
+bool RenderHelper::IsDepthPrepass = false;
+
 void RenderHelper::VertexShader(Vert& V, Mat4& T, const Camera& C) {
 	if (CurrentShader) {
 		CurrentShader->VertexShader(V, T, C);
 	}
 }
 
+void RenderHelper::StaticLightShader(Vert& V, const Mat4& T) {
+	if (CurrentShader && CurrentShader->StaticLightShader) {
+		CurrentShader->StaticLightShader(V, T);
+	}
+}
+
+bool RenderHelper::KeepsPositions() {
+	return !CurrentShader || CurrentShader->Positions == Shader::VertexPositions::Unchanged;
+}
+
 void RenderHelper::DrawDepth(const std::vector<float>& DepthBuffer) {
 	for (int y = 0; y < GEngine::Get()->Width; ++y) {
 		for (int x = 0; x < GEngine::Get()->Height; ++x) {
@@ -26,83 +49,284 @@ void RenderHelper::DrawPixel(const unsigned& Pixel, const unsigned X, const unsi
 	// Do not draw pixels off screen.
 	if (X >= engine->Width || Y >= engine->Height) return;
 
+	WritePixel(engine->Pixels[TwoD2OneD(X, Y, engine->Width)], Pixel);
+}
+
+void RenderHelper::WritePixel(unsigned& Target, const unsigned Pixel) {
+	// Opaque pixels replace the background outright.
+	if ((Pixel & 0xFF000000) == 0xFF000000) {
+		Target = Pixel;
+		return;
+	}
+
 	auto foreground = Color(Pixel);
-	auto& target = engine->Pixels[TwoD2OneD(X, Y, GEngine::Get()->Width)];
-	const auto background = Color(target);
+	const auto background = Color(Target);
 
 	if (foreground.A <= 0) {
-		target ^= 0xFF000000;
+		Target ^= 0xFF000000;
 		return;
 	}
 
 	const auto result = Color::AlphaBlend(foreground, background);
 
-	target = result.Get();
+	Target = result.Get();
 }
 
-void RenderHelper::DrawLine(const Vec2F& Start, const Vec2F& End) {
-	Vec2F lp, rp;
+namespace {
+	/**
+	 * \brief Clips a line to the screen with Liang-Barsky and snaps the clipped end points to pixels.
+	 * \param T0 Receives where along the line the clipped start is, from 0 at Start to 1 at End.
+	 * \param T1 Receives where along the line the clipped end is.
+	 * \return False if no part of the line is on screen.
+	 */
+	bool ClipLine(const Vec2F& Start, const Vec2F& End, const int Width, const int Height, int& X0, int& Y0, int& X1,
+				  int& Y1, float& T0, float& T1) {
+		if (!std::isfinite(Start.X) || !std::isfinite(Start.Y) || !std::isfinite(End.X) || !std::isfinite(End.Y)) return false;
+
+		// Keep clipped points just inside the last row and column so they floor onto the screen.
+		const auto maxX = (float)Width - 0.001f;
+		const auto maxY = (float)Height - 0.001f;
+		const auto dx = End.X - Start.X;
+		const auto dy = End.Y - Start.Y;
+
+		// Each pair is the distance to an edge along the line and how fast the line moves towards it.
+		const float p[4] = {-dx, dx, -dy, dy};
+		const float q[4] = {Start.X, maxX - Start.X, Start.Y, maxY - Start.Y};
+
+		T0 = 0.0f;
+		T1 = 1.0f;
+		for (int i = 0; i < 4; ++i) {
+			if (p[i] == 0.0f) {
+				// Parallel to this edge and outside of it.
+				if (q[i] < 0.0f) return false;
+				continue;
+			}
+
+			const auto t = q[i] / p[i];
+			if (p[i] < 0.0f) {
+				if (t > T1) return false;
+				if (t > T0) T0 = t;
+			}
+			else {
+				if (t < T0) return false;
+				if (t < T1) T1 = t;
+			}
+		}
+
+		X0 = (int)std::floor(Clamp(Start.X + dx * T0, 0.0f, maxX));
+		Y0 = (int)std::floor(Clamp(Start.Y + dy * T0, 0.0f, maxY));
+		X1 = (int)std::floor(Clamp(Start.X + dx * T1, 0.0f, maxX));
+		Y1 = (int)std::floor(Clamp(Start.Y + dy * T1, 0.0f, maxY));
 
-	// Make sure Ax < Bx if not then swap A with B. Eliminating the left octants of the screen.
-	if (End.X > Start.X) {
-		rp = End;
-		lp = Start;
+		return true;
 	}
-	else {
-		rp = Start;
-		lp = End;
+
+	/**
+	 * \brief Steps an on screen line one pixel at a time along its major axis with the minor axis in 16.16 fixed point.
+	 * \param Write Called with the framebuffer pixel and step index of every pixel of the line.
+	 */
+	template<typename PixelWriter>
+	void StepLine(const int X0, const int Y0, const int X1, const int Y1, unsigned* Pixels, const int Width,
+				  PixelWriter Write) {
+		const auto dx = X1 - X0;
+		const auto dy = Y1 - Y0;
+		const auto isXMajor = std::abs(dx) >= std::abs(dy);
+		const auto steps = isXMajor ? std::abs(dx) : std::abs(dy);
+
+		const int64_t slope = steps == 0 ? 0 : ((int64_t)(isXMajor ? dy : dx) << 16) / steps;
+		int64_t minor = ((int64_t)(isXMajor ? Y0 : X0) << 16) + 0x8000;
+
+		// Walking the major axis moves through the framebuffer by a fixed stride.
+		const auto majorDir = (isXMajor ? dx : dy) < 0 ? -1 : 1;
+		const int majorStride = isXMajor ? majorDir : majorDir * Width;
+		const int minorStride = isXMajor ? Width : 1;
+		unsigned* base = Pixels + (isXMajor ? X0 : Y0 * Width);
+
+		for (int i = 0; i <= steps; ++i, base += majorStride, minor += slope) {
+			Write(base[(minor >> 16) * minorStride], i);
+		}
 	}
 
-	// Check to see if |Dx| > |Dy| (top and bottom quadrant) or if |Dy| > |Dx| (middle two quadrants)
-	// int Dx = Bx - Ax
-	const int deltaX = static_cast<int>(rp.X - lp.X);
-	// int Dy = abs(By - Ay)
-	int deltaY = static_cast<int>(std::abs(rp.Y - lp.Y));
-
-	int i;
-	float x, y;
-
-	// If the change in x is greater than the change in y, then we are in the middle two octants.
-	if (deltaX > deltaY) {
-		// Get the signed value of delta y
-		deltaY = static_cast<int>(rp.Y - lp.Y); // Truncate the float.
-		const float ndy = static_cast<float>(deltaY) / static_cast<float>(deltaX);
-
-		x = lp.X;
-		y = lp.Y;
-
-		for (i = 0; i < deltaX; i++) {
-			auto c = Color(Color::White);
-			Vec2F uv = { 0,0 };
-			auto v = Color(Color::White); // Default vert
-			if (CurrentShader) { CurrentShader->PixelShader(v, c, uv); }
-
-			DrawPixel(c.Get(), static_cast<uint32_t>(x), static_cast<uint32_t>(y)); // Truncate the float
-			x++;
-			y += ndy;
+	/**
+	 * \brief Edge equations of a screen space triangle, evaluated for the four pixels of a 2x2 quad at once. Lanes hold
+	 * the top left, top right, bottom left and bottom right pixel and get the same weights GetBarycentric gives.
+	 */
+	struct QuadEdges {
+		QuadEdges(const Vec2F& V0, const Vec2F& V1, const Vec2F& V2) {
+			// The weight of a corner is the distance to its opposite edge relative to the corners own distance to it.
+			Setup(0, V1, V2, V0);
+			Setup(1, V2, V0, V1);
+			Setup(2, V0, V1, V2);
+		}
+
+		/**
+		 * \brief Gets the barycentric weights of the pixels of the quad whose top left pixel is X, Y.
+		 * \param Weights Receives the weights of the first, second and third corner.
+		 * \return Coverage mask, bit i is set if pixel i is on screen and inside the triangle.
+		 */
+		int GetCoverage(const unsigned X, const unsigned Y, const unsigned Width, const unsigned Height,
+						__m128* Weights) const {
+			const auto px = _mm_add_ps(_mm_set1_ps((float)X), _mm_setr_ps(0.0f, 1.0f, 0.0f, 1.0f));
+			const auto py = _mm_add_ps(_mm_set1_ps((float)Y), _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f));
+			const auto zero = _mm_setzero_ps();
+			const auto one = _mm_set1_ps(1.0f);
+
+			auto isOutside = zero;
+			for (unsigned i = 0; i < 3; ++i) {
+				const auto distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(StepX[i], px), _mm_mul_ps(StepY[i], py)),
+												 Offset[i]);
+				Weights[i] = _mm_div_ps(distance, Area[i]);
+				isOutside = _mm_or_ps(isOutside, _mm_or_ps(_mm_cmplt_ps(Weights[i], zero), _mm_cmpgt_ps(Weights[i], one)));
+			}
+
+			// Quads on the last column or row hang over screens of odd sizes.
+			auto onScreen = 0xF;
+			if (X + 1 >= Width) onScreen &= 0x5;
+			if (Y + 1 >= Height) onScreen &= 0x3;
+
+			return ~_mm_movemask_ps(isOutside) & onScreen;
+		}
+
+	private:
+		__m128 StepX[3], StepY[3], Offset[3], Area[3];
+
+		void Setup(const unsigned I, const Vec2F& A, const Vec2F& B, const Vec2F& Opposite) {
+			StepX[I] = _mm_set1_ps(A.Y - B.Y);
+			StepY[I] = _mm_set1_ps(B.X - A.X);
+			Offset[I] = _mm_set1_ps(A.X * B.Y - A.Y * B.X);
+			Area[I] = _mm_set1_ps(ImplicitLineEquation(A, B, Opposite));
 		}
+	};
+
+	/**
+	 * \brief Gets the pixels a screen space triangle may cover, clamped to the screen and widened to whole 2x2 quads.
+	 * \return False if the triangle is entirely off screen.
+	 */
+	bool GetQuadBounds(const Vec2F& V0, const Vec2F& V1, const Vec2F& V2, const unsigned Width, const unsigned Height,
+					   unsigned& MinX, unsigned& MinY, unsigned& MaxX, unsigned& MaxY) {
+		// Clamp before converting, triangles reaching past the left or top edge have negative coordinates.
+		const auto minX = Max(Min(V0.X, Min(V1.X, V2.X)), 0.0f);
+		const auto minY = Max(Min(V0.Y, Min(V1.Y, V2.Y)), 0.0f);
+		const auto maxX = Min(Max(V0.X, Max(V1.X, V2.X)), (float)(Width - 1));
+		const auto maxY = Min(Max(V0.Y, Max(V1.Y, V2.Y)), (float)(Height - 1));
+		if (!(minX <= maxX && minY <= maxY)) return false;
+
+		MinX = Floor(minX) & ~1u;
+		MinY = Floor(minY) & ~1u;
+		MaxX = Floor(maxX);
+		MaxY = Floor(maxY);
+
+		return true;
 	}
-	else {
-		// the change in y is greater than the change in x so we are in one of the two outer octants.
-		deltaY = static_cast<int>(rp.Y - lp.Y);
-
-		const float ndx = static_cast<float>(deltaX) / static_cast<float>(std::abs(deltaY));
-		x = lp.X;
-		y = lp.Y;
-
-		for (i = 0; i < std::abs(deltaY); i++) {
-			auto c = Color(Color::White);
-			Vec2F uv = { 0,0 };
-			auto v = Color(Color::White);
-			if (CurrentShader) { CurrentShader->PixelShader(v, c, uv); }
-
-			DrawPixel(c.Get(), static_cast<uint32_t>(x), static_cast<uint32_t>(y)); // Truncate the float
-			y += rp.Y < lp.Y ? -1 : 1;
-			x += ndx;
+
+	/**
+	 * \brief Reads the depth buffer under the covered pixels of a quad.
+	 * \param Depths Receives the address in the depth buffer of every covered pixel.
+	 * \return Depth of the covered pixels, 0 for the others.
+	 */
+	__m128 GatherQuadDepth(GEngine* Engine, const unsigned X, const unsigned Y, const int Mask, float** Depths) {
+		alignas(16) float depth[4] = {};
+		for (unsigned i = 0; i < 4; ++i) {
+			if (!(Mask & (1 << i))) continue;
+
+			Depths[i] = &Engine->Depth[TwoD2OneD(X + (i & 1), Y + (i >> 1), Engine->Width)];
+			depth[i] = *Depths[i];
 		}
+
+		return _mm_load_ps(depth);
+	}
+
+	/**
+	 * \brief Gets how far the texture coordinate moves from one pixel of a quad to the next, the longer of its steps
+	 * along x and y.
+	 * \param U Texture coordinates of the four pixels of the quad, in lane order.
+	 */
+	float GetUvFootprint(const float* U, const float* V) {
+		const auto dx = std::sqrt((U[1] - U[0]) * (U[1] - U[0]) + (V[1] - V[0]) * (V[1] - V[0]));
+		const auto dy = std::sqrt((U[2] - U[0]) * (U[2] - U[0]) + (V[2] - V[0]) * (V[2] - V[0]));
+		const auto footprint = dx > dy ? dx : dy;
+
+		// Pixels of the quad outside the triangle can extrapolate past the horizon, use the full resolution then.
+		return std::isfinite(footprint) ? footprint : 0.0f;
 	}
 }
 
+void RenderHelper::DrawLine(const Vec2F& Start, const Vec2F& End) {
+	// The pixel shader gets the same inputs for every pixel of a line, so it only has to run once.
+	DrawLine(Start, End, ShadeLineColor());
+}
+
+unsigned RenderHelper::ShadeLineColor() {
+	auto c = Color(Color::White);
+	if (CurrentShader) {
+		Vec2F uv = { 0,0 };
+		auto v = Color(Color::White);
+		CurrentShader->PixelShader(v, c, uv);
+	}
+
+	return c.Get();
+}
+
+void RenderHelper::DrawLine(const Vec2F& Start, const Vec2F& End, const unsigned LineColor) {
+	const auto engine = GEngine::Get();
+
+	int x0, y0, x1, y1;
+	float t0, t1;
+	if (!ClipLine(Start, End, (int)engine->Width, (int)engine->Height, x0, y0, x1, y1, t0, t1)) return;
+
+	StepLine(x0, y0, x1, y1, engine->Pixels.data(), (int)engine->Width,
+			 [LineColor](unsigned& Target, int) { WritePixel(Target, LineColor); });
+}
+
+void RenderHelper::DrawLine(const Vec2F& Start, const Vec2F& End, const unsigned StartColor, const unsigned EndColor) {
+	const auto engine = GEngine::Get();
+
+	int x0, y0, x1, y1;
+	float t0, t1;
+	if (!ClipLine(Start, End, (int)engine->Width, (int)engine->Height, x0, y0, x1, y1, t0, t1)) return;
+
+	const auto dx = std::abs(x1 - x0);
+	const auto dy = std::abs(y1 - y0);
+	const auto steps = dx > dy ? dx : dy;
+
+	// Channels are interpolated in 8.16 fixed point over the visible part of the line.
+	int channelStart[4], channelSlope[4];
+	for (int c = 0; c < 4; ++c) {
+		const auto from = (float)((StartColor >> (c * 8)) & 0xFF);
+		const auto to = (float)((EndColor >> (c * 8)) & 0xFF);
+		const auto visibleFrom = (int)LerpF(from, to, t0);
+		const auto visibleTo = (int)LerpF(from, to, t1);
+		channelStart[c] = visibleFrom << 16;
+		channelSlope[c] = steps == 0 ? 0 : ((visibleTo - visibleFrom) << 16) / steps;
+	}
+
+	StepLine(x0, y0, x1, y1, engine->Pixels.data(), (int)engine->Width,
+			 [&channelStart, &channelSlope](unsigned& Target, const int Step) {
+				 unsigned pixel = 0;
+				 for (int c = 0; c < 4; ++c) {
+					 const auto channel = (channelStart[c] + channelSlope[c] * Step) >> 16;
+					 pixel |= (unsigned)(channel < 0 ? 0 : channel > 255 ? 255 : channel) << (c * 8);
+				 }
+				 WritePixel(Target, pixel);
+			 });
+}
+
+void RenderHelper::DrawLine(const Camera* C, Vec3F ViewStart, Vec3F ViewEnd, const unsigned LineColor) {
+	// Clip against the near plane first, points behind the camera would project mirrored onto the screen.
+	const auto nearPlane = C->NearPlane;
+	if (ViewStart.Z < nearPlane && ViewEnd.Z < nearPlane) return;
+
+	if (ViewStart.Z < nearPlane || ViewEnd.Z < nearPlane) {
+		auto& behind = ViewStart.Z < nearPlane ? ViewStart : ViewEnd;
+		const auto& front = ViewStart.Z < nearPlane ? ViewEnd : ViewStart;
+
+		const auto t = (nearPlane - behind.Z) / (front.Z - behind.Z);
+		behind = Vec3F(LerpF(behind.X, front.X, t), LerpF(behind.Y, front.Y, t), nearPlane);
+	}
+
+	DrawLine(C->ViewToScreen(ViewStart), C->ViewToScreen(ViewEnd), LineColor);
+}
+
 void RenderHelper::DrawWireCube(const Camera* C, Mat4& Transform, const float Scale, Shader RenderShader) {
 	const auto halfScale = Scale / 2;
 
@@ -117,37 +341,62 @@ void RenderHelper::DrawWireCube(const Camera* C, Mat4& Transform, const float Sc
 	points[6] = Vec3F(halfScale, halfScale, halfScale);
 	points[7] = Vec3F(-halfScale, halfScale, halfScale);
 
-	Vec2F projectedPoints[8]{};
+	// Lines are clipped in view space so keep the corners there.
+	const auto toView = Transform * C->GetViewMatrix();
+	Vec3F viewPoints[8]{};
 	for (int i = 0; i < 8; ++i) {
-		float depth;
-		projectedPoints[i] = Camera::WorldToScreen(*C, {points[i] , Color()}, Transform);
+		viewPoints[i] = toView.Project(points[i]);
 	}
 
 	CurrentShader = &RenderShader;
+	const auto lineColor = ShadeLineColor();
 	
 	for (int i = 0; i < 4; ++i) {
-		DrawLine(projectedPoints[i], projectedPoints[(i + 1) % 4]);
-		DrawLine(projectedPoints[i + 4], projectedPoints[((i + 1) % 4) + 4]);
-		DrawLine(projectedPoints[i], projectedPoints[i + 4]);
+		DrawLine(C, viewPoints[i], viewPoints[(i + 1) % 4], lineColor);
+		DrawLine(C, viewPoints[i + 4], viewPoints[((i + 1) % 4) + 4], lineColor);
+		DrawLine(C, viewPoints[i], viewPoints[i + 4], lineColor);
 	}
 
 	CurrentShader = nullptr;
 }
 
 void RenderHelper::DrawWireTriangle(const Camera* C, Mat4& Transform, const std::vector<Vert>& Vertices) {
-	DrawLine(Camera::WorldToScreen(*C, Vertices[0], Transform), Camera::WorldToScreen(*C, Vertices[1], Transform));
-	DrawLine(Camera::WorldToScreen(*C, Vertices[1], Transform), Camera::WorldToScreen(*C, Vertices[2], Transform));
-	DrawLine(Camera::WorldToScreen(*C, Vertices[2], Transform), Camera::WorldToScreen(*C, Vertices[0], Transform));
+	const auto toView = Transform * C->GetViewMatrix();
+	const Vec3F viewPoints[3] = {
+		toView.Project(Vertices[0].Pos), toView.Project(Vertices[1].Pos), toView.Project(Vertices[2].Pos)
+	};
+
+	const auto lineColor = ShadeLineColor();
+	DrawLine(C, viewPoints[0], viewPoints[1], lineColor);
+	DrawLine(C, viewPoints[1], viewPoints[2], lineColor);
+	DrawLine(C, viewPoints[2], viewPoints[0], lineColor);
 }
 
-void RenderHelper::DrawWireMesh(const Camera* C, Mat4& Transform, std::vector<Vert> Vertices,
-								const std::vector<unsigned>& Indices) {
-	for (uint32_t i = 0; i < Indices.size(); i += 3) {
-		std::vector<Vert> curTriangle;
-		curTriangle.emplace_back(Vertices[Indices[i]]);
-		curTriangle.emplace_back(Vertices[Indices[i + 1]]);
-		curTriangle.emplace_back(Vertices[Indices[i + 2]]);
-		DrawWireTriangle(C, Transform, curTriangle);
+void RenderHelper::DrawWireMesh(const Camera* C, Mat4& Transform, const std::vector<Vert>& Vertices,
+								const std::vector<unsigned>& Edges) {
+	const auto toView = Transform * C->GetViewMatrix();
+
+	// Vertices in front of the near plane are projected once, edges crossing it are clipped in view space.
+	FrameVector<Vec3F> view;
+	FrameVector<Vec2F> projected;
+	view.reserve(Vertices.size());
+	projected.reserve(Vertices.size());
+	for (const auto& v : Vertices) {
+		view.emplace_back(toView.Project(v.Pos));
+		projected.emplace_back(view.back().Z >= C->NearPlane ? C->ViewToScreen(view.back()) : Vec2F());
+	}
+
+	const auto lineColor = ShadeLineColor();
+	for (size_t i = 0; i + 1 < Edges.size(); i += 2) {
+		const auto a = Edges[i];
+		const auto b = Edges[i + 1];
+
+		if (view[a].Z >= C->NearPlane && view[b].Z >= C->NearPlane) {
+			DrawLine(projected[a], projected[b], lineColor);
+		}
+		else {
+			DrawLine(C, view[a], view[b], lineColor);
+		}
 	}
 }
 
@@ -157,15 +406,17 @@ void RenderHelper::DrawGrid(const Camera* Viewer, int WidthDivisions, int Height
 	const auto halfWidth = (GridWidth / 2);
 	const auto halfHeight = (GridWidth / 2);
 
+	// The grid lies in world space, so only the view is needed to clip its lines.
+	const auto toView = Viewer->GetViewMatrix();
+
 	float j;
 	// Draw x lines
-	Mat4 trans = {};
 	const auto deltaX = (GridWidth / WidthDivisions) * 2;
 	for (j = -GridHeight; j <= GridHeight; j += deltaX) {
 		const auto a = Vec3F{j, 0, -GridWidth};
 		const auto b = Vec3F{j, 0, GridWidth};
 
-		DrawLine(Camera::WorldToScreen(*Viewer, {a, {}}, trans), Camera::WorldToScreen(*Viewer, {b, {}}, trans));
+		DrawLine(Viewer, toView.Project(a), toView.Project(b), Color);
 	}
 
 	// Draw y lines
@@ -173,7 +424,7 @@ void RenderHelper::DrawGrid(const Camera* Viewer, int WidthDivisions, int Height
 	for (j = -GridHeight; j <= GridHeight; j += deltaY) {
 		const auto a = Vec3F{-GridWidth, 0, j};
 		const auto b = Vec3F{GridWidth, 0, j};
-		DrawLine(Camera::WorldToScreen(*Viewer, {a, {}}, trans), Camera::WorldToScreen(*Viewer, {b, {}}, trans));
+		DrawLine(Viewer, toView.Project(a), toView.Project(b), Color);
 	}
 }
 
@@ -184,111 +435,508 @@ void RenderHelper::FillTriangle(const Camera* C, Mat4& Transform, const std::vec
 	p2 = Vertices[1];
 	p3 = Vertices[2];
 
-	// Run vertex shader on the copies.
+	// The depth pre-pass only needs positions.
+	if (IsDepthPrepass) {
+		RasterizeDepth(C, Camera::WorldToScreen(*C, p1, Transform), Camera::WorldToScreen(*C, p2, Transform),
+					   Camera::WorldToScreen(*C, p3, Transform));
+		return;
+	}
+
+	// Run the light and vertex shaders on the copies.
+	RenderHelper::StaticLightShader(p1, Transform);
+	RenderHelper::StaticLightShader(p2, Transform);
+	RenderHelper::StaticLightShader(p3, Transform);
 	RenderHelper::VertexShader(p1, Transform, *C);
 	RenderHelper::VertexShader(p2, Transform, *C);
 	RenderHelper::VertexShader(p3, Transform, *C);
 
 	// Convert the 3 vertices of the triangle to screen space.
-	auto v0 = Camera::WorldToScreen(*C, p1, Transform);
-	auto v1 = Camera::WorldToScreen(*C, p2, Transform);
-	auto v2 = Camera::WorldToScreen(*C, p3, Transform);
+	const auto v0 = Camera::WorldToScreen(*C, p1, Transform);
+	const auto v1 = Camera::WorldToScreen(*C, p2, Transform);
+	const auto v2 = Camera::WorldToScreen(*C, p3, Transform);
 
+	RasterizeTriangle(C, p1, p2, p3, v0, v1, v2, &Uv[0]);
+}
+
+void RenderHelper::RasterizeDepth(const Camera* C, const Vec2F& V0, const Vec2F& V1, const Vec2F& V2) {
+	// Cull the same faces as the shading pass.
+	if (ImplicitLineEquation(V0, V1, V2) <= 0.0f) return;
+
+	const auto engine = GEngine::Get();
+
+	unsigned minX, minY, maxX, maxY;
+	if (!GetQuadBounds(V0, V1, V2, engine->Width, engine->Height, minX, minY, maxX, maxY)) return;
+
+	const QuadEdges edges(V0, V1, V2);
+	const auto z0 = _mm_set1_ps(V0.Z), z1 = _mm_set1_ps(V1.Z), z2 = _mm_set1_ps(V2.Z);
+	const auto nearPlane = _mm_set1_ps(C->NearPlane), farPlane = _mm_set1_ps(C->FarPlane);
+
+	for (auto y = minY; y <= maxY; y += 2) {
+		for (auto x = minX; x <= maxX; x += 2) {
+			__m128 weights[3];
+			auto mask = edges.GetCoverage(x, y, engine->Width, engine->Height, weights);
+			if (!mask) continue;
+
+			// Interpolated exactly like the shading pass so its equal test matches.
+			const auto lerpZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(z0, weights[0]), _mm_mul_ps(z1, weights[1])),
+										  _mm_mul_ps(z2, weights[2]));
+
+			float* depths[4];
+			const auto current = GatherQuadDepth(engine, x, y, mask, depths);
+			const auto isRejected = _mm_or_ps(_mm_cmple_ps(current, lerpZ),
+											  _mm_or_ps(_mm_cmplt_ps(lerpZ, nearPlane), _mm_cmpgt_ps(lerpZ, farPlane)));
+			mask &= ~_mm_movemask_ps(isRejected);
+
+			alignas(16) float z[4];
+			_mm_store_ps(z, lerpZ);
+			for (unsigned i = 0; i < 4; ++i) {
+				if (mask & (1 << i)) *depths[i] = z[i];
+			}
+		}
+	}
+}
+
+void RenderHelper::RasterizeTriangle(const Camera* C, const Vert& P1, const Vert& P2, const Vert& P3, const Vec2F& V0,
+									 const Vec2F& V1, const Vec2F& V2, const Vec2F* Uv) {
 	// CA: BACKFACE CULLING
-	float fWinding  = ImplicitLineEquation(v0, v1, v2);
-	if (fWinding < 0.0f)
+	float fWinding  = ImplicitLineEquation(V0, V1, V2);
+	if (fWinding <= 0.0f)
 		return;
 
-	auto invV0 = 1 / v0.Z;
-	auto invV1 = 1 / v1.Z;
-	auto invV2 = 1 / v2.Z;
+	auto invV0 = 1 / V0.Z;
+	auto invV1 = 1 / V1.Z;
+	auto invV2 = 1 / V2.Z;
 
-	auto scaledUv0 = Uv[0] / v0.Z;
-	auto scaledUv1 = Uv[1] / v1.Z;
-	auto scaledUv2 = Uv[2] / v2.Z;
+	auto scaledUv0 = Uv[0] / V0.Z;
+	auto scaledUv1 = Uv[1] / V1.Z;
+	auto scaledUv2 = Uv[2] / V2.Z;
 
 	const auto engine = GEngine::Get();
 
-	// Get the bounding box for the triangle
-	auto minX = Floor(Min(v0.X, Min(v1.X, v2.X)));
-	auto maxX = Floor(Max(v0.X, Max(v1.X, v2.X)));
-	auto minY = Floor(Min(v0.Y, Min(v1.Y, v2.Y)));
-	auto maxY = Floor(Max(v0.Y, Max(v1.Y, v2.Y)));
+	// Deferred rendering records which material shades the pixels of this triangle instead of running it.
+	const auto isDeferred = engine->CurrentRenderPath == RenderPath::Deferred;
+	const auto materialId = isDeferred ? GetMaterialId(CurrentShader) : (unsigned short)0;
+	const auto hasDepthPrepass = engine->CurrentRenderPath == RenderPath::DepthPrepass;
+
+	// Get the bounding box for the triangle in whole 2x2 quads, clamped to screen space.
+	unsigned minX, minY, maxX, maxY;
+	if (!GetQuadBounds(V0, V1, V2, engine->Width, engine->Height, minX, minY, maxX, maxY)) return;
+
+	const QuadEdges edges(V0, V1, V2);
+	const auto z0 = _mm_set1_ps(V0.Z), z1 = _mm_set1_ps(V1.Z), z2 = _mm_set1_ps(V2.Z);
+	const auto invW0 = _mm_set1_ps(invV0), invW1 = _mm_set1_ps(invV1), invW2 = _mm_set1_ps(invV2);
+	const auto u0 = _mm_set1_ps(scaledUv0.X), u1 = _mm_set1_ps(scaledUv1.X), u2 = _mm_set1_ps(scaledUv2.X);
+	const auto v0 = _mm_set1_ps(scaledUv0.Y), v1 = _mm_set1_ps(scaledUv1.Y), v2 = _mm_set1_ps(scaledUv2.Y);
+	const auto nearPlane = _mm_set1_ps(C->NearPlane), farPlane = _mm_set1_ps(C->FarPlane);
+
+	// Rasterize 2x2 quads so every pixel has neighbours to take screen space derivatives from, even pixels of the
+	// quad outside the triangle get their attributes interpolated for that.
+	for (auto y = minY; y <= maxY; y += 2) {
+		for (auto x = minX; x <= maxX; x += 2) {
+			__m128 weights[3];
+			auto mask = edges.GetCoverage(x, y, engine->Width, engine->Height, weights);
+			if (!mask) continue;
 
-	// Clamp to screen space.
-	minX = max(minX, 0);
-	minY = max(minY, 0);
-	maxX = min(maxX, GEngine::Get()->Width - 1);
-	maxY = min(maxY, GEngine::Get()->Height - 1);
+			// Interpolate between the depth of the original points.
+			const auto lerpZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(z0, weights[0]), _mm_mul_ps(z1, weights[1])),
+										  _mm_mul_ps(z2, weights[2]));
+
+			// Check the depth of the current pixels and if they are farther away than the older ones. After a depth
+			// pre-pass only the fragment that wrote the depth is shaded.
+			float* depths[4];
+			const auto current = GatherQuadDepth(engine, x, y, mask, depths);
+			const auto isBehind = hasDepthPrepass ? _mm_cmpneq_ps(current, lerpZ) : _mm_cmple_ps(current, lerpZ);
+			const auto isRejected = _mm_or_ps(isBehind,
+											  _mm_or_ps(_mm_cmplt_ps(lerpZ, nearPlane), _mm_cmpgt_ps(lerpZ, farPlane)));
+			mask &= ~_mm_movemask_ps(isRejected);
+			if (!mask) continue;
+
+			// Calculate perspective correct uv coordinates for the whole quad.
+			const auto invW = _mm_add_ps(_mm_add_ps(_mm_mul_ps(invW0, weights[0]), _mm_mul_ps(invW1, weights[1])),
+										 _mm_mul_ps(invW2, weights[2]));
+			const auto u = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(u0, weights[0]), _mm_mul_ps(u1, weights[1])),
+												 _mm_mul_ps(u2, weights[2])), invW);
+			const auto v = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(v0, weights[0]), _mm_mul_ps(v1, weights[1])),
+												 _mm_mul_ps(v2, weights[2])), invW);
+
+			alignas(16) float bx[4], by[4], bz[4], z[4], us[4], vs[4];
+			_mm_store_ps(bx, weights[0]);
+			_mm_store_ps(by, weights[1]);
+			_mm_store_ps(bz, weights[2]);
+			_mm_store_ps(z, lerpZ);
+			_mm_store_ps(us, u);
+			_mm_store_ps(vs, v);
+
+			// Texel footprint of the quad, how far the uv moves from one pixel to the next along either axis.
+			const auto footprint = GetUvFootprint(us, vs);
+			Texture::SetSampleFootprint(footprint);
+
+			for (unsigned i = 0; i < 4; ++i) {
+				if (!(mask & (1 << i))) continue;
+
+				const Vec3F bary(bx[i], by[i], bz[i]);
+				Vec2F uv{us[i], vs[i]};
+
+				// Calculate the average color for the current point.
+				const float a = bary.X * P1.C.A + bary.Y * P2.C.A + bary.Z * P3.C.A;
+				const float r = bary.X * P1.C.R + bary.Y * P2.C.G + bary.Z * P3.C.B;
+				const float g = bary.X * P1.C.R + bary.Y * P2.C.G + bary.Z * P3.C.B;
+				const float b = bary.X * P1.C.R + bary.Y * P2.C.G + bary.Z * P3.C.B;
+
+				// Calculate interpolated lighting value.
+				const float lr = bary.X * P1.Light.X + bary.Y * P2.Light.X + bary.Z * P3.Light.X;
+				const float lg = bary.X * P1.Light.Y + bary.Y * P2.Light.Y + bary.Z * P3.Light.Y;
+				const float lb = bary.X * P1.Light.Z + bary.Y * P2.Light.Z + bary.Z * P3.Light.Z;
+
+				if (isDeferred) {
+					*depths[i] = z[i];
+
+					// Store the surface, only the nearest one left at the end of the frame gets shaded.
+					auto& texel = engine->GBuffer[TwoD2OneD(x + (i & 1), y + (i >> 1), engine->Width)];
+					texel.U = uv.X;
+					texel.V = uv.Y;
+					texel.Normal = GBufferTexel::PackNormal(
+						bary.X * P1.Norm.X + bary.Y * P2.Norm.X + bary.Z * P3.Norm.X,
+						bary.X * P1.Norm.Y + bary.Y * P2.Norm.Y + bary.Z * P3.Norm.Y,
+						bary.X * P1.Norm.Z + bary.Y * P2.Norm.Z + bary.Z * P3.Norm.Z);
+					texel.Light = GBufferTexel::PackLight(lr, lg, lb);
+					texel.Albedo = Color(a, r, g, b).Get();
+					texel.Material = materialId;
+					texel.UvFootprint = footprint;
+					continue;
+				}
+
+				// Calculate lighting color.
+				auto lc = Color((lr+lg+lb)/3.0f, lr, lg, lb);
+
+				// Run the current pixel shader to affect the final color and uv.
+				Color col{a, r, g, b};
+				if (CurrentShader) {
+					CurrentShader->PixelShader(lc, col, uv);
+				}
+
+				// Update the depth of this pixel in the buffer.
+				*depths[i] = z[i];
+
+				DrawPixel(col.Get(), x + (i & 1), y + (i >> 1));
+			}
+		}
+	}
 
-	// For every point in the bounding box, determine if it falls on the triangle.
-	for (unsigned y = minY; y <= maxY; y++) {
-		for (unsigned x = minX; x <= maxX; x++) {
-			auto p = Vec2F{ (float)x, (float)y };
+	// Anything sampled outside of a triangle uses the full resolution.
+	Texture::SetSampleFootprint(0.0f);
+}
 
-			const auto bary = GetBarycentric(p, v0, v1, v2);
+void RenderHelper::FillMesh(const Camera* C, Mat4& Transform, const std::vector<Vert>& Vertices,
+							const std::vector<unsigned>& Indices, const std::vector<Vec2F>& Uv,
+							const std::vector<Vec3F>* StaticLight) {
+	FillMeshShared(C, Transform, Vertices, Indices, Uv, StaticLight, nullptr);
+}
 
-			if (bary.X < 0.0f || bary.X > 1.0f || bary.Y < 0.0f || bary.Y > 1.0f || bary.Z < 0.0f || bary.Z > 1.0f)
-				continue;
+void RenderHelper::FillMesh(const Camera* C, Mat4& Transform, const StaticMesh& Mesh,
+							const std::vector<Vec3F>* StaticLight) {
+	// Meshlet bounds and vertex streams only hold the positions the mesh was built with.
+	FillMeshShared(C, Transform, Mesh.Vertices, Mesh.Indices, Mesh.Uv, StaticLight, KeepsPositions() ? &Mesh : nullptr);
+}
 
-			// Interpolate between the depth of the original points.
-			const auto lerpZ = v0.Z * bary.X + v1.Z * bary.Y + v2.Z * bary.Z;
-
-			
-
-			// Check the depth of the current pixel and if it is farther away than the older one.
-			if(engine->Depth[TwoD2OneD(x, y, engine->Width)] <= lerpZ || lerpZ < C->NearPlane || lerpZ > C->FarPlane) continue;
-
-			// Calculate perspective correct uv coordinate.
-			const auto invW = invV0 * bary.X + invV1 * bary.Y + invV2 * bary.Z;
-
-			Vec2F uv = scaledUv0 * bary.X + scaledUv1 * bary.Y + scaledUv2 * bary.Z;
-			uv /= invW;
-			
-			// Calculate the average color for the current point.
-			const float a = bary.X * p1.C.A + bary.Y * p2.C.A + bary.Z * p3.C.A;
-			const float r = bary.X * p1.C.R + bary.Y * p2.C.G + bary.Z * p3.C.B;
-			const float g = bary.X * p1.C.R + bary.Y * p2.C.G + bary.Z * p3.C.B;
-			const float b = bary.X * p1.C.R + bary.Y * p2.C.G + bary.Z * p3.C.B;
-
-			// Calculate interpolated lighting value.
-			const float lr = bary.X * p1.Light.X + bary.Y * p2.Light.X + bary.Z * p3.Light.X;
-			const float lg = bary.X * p1.Light.Y + bary.Y * p2.Light.Y + bary.Z * p3.Light.Y;
-			const float lb = bary.X * p1.Light.Z + bary.Y * p2.Light.Z + bary.Z * p3.Light.Z;
-
-			// Calculate lighting color.
-			auto lc = Color((lr+lg+lb)/3.0f, lr, lg, lb);
-
-			// Run the current pixel shader to affect the final color and uv.
-			Color col{a, r, g, b};
-			if (CurrentShader) {
-				
-				CurrentShader->PixelShader(lc, col, uv);
+void RenderHelper::FillMeshInstanced(const Camera* C, const StaticMesh& Mesh, const Mat4* Transforms,
+									 const Color* Colors, const unsigned Count) {
+	const auto vertexCount = (unsigned)Mesh.Vertices.size();
+	const auto keepsPositions = KeepsPositions();
+	const auto isLightBatched = !IsDepthPrepass && CurrentShader && CurrentShader->HasRegistryStaticLight();
+	const auto& lights = GEngine::Get()->Lights;
+
+	// Scratch is sized for one group and reused by every group.
+	const auto groupSize = Count < InstanceGroupSize ? Count : InstanceGroupSize;
+	FrameVector<unsigned> instances, visible, visibleOffsets, vertexIds, culled;
+	FrameVector<Mat4> transforms;
+	FrameVector<unsigned> usedBy(vertexCount, ~0u);
+	FrameVector<Vec2F> projected(groupSize * vertexCount);
+	FrameVector<Vert> shaded(IsDepthPrepass ? 0 : vertexCount);
+	FrameVector<unsigned> shadedBy(IsDepthPrepass ? 0 : vertexCount, ~0u);
+	FrameVector<Vec3F> staticLight(isLightBatched ? vertexCount : 0);
+	instances.reserve(groupSize);
+	transforms.reserve(groupSize);
+	visibleOffsets.reserve(groupSize + 1);
+
+	const auto forEachTriangle = [&](const unsigned Instance, const auto& Draw) {
+		for (auto m = visibleOffsets[Instance]; m < visibleOffsets[Instance + 1]; ++m) {
+			const auto& meshlet = Mesh.Meshlets.Meshlets[visible[m]];
+			for (auto i = meshlet.TriangleOffset; i < meshlet.TriangleOffset + meshlet.TriangleCount; ++i) {
+				Draw(Mesh.Meshlets.TriangleIds[i]);
+			}
+		}
+	};
+
+	for (unsigned first = 0; first < Count; first += groupSize) {
+		const auto last = Count - first < groupSize ? Count : first + groupSize;
+
+		// Cull the meshlets of every instance in the group first. Instances with nothing left are dropped and the
+		// vertices the rest use are gathered into one list.
+		instances.clear();
+		transforms.clear();
+		visible.clear();
+		vertexIds.clear();
+		visibleOffsets.clear();
+		visibleOffsets.emplace_back(0);
+		for (auto i = first; i < last; ++i) {
+			auto transform = Transforms[i];
+			if (keepsPositions) {
+				Mesh.Meshlets.Cull(*C, transform, culled);
+				if (culled.empty()) continue;
+			}
+			else {
+				// Meshlet bounds only hold the positions the mesh was built with.
+				culled.clear();
+				for (unsigned m = 0; m < Mesh.Meshlets.Meshlets.size(); ++m) culled.emplace_back(m);
+			}
+
+			for (const auto m : culled) {
+				visible.emplace_back(m);
+
+				const auto& meshlet = Mesh.Meshlets.Meshlets[m];
+				for (auto v = meshlet.VertexOffset; v < meshlet.VertexOffset + meshlet.VertexCount; ++v) {
+					const auto id = Mesh.Meshlets.VertexIds[v];
+					if (usedBy[id] == first) continue;
+
+					usedBy[id] = first;
+					vertexIds.emplace_back(id);
+				}
+			}
+
+			instances.emplace_back(i);
+			transforms.emplace_back(transform);
+			visibleOffsets.emplace_back((unsigned)visible.size());
+		}
+
+		if (instances.empty()) continue;
+
+		// Every instance shares the positions, so each batch of them is loaded once and projected for the whole
+		// group. Shaders that move vertices are projected one vertex at a time after they run instead.
+		const auto instanceCount = (unsigned)instances.size();
+		if (keepsPositions) {
+			VertexKernel::ProjectInstances(Mesh.Streams, transforms.data(), instanceCount, *C, vertexIds, projected);
+		}
+
+		if (IsDepthPrepass) {
+			for (unsigned k = 0; k < instanceCount; ++k) {
+				auto* p = &projected[k * vertexCount];
+				if (!keepsPositions) {
+					for (const auto id : vertexIds) {
+						auto vertex = Mesh.Vertices[id];
+						VertexShader(vertex, transforms[k], *C);
+						p[id] = Camera::WorldToScreen(*C, vertex, transforms[k]);
+					}
+				}
+
+				forEachTriangle(k, [&](const unsigned T) {
+					RasterizeDepth(C, p[Mesh.Indices[T * 3]], p[Mesh.Indices[T * 3 + 1]], p[Mesh.Indices[T * 3 + 2]]);
+				});
+			}
+			continue;
+		}
+
+		// Each instance lights and shades only the vertices of its own meshlets, once each, then draws them.
+		for (unsigned k = 0; k < instanceCount; ++k) {
+			const auto instance = instances[k];
+			auto& transform = transforms[k];
+			auto* p = &projected[k * vertexCount];
+
+			if (isLightBatched) lights.EvaluateStatic(Mesh.Streams, transform, &Colors[instance], staticLight.data());
+
+			for (auto m = visibleOffsets[k]; m < visibleOffsets[k + 1]; ++m) {
+				const auto& meshlet = Mesh.Meshlets.Meshlets[visible[m]];
+				for (auto v = meshlet.VertexOffset; v < meshlet.VertexOffset + meshlet.VertexCount; ++v) {
+					const auto id = Mesh.Meshlets.VertexIds[v];
+					if (shadedBy[id] == instance) continue;
+					shadedBy[id] = instance;
+
+					auto& vertex = shaded[id];
+					vertex = Mesh.Vertices[id];
+					vertex.C = Color::Modulate(vertex.C, Colors[instance]);
+
+					if (isLightBatched) {
+						vertex.Light = staticLight[id];
+					}
+					else {
+						StaticLightShader(vertex, transform);
+					}
+
+					VertexShader(vertex, transform, *C);
+					if (!keepsPositions) p[id] = Camera::WorldToScreen(*C, vertex, transform);
+				}
+			}
+
+			forEachTriangle(k, [&](const unsigned T) {
+				const auto a = Mesh.Indices[T * 3];
+				const auto b = Mesh.Indices[T * 3 + 1];
+				const auto c = Mesh.Indices[T * 3 + 2];
+
+				RasterizeTriangle(C, shaded[a], shaded[b], shaded[c], p[a], p[b], p[c], &Mesh.Uv[T * 3]);
+			});
+		}
+	}
+}
+
+void RenderHelper::FillMeshShared(const Camera* C, Mat4& Transform, const std::vector<Vert>& Vertices,
+								  const std::vector<unsigned>& Indices, const std::vector<Vec2F>& Uv,
+								  const std::vector<Vec3F>* StaticLight, const StaticMesh* Mesh) {
+	// Static meshes only draw the meshlets that survive culling and only touch the vertices those use.
+	FrameVector<unsigned> visible, vertexIds;
+	if (Mesh) {
+		Mesh->Meshlets.Cull(*C, Transform, visible);
+		if (visible.empty()) return;
+
+		FrameVector<bool> isUsed(Vertices.size(), false);
+		for (const auto m : visible) {
+			const auto& meshlet = Mesh->Meshlets.Meshlets[m];
+			for (auto i = meshlet.VertexOffset; i < meshlet.VertexOffset + meshlet.VertexCount; ++i) {
+				const auto v = Mesh->Meshlets.VertexIds[i];
+				if (isUsed[v]) continue;
+
+				isUsed[v] = true;
+				vertexIds.emplace_back(v);
+			}
+		}
+	}
+
+	const auto forEachTriangle = [&](const auto& Draw) {
+		if (!Mesh) {
+			for (unsigned t = 0; t < Indices.size() / 3; ++t) Draw(t);
+			return;
+		}
+
+		for (const auto m : visible) {
+			const auto& meshlet = Mesh->Meshlets.Meshlets[m];
+			for (auto i = meshlet.TriangleOffset; i < meshlet.TriangleOffset + meshlet.TriangleCount; ++i) {
+				Draw(Mesh->Meshlets.TriangleIds[i]);
+			}
+		}
+	};
+
+	// The depth pre-pass only projects positions, the shaders run in the shading pass unless they can move vertices.
+	if (IsDepthPrepass) {
+		FrameVector<Vec2F> projected(Vertices.size());
+		if (Mesh) {
+			VertexKernel::ProjectIndexed(Mesh->Streams, Transform, *C, vertexIds, projected);
+		}
+		else if (KeepsPositions()) {
+			for (unsigned i = 0; i < Vertices.size(); ++i) {
+				projected[i] = Camera::WorldToScreen(*C, Vertices[i], Transform);
 			}
+		}
+		else {
+			for (unsigned i = 0; i < Vertices.size(); ++i) {
+				auto vertex = Vertices[i];
+				VertexShader(vertex, Transform, *C);
+				projected[i] = Camera::WorldToScreen(*C, vertex, Transform);
+			}
+		}
+
+		forEachTriangle([&](const unsigned T) {
+			RasterizeDepth(C, projected[Indices[T * 3]], projected[Indices[T * 3 + 1]], projected[Indices[T * 3 + 2]]);
+		});
+		return;
+	}
+
+	// Shade and project every vertex once, the triangles sharing a vertex all reuse its results.
+	FrameVector<Vert> shaded(Vertices.size());
+	FrameVector<Vec2F> projected(Vertices.size());
+	const auto shade = [&](const unsigned I) {
+		shaded[I] = Vertices[I];
+		if (StaticLight) {
+			shaded[I].Light = (*StaticLight)[I];
+		}
+		else {
+			StaticLightShader(shaded[I], Transform);
+		}
+
+		VertexShader(shaded[I], Transform, *C);
+	};
 
-			// Update the depth of this pixel in the buffer.
-			engine->Depth[TwoD2OneD(x, y, engine->Width)] = lerpZ;
+	if (Mesh) {
+		for (const auto v : vertexIds) shade(v);
 
-			DrawPixel(col.Get(), Floor(p.X), Floor(p.Y));
+		// Positions are projected in one batch once every vertex shader has run.
+		VertexKernel::ProjectIndexed(Mesh->Streams, Transform, *C, vertexIds, projected);
+	}
+	else {
+		for (unsigned i = 0; i < Vertices.size(); ++i) {
+			shade(i);
+			projected[i] = Camera::WorldToScreen(*C, shaded[i], Transform);
 		}
 	}
+
+	forEachTriangle([&](const unsigned T) {
+		const auto a = Indices[T * 3];
+		const auto b = Indices[T * 3 + 1];
+		const auto c = Indices[T * 3 + 2];
+
+		RasterizeTriangle(C, shaded[a], shaded[b], shaded[c], projected[a], projected[b], projected[c], &Uv[T * 3]);
+	});
 }
 
-void RenderHelper::FillMesh(const Camera* C, Mat4& Transform, std::vector<Vert> Vertices,
-							const std::vector<unsigned>& Indices, const std::vector<Vec2F>& Uv) {
-	for (unsigned i = 0; i < Indices.size(); i += 3) {
-		std::vector<Vert> curTriangle;
-		curTriangle.emplace_back(Vertices[Indices[i]]);
-		curTriangle.emplace_back(Vertices[Indices[i + 1]]);
-		curTriangle.emplace_back(Vertices[Indices[i + 2]]);
+void RenderHelper::ResolveGBuffer() {
+	const auto engine = GEngine::Get();
 
-		std::vector<Vec2F> curUv;
-		curUv.emplace_back(Uv[i]);
-		curUv.emplace_back(Uv[i + 1]);
-		curUv.emplace_back(Uv[i + 2]);
+	// Hand out small bands of rows so threads that hit cheap rows pick up more work.
+	constexpr unsigned rowsPerBand = 16;
+	std::atomic<unsigned> nextRow{0};
+	const auto worker = [&nextRow, engine] {
+		for (auto row = nextRow.fetch_add(rowsPerBand); row < engine->Height; row = nextRow.fetch_add(rowsPerBand)) {
+			const auto lastRow = row + rowsPerBand < engine->Height ? row + rowsPerBand - 1 : engine->Height - 1;
+			ResolveRows(row, lastRow);
+		}
+	};
+
+	GetWorkers().Run(worker);
+
+	Materials.clear();
+}
+
+WorkerPool& RenderHelper::GetWorkers() {
+	// Started on first use and kept until the program exits, one thread per core counting the one rendering.
+	static const auto cores = std::thread::hardware_concurrency();
+	static WorkerPool workers(cores > 1 ? cores - 1 : 0);
+	return workers;
+}
+
+void RenderHelper::ResolveRows(const unsigned FirstRow, const unsigned LastRow) {
+	const auto engine = GEngine::Get();
+
+	for (unsigned y = FirstRow; y <= LastRow; ++y) {
+		for (unsigned x = 0; x < engine->Width; ++x) {
+			auto& texel = engine->GBuffer[TwoD2OneD(x, y, engine->Width)];
+			if (texel.Material == 0) continue;
+
+			const auto light = GBufferTexel::UnpackLight(texel.Light);
+			auto lc = Color((light.X + light.Y + light.Z) / 3.0f, light.X, light.Y, light.Z);
+			auto col = Color(texel.Albedo);
+			auto uv = Vec2F(texel.U, texel.V);
 
-		FillTriangle(C, Transform, curTriangle, curUv);
+			const auto* material = Materials[texel.Material - 1];
+			if (material) {
+				Texture::SetSampleFootprint(texel.UvFootprint);
+				material->PixelShader(lc, col, uv);
+			}
+
+			DrawPixel(col.Get(), x, y);
+
+			// Leave the texel empty for the next frame.
+			texel.Material = 0;
+		}
 	}
+
+	Texture::SetSampleFootprint(0.0f);
+}
+
+unsigned short RenderHelper::GetMaterialId(const Shader* Material) {
+	for (unsigned i = 0; i < Materials.size(); ++i) {
+		if (Materials[i] == Material) return (unsigned short)(i + 1);
+	}
+
+	Materials.emplace_back(Material);
+	return (unsigned short)Materials.size();
 }
 
 void RenderHelper::ClearBuffer() {
@@ -6,34 +6,166 @@ struct Camera;
 struct Vec2F;
 struct Mat4;
 struct Vec3F;
+class StaticMesh;
+
+/**
+ * \brief How meshes are shaded, switchable between frames through GEngine::CurrentRenderPath.
+ */
+enum class RenderPath {
+	// Pixel shaders run while rasterizing, once for every fragment passing the depth test.
+	Forward,
+	// Rasterizing only fills the G-buffer, pixel shaders run once per visible pixel in ResolveGBuffer.
+	Deferred,
+	// Meshes are rendered twice, first writing only depth from their positions, then shading with an equal depth test
+	// so only the nearest fragment of every pixel is shaded. Vertex shaders must not move vertices.
+	DepthPrepass
+};
 
 class RenderHelper {
 public:
 	static class Shader* CurrentShader;
 
+	// Set while the depth pre-pass renders, meshes only project their positions and write depth.
+	static bool IsDepthPrepass;
+
 	static void VertexShader(Vert& V, Mat4& T, const Camera& C);
 
+	static void StaticLightShader(Vert& V, const Mat4& T);
+
+	/**
+	 * \brief Checks whether the current shader leaves vertex positions alone, see Shader::VertexPositions.
+	 */
+	static bool KeepsPositions();
+
 	static void DrawDepth(const std::vector<float>& DepthBuffer);
 
 	static void DrawPixel(const unsigned& Pixel, const unsigned X, const unsigned Y);
 
+	/**
+	 * \brief Draws a line colored by running the current pixel shader once.
+	 */
 	static void DrawLine(const Vec2F& Start, const Vec2F& End);
 
+	/**
+	 * \brief Draws a single color line, clipped to the screen and stepped in fixed point straight through the
+	 * framebuffer.
+	 */
+	static void DrawLine(const Vec2F& Start, const Vec2F& End, unsigned LineColor);
+
+	/**
+	 * \brief Draws a line fading from StartColor to EndColor.
+	 */
+	static void DrawLine(const Vec2F& Start, const Vec2F& End, unsigned StartColor, unsigned EndColor);
+
+	/**
+	 * \brief Draws a line between two view space points, clipping it against the near plane before projecting.
+	 */
+	static void DrawLine(const Camera* C, Vec3F ViewStart, Vec3F ViewEnd, unsigned LineColor);
+
 	static void DrawWireCube(const Camera* C, Mat4& Transform, const float Scale, Shader RenderShader);
 
 	static void DrawWireTriangle(const Camera* C, Mat4& Transform, const std::vector<Vert>& Vertices);
 
-	static void DrawWireMesh(const Camera* C, Mat4& Transform, std::vector<Vert> Vertices, const std::vector<unsigned>
-							 & Indices);
+	/**
+	 * \brief Projects every vertex of the mesh once, then draws each edge once with the color of the current shader.
+	 * \param Edges Vertex index pairs of the unique edges of the mesh, see StaticMesh::Edges.
+	 */
+	static void DrawWireMesh(const Camera* C, Mat4& Transform, const std::vector<Vert>& Vertices, const std::vector<unsigned>
+							 & Edges);
 
 	static void DrawGrid(const Camera* Viewer, int WidthDivisions, int HeightDivisions, float GridWidth, float GridHeight,
 				  const uint32_t& Color = 0xFFFFFFFF);
 
 	static void FillTriangle(const Camera* C, Mat4& Transform, const std::vector<Vert>& Vertices, const std::vector<Vec2F>& Uv);
 
-	static void FillMesh(const Camera* C, Mat4& Transform, std::vector<Vert> Vertices, const std::vector<unsigned>
-						 & Indices, const std::vector<Vec2F>& Uv);
+	/**
+	 * \brief Shades and projects every vertex of the mesh once, then fills its triangles.
+	 * \param StaticLight Optional per vertex lighting cached from the current shaders static light shader, used in
+	 * place of running it again.
+	 */
+	static void FillMesh(const Camera* C, Mat4& Transform, const std::vector<Vert>& Vertices, const std::vector<unsigned>
+						 & Indices, const std::vector<Vec2F>& Uv, const std::vector<Vec3F>* StaticLight = nullptr);
+
+	/**
+	 * \brief Fills a static mesh, skipping meshlets outside the view or facing away and projecting the vertices of
+	 * the rest in batches from its vertex streams. Shaders that can move vertices draw every vertex and triangle the
+	 * way the other FillMesh does instead.
+	 */
+	static void FillMesh(const Camera* C, Mat4& Transform, const StaticMesh& Mesh,
+						 const std::vector<Vec3F>* StaticLight = nullptr);
+
+	/**
+	 * \brief Fills one static mesh many times. Instances go in groups of InstanceGroupSize: meshlets are culled per
+	 * instance, the vertices any instance of the group uses are projected for all of them in one batch, then each
+	 * instance lights and shades only the vertices of its own meshlets. Shaders that can move vertices skip the
+	 * culling and have each vertex projected after they ran.
+	 *
+	 * Static lighting is not cached per instance. Materials using Shader::RegistryStaticLight light every visible
+	 * instance each frame with the batched lighting kernel, others run their static light shader per shaded vertex.
+	 * Scratch memory is about 12 bytes per vertex for each instance of a group plus one vertex buffer, whatever the
+	 * instance count.
+	 * \param Transforms Model to world transform of every instance.
+	 * \param Colors Tint multiplied into the vertex colors of every instance before its shaders run.
+	 */
+	static void FillMeshInstanced(const Camera* C, const StaticMesh& Mesh, const Mat4* Transforms, const Color* Colors,
+								  unsigned Count);
+
+	// Most instances FillMeshInstanced projects at once.
+	static constexpr unsigned InstanceGroupSize = 64;
+
+	/**
+	 * \brief Runs the material of every pixel left in the G-buffer by deferred rendering and clears it for the next
+	 * frame. Rows are split between the threads of the worker pool.
+	 */
+	static void ResolveGBuffer();
 
 	/** Set all pixels to clear color. */
 	static void ClearBuffer();
+
+private:
+	/**
+	 * \brief Shared body of FillMesh. Given the static mesh it culls meshlets and projects with the vertex kernel.
+	 */
+	static void FillMeshShared(const Camera* C, Mat4& Transform, const std::vector<Vert>& Vertices,
+							   const std::vector<unsigned>& Indices, const std::vector<Vec2F>& Uv,
+							   const std::vector<Vec3F>* StaticLight, const StaticMesh* Mesh);
+
+	/**
+	 * \brief Runs the current pixel shader with the inputs lines are shaded with.
+	 * \return Color of the line, white without a current shader.
+	 */
+	static unsigned ShadeLineColor();
+
+	/**
+	 * \brief Writes a pixel into the framebuffer, alpha blending it unless it is opaque.
+	 */
+	static void WritePixel(unsigned& Target, unsigned Pixel);
+
+	// Materials drawn into the G-buffer this frame, a texels material id is its index here plus one.
+	static std::vector<const Shader*> Materials;
+
+	static unsigned short GetMaterialId(const Shader* Material);
+
+	static void ResolveRows(unsigned FirstRow, unsigned LastRow);
+
+	/**
+	 * \brief Gets the worker threads shared by every frame, started the first time they are needed.
+	 */
+	static class WorkerPool& GetWorkers();
+
+	/**
+	 * \brief Writes the depth of a screen space triangle without shading it, 2x2 pixels at a time.
+	 */
+	static void RasterizeDepth(const Camera* C, const Vec2F& V0, const Vec2F& V1, const Vec2F& V2);
+
+	/**
+	 * \brief Fills a triangle whose vertices have already been shaded and projected to screen space. Coverage, depth and
+	 * texture coordinates are found for 2x2 pixel quads at once, the differences across a quad pick the mip level of
+	 * the textures its pixels sample.
+	 * \param P1 Shaded vertex of the first corner.
+	 * \param V0 Screen space position and depth of the first corner.
+	 * \param Uv The three texture coordinates of the triangle.
+	 */
+	static void RasterizeTriangle(const Camera* C, const Vert& P1, const Vert& P2, const Vert& P3, const Vec2F& V0,
+								  const Vec2F& V1, const Vec2F& V2, const Vec2F* Uv);
 };
@@ -1,4 +1,29 @@
 #include "Shader.h"
 Shader::Shader(std::function<void(Color& V, Color& C, Vec2F& Uv)> PixelShader,
-			   std::function<void(Vert&, Mat4& T, const Camera& C)> VertexShader): PixelShader(std::move(PixelShader)), VertexShader(
-																					   std::move(VertexShader)) {}
+			   std::function<void(Vert&, Mat4& T, const Camera& C)> VertexShader,
+			   const VertexPositions Positions): PixelShader(std::move(PixelShader)),
+												 VertexShader(std::move(VertexShader)),
+												 Positions(Positions) {}
+
+Shader::Shader(std::function<void(Color& V, Color& C, Vec2F& Uv)> PixelShader,
+			   std::function<void(Vert&, Mat4& T, const Camera& C)> VertexShader,
+			   std::function<void(Vert&, const Mat4& T)> StaticLightShader,
+			   const VertexPositions Positions): PixelShader(std::move(PixelShader)),
+												 VertexShader(std::move(VertexShader)),
+												 StaticLightShader(std::move(StaticLightShader)),
+												 Positions(Positions) {}
+
+void Shader::RegistryStaticLight(Vert& V, const Mat4& T) {
+	// Calculate the ambient and static lighting of the scene.
+	Vec3F worldPos, worldNormal;
+	GetWorldSpace(V, T, worldPos, worldNormal);
+
+	V.Light = GEngine::Get()->Lights.EvaluateStatic(worldPos, worldNormal, V.C);
+}
+
+bool Shader::HasRegistryStaticLight() const {
+	using StaticLightFunction = void(*)(Vert&, const Mat4&);
+
+	const auto* target = StaticLightShader.target<StaticLightFunction>();
+	return target && *target == &RegistryStaticLight;
+}
@@ -4,27 +4,76 @@
 
 #include "EngineDefines.h"
 #include "GEngine.h"
-#include "celestial.h"
-#include "StoneHenge_Texture.h"
+#include "Texture.h"
 
 class Shader
 {
 public:
+	/**
+	 * \brief Whether the vertex shader can change where vertices end up on screen.
+	 */
+	enum class VertexPositions {
+		// The vertex shader may write Vert::Pos or the transform. Every vertex is projected after its shader runs and
+		// static meshes skip meshlet culling, whose bounds would no longer hold.
+		Modified,
+		// The vertex shader leaves Vert::Pos and the transform alone. Static meshes cull meshlets and project their
+		// vertex streams in batches without waiting for the shader.
+		Unchanged
+	};
+
+	Shader(std::function<void(Color&, Color&, Vec2F&)> PixelShader, std::function<void(Vert&, Mat4&, const Camera&)>
+		   VertexShader, VertexPositions Positions = VertexPositions::Modified);
+
 	Shader(std::function<void(Color&, Color&, Vec2F&)> PixelShader, std::function<void(Vert&, Mat4&, const Camera&)>
-		   VertexShader);
+		   VertexShader, std::function<void(Vert&, const Mat4&)> StaticLightShader,
+		   VertexPositions Positions = VertexPositions::Modified);
 
 	// Shaders are bound by lambda functions and must match the arguments of this function pointer.
 	std::function<void(Color&, Color&, Vec2F&)> PixelShader;
 	std::function<void(Vert&, Mat4&, const Camera&)> VertexShader;
 
+	// Optional stage writing the lighting that does not change from frame to frame into Vert::Light. Static meshes
+	// cache its results per vertex, so the vertex shader only has to add the animated lighting on top.
+	std::function<void(Vert&, const Mat4&)> StaticLightShader;
+
+	VertexPositions Positions;
+
+	/**
+	 * \brief Static light stage that lights a vertex with the ambient and static lights of the scene. Static light
+	 * caches recognize it and light whole meshes with the batched lighting kernel instead of calling it per vertex.
+	 */
+	static void RegistryStaticLight(Vert& V, const Mat4& T);
+
+	/**
+	 * \brief Checks whether StaticLightShader is RegistryStaticLight.
+	 */
+	bool HasRegistryStaticLight() const;
+
 	static float GetLightRatio(const Vec3F& LightDirection, const Vec3F& SurfaceNormal) {
 		return Clamp(Vec3F::DotProduct(LightDirection, SurfaceNormal), 0.0f, 1.0f);
 	}
+
+	/**
+	 * \brief Transforms the position and normal of a vertex into world space for lighting.
+	 * \param V Vertex in model space.
+	 * \param T World transform of the vertex.
+	 * \param Pos Receives the world position.
+	 * \param Normal Receives the normalized world normal.
+	 */
+	static void GetWorldSpace(const Vert& V, const Mat4& T, Vec3F& Pos, Vec3F& Normal) {
+		Pos = T.Project(V.Pos);
+
+		// Directions ignore the translation of the transform.
+		auto norm = V.Norm;
+		norm.W = 0.0f;
+		Normal = T.Project(norm);
+		if (Normal.Length() > 0.0f) Vec3F::Normalize(Normal);
+	}
 };
 
-const Shader DEFAULT_SHADER{[](Color& V, Color& C, Vec2F& Uv){ C = Color(Color::Green); }, [](Vert& V, Mat4& T, const Camera& C) {}};
+const Shader DEFAULT_SHADER{[](Color& V, Color& C, Vec2F& Uv){ C = Color(Color::Green); }, [](Vert& V, Mat4& T, const Camera& C) {}, Shader::VertexPositions::Unchanged};
 
-const Shader INVISIBLE_SHADER{ [](Color& V, Color& C, Vec2F& Uv) { C = Color(0, 0, 0, 0); }, [](Vert& V, Mat4& T, const Camera& C) {} };
+const Shader INVISIBLE_SHADER{ [](Color& V, Color& C, Vec2F& Uv) { C = Color(0, 0, 0, 0); }, [](Vert& V, Mat4& T, const Camera& C) {}, Shader::VertexPositions::Unchanged };
 
 
 const Shader MASTER_SHADER{[](Color& V, Color& C, Vec2F& Uv) {
@@ -36,14 +85,12 @@ const Shader MASTER_SHADER{[](Color& V, Color& C, Vec2F& Uv) {
 	// Get engine access for the shader.
 	const auto delta = GEngine::Get()->DeltaTime;
 	const auto elapsed = GEngine::Get()->ElapsedTime;
-}};
+}, Shader::VertexPositions::Unchanged};
 
 
 const Shader CUBE_SHADER{ [](Color& V, Color& C, Vec2F& Uv) {
 	// Get the color at the intended pixel of the texture.
-	const Vec2F pixel = { Uv.X * celestial_width, Uv.Y * celestial_height };
-
-	C = Color(BGRA_TO_ARGB(celestial_pixels[TwoD2OneD(pixel.X, pixel.Y, celestial_width)]));
+	C = Color(CELESTIAL_TEXTURE.Sample(Uv));
 
 	/*srand(time(NULL));
 	C.R *= Clamp((std::rand() % 255 + 1) / 255.0f, 0.5f, 1.0f);
@@ -73,13 +120,7 @@ const Shader CUBE_SHADER{ [](Color& V, Color& C, Vec2F& Uv) {
 const Shader STONEHENGE_SHADER { [](Color& V, Color& C, Vec2F& Uv) {
 	MASTER_SHADER.PixelShader(V, C, Uv);
 
-	unsigned texWidth = StoneHenge_width;
-	unsigned texHeight = StoneHenge_height;
-	unsigned texSize = StoneHenge_width*StoneHenge_height;
-
-	const Vec2F pixel = { Uv.X * texWidth, Uv.Y * texHeight };
-
-	auto t = Color(BGRA_TO_ARGB(StoneHenge_pixels[TwoD2OneD(pixel.X, pixel.Y, StoneHenge_width)]));
+	auto t = Color(STONEHENGE_TEXTURE.Sample(Uv));
 
 	/*double u = Uv.X * texSize - 0.5f;
 	double v = Uv.Y * texSize - 0.5f;
@@ -115,48 +156,16 @@ const Shader STONEHENGE_SHADER { [](Color& V, Color& C, Vec2F& Uv) {
 	}, [](Vert& V, Mat4& T, const Camera& C) {
 	MASTER_SHADER.VertexShader(V, T, C);
 
-	const auto time = GEngine::Get()->ElapsedTime;
-	const auto delta = GEngine::Get()->DeltaTime;
-
-	const auto sinTime = sin(time);
-
-
-	// Calculate directional lighting.
-	const auto directionalLightVec = Vec3F(-0.577f, -0.577f, 0.577f);
-	const auto directionalLightColor = Color(0xFFC0C0F0);
-	constexpr auto directionalLightIntensity = 0.25f;
-
-	const auto directionalLightRatio = Shader::GetLightRatio(directionalLightVec * -1.0f, V.Norm);
+	// Evaluate the dynamic lights of this vertices cluster, the static and ambient lighting is already in V.Light.
+	Vec3F worldPos, worldNormal;
+	Shader::GetWorldSpace(V, T, worldPos, worldNormal);
 
-	const auto directionalResult = directionalLightColor * directionalLightIntensity * V.C * directionalLightRatio;
-
-
-	// Calculate a single point light with a point in space.
-	const auto pointLightPos = Vec3F(5.0f, 3.0f, 0.5f);
-	const auto pointLightColor = Color(0xFFFF0000);
-	constexpr auto pointLightIntensity = 150.0f;
-	constexpr auto pointLightRadius = 150.0f;
-
-	
-	auto pointLightDir = pointLightPos - V.Pos;
-	auto pointLightAttenuation = 1.0f - Clamp(Vec3F::Magnitude(pointLightDir) / pointLightRadius);
-	Vec3F::Normalize(pointLightDir);
-
-	const auto pointLightRatio = Clamp(Vec3F::DotProduct(pointLightDir, V.Norm));
-	auto pointLightResult = pointLightColor * pointLightIntensity * V.C * pointLightRatio;
-	pointLightResult *= pointLightAttenuation*pointLightAttenuation;
-	pointLightResult *= sinTime;
+	const auto dynamicLight = GEngine::Get()->Lights.EvaluateDynamic(worldPos, worldNormal, V.C);
 
 
 	// Calculate the surfaces lighting color.
-	auto result = directionalResult + pointLightResult;
-
-
-	// Apply ambient lighting
-	const auto ambientLight = Color(0xaaaaaaaa);
-	constexpr auto ambientLightIntensity = 0.05f;
-
-	result += ambientLight * ambientLightIntensity;
+	auto result = Color(255.0f, V.Light.X * 255.0f, V.Light.Y * 255.0f, V.Light.Z * 255.0f);
+	result += Color(255.0f, dynamicLight.X * 255.0f, dynamicLight.Y * 255.0f, dynamicLight.Z * 255.0f);
 
 
 	// Clamp the final light color.
@@ -166,5 +175,5 @@ const Shader STONEHENGE_SHADER { [](Color& V, Color& C, Vec2F& Uv) {
 
 	V.Light = {result.R, result.G, result.B};
 
-	}
+	}, Shader::RegistryStaticLight, Shader::VertexPositions::Unchanged
 };
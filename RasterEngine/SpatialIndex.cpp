@@ -0,0 +1,216 @@
+#include "SpatialIndex.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "BaseObject.h"
+
+constexpr unsigned SpatialIndex::InvalidSlot;
+constexpr unsigned SpatialIndex::NoItem;
+
+SpatialIndex::SpatialIndex(): IsDirty(false) {}
+
+void SpatialIndex::Insert(BaseObject* const Object) {
+	Object->SpatialSlot = (unsigned)Objects.size();
+	Objects.emplace_back(Object);
+	Locations.push_back({nullptr, (unsigned)Pending.size()});
+	Pending.emplace_back(Object);
+}
+
+void SpatialIndex::Remove(BaseObject* const Object) {
+	const auto slot = Object->SpatialSlot;
+	if (slot >= Objects.size() || Objects[slot] != Object) return;
+
+	const auto location = Locations[slot];
+	if (location.Owner) {
+		location.Owner->Objects[location.Item] = nullptr;
+		location.Owner->Bounds[location.Item] = {};
+		location.Owner->RemovedCount++;
+	}
+	else if (location.Item != NoItem) {
+		Pending[location.Item] = Pending.back();
+		Locations[Pending[location.Item]->SpatialSlot].Item = location.Item;
+		Pending.pop_back();
+	}
+
+	// The last object moves into the slot, the only one whose slot changes.
+	Objects[slot] = Objects.back();
+	Locations[slot] = Locations.back();
+	Objects[slot]->SpatialSlot = slot;
+	Objects.pop_back();
+	Locations.pop_back();
+	Object->SpatialSlot = InvalidSlot;
+}
+
+void SpatialIndex::Clear() {
+	for (const auto object : Objects) object->SpatialSlot = InvalidSlot;
+
+	Objects.clear();
+	Locations.clear();
+	Pending.clear();
+	StaticTree = {};
+	DynamicTree = {};
+	IsDirty = false;
+}
+
+void SpatialIndex::Invalidate() {
+	IsDirty = true;
+}
+
+void SpatialIndex::Build(Tree& T) {
+	unsigned count = 0;
+	for (unsigned i = 0; i < T.Objects.size(); ++i) {
+		const auto object = T.Objects[i];
+		if (!object) continue;
+
+		T.Objects[count] = object;
+		T.Bounds[count] = T.Bounds[i];
+		Locations[object->SpatialSlot].Item = count++;
+	}
+
+	T.Objects.resize(count);
+	T.Bounds.resize(count);
+	T.RemovedCount = 0;
+
+	T.Hierarchy.Build(T.Bounds);
+	T.BuiltArea = T.Hierarchy.Nodes.empty() ? 0.0f : T.Hierarchy.Nodes[0].Bounds.GetSurfaceArea();
+}
+
+void SpatialIndex::InsertItems(Tree& T, const unsigned First) {
+	const auto count = (unsigned)T.Objects.size();
+	if (count == First) return;
+
+	// Inserting one at a time gives a worse tree than the surface area heuristic, which pays off for a batch as big as
+	// the tree, like the objects of a new level.
+	if (count - First >= First) {
+		Build(T);
+		return;
+	}
+
+	for (auto i = First; i < count; ++i) {
+		if (T.Hierarchy.Insert(i, T.Bounds[i])) continue;
+
+		Build(T);
+		return;
+	}
+}
+
+void SpatialIndex::Update() {
+	if (IsDirty) {
+		StaticTree = {};
+		DynamicTree = {};
+		Pending.clear();
+
+		for (unsigned i = 0; i < Objects.size(); ++i) {
+			const auto object = Objects[i];
+			Locations[i] = {nullptr, NoItem};
+
+			Aabb bounds;
+			if (!object->GetWorldBounds(bounds)) continue;
+
+			auto& tree = object->IsStatic ? StaticTree : DynamicTree;
+			Locations[i] = {&tree, (unsigned)tree.Objects.size()};
+			tree.Objects.emplace_back(object);
+			tree.Bounds.emplace_back(bounds);
+		}
+
+		Build(StaticTree);
+		Build(DynamicTree);
+		IsDirty = false;
+		return;
+	}
+
+	if (!Pending.empty()) {
+		const auto staticCount = (unsigned)StaticTree.Objects.size();
+		const auto dynamicCount = (unsigned)DynamicTree.Objects.size();
+
+		for (const auto object : Pending) {
+			auto& location = Locations[object->SpatialSlot];
+			location = {nullptr, NoItem};
+
+			Aabb bounds;
+			if (!object->GetWorldBounds(bounds)) continue;
+
+			auto& tree = object->IsStatic ? StaticTree : DynamicTree;
+			location = {&tree, (unsigned)tree.Objects.size()};
+			tree.Objects.emplace_back(object);
+			tree.Bounds.emplace_back(bounds);
+		}
+		Pending.clear();
+
+		InsertItems(StaticTree, staticCount);
+		InsertItems(DynamicTree, dynamicCount);
+	}
+
+	for (auto* tree : {&StaticTree, &DynamicTree}) {
+		if ((float)tree->RemovedCount > (float)tree->Objects.size() * MaxRemovedShare) Build(*tree);
+	}
+
+	if (DynamicTree.Objects.empty()) return;
+
+	for (unsigned i = 0; i < DynamicTree.Objects.size(); ++i) {
+		if (DynamicTree.Objects[i]) DynamicTree.Objects[i]->GetWorldBounds(DynamicTree.Bounds[i]);
+	}
+
+	// Refitting keeps the tree shape, so once objects have spread far from where it was built start over.
+	DynamicTree.Hierarchy.Refit(DynamicTree.Bounds);
+	if (DynamicTree.Hierarchy.Nodes[0].Bounds.GetSurfaceArea() > DynamicTree.BuiltArea * MaxRefitGrowth) {
+		Build(DynamicTree);
+	}
+}
+
+void SpatialIndex::QueryFrustum(const Frustum& F, std::vector<BaseObject*>& Results) const {
+	Query([&F](const Aabb& Bounds) { return F.Intersects(Bounds); }, Results);
+}
+
+void SpatialIndex::QuerySphere(const Vec3F& Center, const float Radius, std::vector<BaseObject*>& Results) const {
+	Query([&](const Aabb& Bounds) { return Bounds.Intersects(Center, Radius); }, Results);
+}
+
+void SpatialIndex::QueryBox(const Aabb& Box, std::vector<BaseObject*>& Results) const {
+	Query([&Box](const Aabb& Bounds) { return Bounds.Intersects(Box); }, Results);
+}
+
+bool SpatialIndex::Raycast(const Vec3F& Origin, const Vec3F& Direction, RayHit& Hit) const {
+	const Vec3F inverseDirection = {1.0f / Direction.X, 1.0f / Direction.Y, 1.0f / Direction.Z};
+
+	auto isHit = false;
+	for (const auto* tree : {&StaticTree, &DynamicTree}) {
+		tree->Hierarchy.TraverseRay(Origin, inverseDirection, Hit.Distance, [&](const unsigned NodeIndex) {
+			const auto& node = tree->Hierarchy.Nodes[NodeIndex];
+			for (auto i = node.First; i < node.First + node.Count; ++i) {
+				const auto item = tree->Hierarchy.Items[i];
+				if (!tree->Objects[item]) continue;
+
+				float distance;
+				if (!tree->Bounds[item].IntersectsRay(Origin, inverseDirection, Hit.Distance, distance)) continue;
+				if (tree->Objects[item]->Raycast(Origin, Direction, Hit)) isHit = true;
+			}
+		});
+	}
+
+	return isHit;
+}
+
+void SpatialIndex::QueryRay(const Vec3F& Origin, const Vec3F& Direction, const float MaxDistance,
+							std::vector<BaseObject*>& Results) const {
+	const Vec3F inverseDirection = {1.0f / Direction.X, 1.0f / Direction.Y, 1.0f / Direction.Z};
+
+	using Hit = std::pair<float, BaseObject*>;
+	std::vector<Hit> hits;
+	for (const auto* tree : {&StaticTree, &DynamicTree}) {
+		float distance;
+		const auto test = [&](const Aabb& Bounds) {
+			return Bounds.IntersectsRay(Origin, inverseDirection, MaxDistance, distance);
+		};
+
+		tree->Hierarchy.Traverse(test, [&](const unsigned I) {
+			if (tree->Objects[I] && test(tree->Bounds[I])) hits.emplace_back(distance, tree->Objects[I]);
+		});
+	}
+
+	std::sort(hits.begin(), hits.end(), [](const Hit& A, const Hit& B) { return A.first < B.first; });
+
+	Results.clear();
+	for (const auto& hit : hits) Results.emplace_back(hit.second);
+}
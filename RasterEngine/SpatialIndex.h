@@ -0,0 +1,148 @@
+#pragma once
+#include <vector>
+
+#include "Bvh.h"
+#include "EngineDefines.h"
+#include "TriangleTree.h"
+
+class BaseObject;
+
+/**
+ * \brief Spatial index over the world bounds of spawned objects. Static objects live in a tree built with the surface
+ * area heuristic, moving objects in a second tree that is refitted every update and only rebuilt once refitting has
+ * let it grow loose. Spawned objects are inserted into the tree for their kind and despawned ones are cut out of it
+ * in place, so neither rebuilds anything unless a tree doubles in size or is mostly removed objects. Objects without
+ * bounds are never returned.
+ */
+class SpatialIndex
+{
+public:
+	SpatialIndex();
+
+	// How many times its built surface area the root of the moving tree may grow to before it is rebuilt.
+	static constexpr float MaxRefitGrowth = 2.0f;
+
+	// Share of the items of a tree that may belong to removed objects before it is rebuilt without them.
+	static constexpr float MaxRemovedShare = 0.5f;
+
+	// Slot of objects not in the index.
+	static constexpr unsigned InvalidSlot = ~0u;
+
+	/**
+	 * \brief Adds an object, which joins a tree on the next update once its components have given it bounds.
+	 */
+	void Insert(BaseObject* Object);
+
+	/**
+	 * \brief Removes an object, found through its SpatialSlot without searching.
+	 */
+	void Remove(BaseObject* Object);
+	void Clear();
+
+	/**
+	 * \brief Rebuilds both trees on the next update. Call after moving a static object, changing whether an object is
+	 * static or changing its components.
+	 */
+	void Invalidate();
+
+	/**
+	 * \brief Brings the trees up to date with the objects, called by the engine every frame after objects update.
+	 * Inserts the objects added since the last update and refits the moving tree.
+	 */
+	void Update();
+
+	/**
+	 * \brief Finds the objects whose bounds overlap the view volume.
+	 * \param Results Cleared, then filled with the objects found.
+	 */
+	void QueryFrustum(const Frustum& F, std::vector<BaseObject*>& Results) const;
+
+	/**
+	 * \brief Finds the objects whose bounds overlap a sphere.
+	 * \param Results Cleared, then filled with the objects found.
+	 */
+	void QuerySphere(const Vec3F& Center, float Radius, std::vector<BaseObject*>& Results) const;
+
+	/**
+	 * \brief Finds the objects whose bounds overlap a box.
+	 * \param Results Cleared, then filled with the objects found.
+	 */
+	void QueryBox(const Aabb& Box, std::vector<BaseObject*>& Results) const;
+
+	/**
+	 * \brief Finds the objects whose bounds a ray passes through.
+	 * \param Direction Direction of the ray, distances are measured in multiples of its length.
+	 * \param Results Cleared, then filled with the objects found ordered by where the ray enters their bounds.
+	 */
+	void QueryRay(const Vec3F& Origin, const Vec3F& Direction, float MaxDistance,
+				  std::vector<BaseObject*>& Results) const;
+
+	/**
+	 * \brief Finds the closest triangle of any object a ray hits, visiting objects in the order the ray reaches them
+	 * and skipping those whose bounds start past the closest hit so far.
+	 * \param Direction Direction of the ray, distances are measured in multiples of its length.
+	 * \param Hit Limits the query to Hit.Distance and receives the closest hit nearer than that.
+	 * \return True if Hit was updated.
+	 */
+	bool Raycast(const Vec3F& Origin, const Vec3F& Direction, RayHit& Hit) const;
+
+private:
+	// Item of objects that are in no tree and not waiting for one.
+	static constexpr unsigned NoItem = ~0u;
+
+	struct Tree {
+		Bvh Hierarchy;
+
+		// Removed objects leave a nullptr and empty bounds behind until the tree is next built.
+		std::vector<BaseObject*> Objects;
+		std::vector<Aabb> Bounds;
+
+		// Surface area of the root when the tree was last built.
+		float BuiltArea = 0.0f;
+
+		unsigned RemovedCount = 0;
+	};
+
+	// Where an object is, Item indexes the objects of Owner or Pending when Owner is nullptr.
+	struct Location {
+		Tree* Owner;
+		unsigned Item;
+	};
+
+	// Every object with its location, by the slot stored on the object.
+	std::vector<BaseObject*> Objects;
+	std::vector<Location> Locations;
+
+	// Objects inserted since the last update.
+	std::vector<BaseObject*> Pending;
+
+	Tree StaticTree;
+	Tree DynamicTree;
+
+	bool IsDirty;
+
+	/**
+	 * \brief Builds a tree from scratch, dropping the items of removed objects.
+	 */
+	void Build(Tree& T);
+
+	/**
+	 * \brief Adds the items from First on to the tree, building it again instead if they at least double it.
+	 */
+	void InsertItems(Tree& T, unsigned First);
+
+	/**
+	 * \brief Collects the objects of both trees whose bounds pass a test.
+	 * \param Test Takes the bounds of a node or object and returns whether they overlap the query.
+	 */
+	template<typename BoundsTest>
+	void Query(const BoundsTest& Test, std::vector<BaseObject*>& Results) const {
+		Results.clear();
+
+		for (const auto* tree : {&StaticTree, &DynamicTree}) {
+			tree->Hierarchy.Traverse(Test, [&](const unsigned I) {
+				if (tree->Objects[I] && Test(tree->Bounds[I])) Results.emplace_back(tree->Objects[I]);
+			});
+		}
+	}
+};
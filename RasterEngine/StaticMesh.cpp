@@ -1,9 +1,120 @@
 #include "StaticMesh.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <utility>
 #include "EngineDefines.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
 
 StaticMesh::StaticMesh(std::vector<Vert> Vertices, std::vector<unsigned> Indices, std::vector<Vec2F> Uv):
 	Vertices(std::move(Vertices)),
 	Indices(std::move(Indices)),
-	Uv(std::move(Uv)) {}
+	Uv(std::move(Uv)),
+	LodError(0.0f) {
+	Rebuild();
+}
+
+void StaticMesh::Rebuild() {
+	BuildEdges();
+	Streams = VertexStreams::Build(Vertices, Uv);
+	Meshlets = MeshletList::Build(Vertices, Indices);
+	Triangles.Build(Vertices, Indices);
+
+	BoundsMin = BoundsMax = Vertices.empty() ? Vec3F() : Vertices[0].Pos;
+	for (const auto& v : Vertices) {
+		BoundsMin = {Min(BoundsMin.X, v.Pos.X), Min(BoundsMin.Y, v.Pos.Y), Min(BoundsMin.Z, v.Pos.Z)};
+		BoundsMax = {Max(BoundsMax.X, v.Pos.X), Max(BoundsMax.Y, v.Pos.Y), Max(BoundsMax.Z, v.Pos.Z)};
+	}
+}
+
+void StaticMesh::BuildLods(const unsigned MaxLevels, const unsigned MinTriangles) {
+	Lods.clear();
+
+	auto triangles = (unsigned)(Indices.size() / 3);
+	for (unsigned level = 0; level < MaxLevels; ++level) {
+		const auto target = triangles / 2;
+		if (target < MinTriangles) break;
+
+		// Simplify from the source every level so the error is measured against it.
+		auto vertices = Vertices;
+		auto indices = Indices;
+		auto uv = Uv;
+		const auto error = MeshSimplifier::Simplify(vertices, indices, uv, target);
+
+		// Stop once the simplifier runs out of collapses that keep the shape.
+		const auto simplifiedTriangles = (unsigned)(indices.size() / 3);
+		if (simplifiedTriangles > triangles * 9 / 10) break;
+
+		MeshOptimizer::Optimize(vertices, indices, uv);
+
+		auto lod = std::make_shared<StaticMesh>(std::move(vertices), std::move(indices), std::move(uv));
+		lod->LodError = error;
+		Lods.emplace_back(std::move(lod));
+
+		triangles = simplifiedTriangles;
+	}
+}
+
+const StaticMesh& StaticMesh::GetLod(const unsigned Level) const {
+	if (Level == 0 || Lods.empty()) return *this;
+
+	return *Lods[Level - 1 < Lods.size() ? Level - 1 : Lods.size() - 1];
+}
+
+unsigned StaticMesh::SelectLod(Mat4& Transform, const Camera& C, const float PixelError) const {
+	if (Lods.empty()) return 0;
+
+	// Errors grow with the largest scale of the transform.
+	const auto scaleX = Vec3F(Transform[0], Transform[1], Transform[2]).Length();
+	const auto scaleY = Vec3F(Transform[4], Transform[5], Transform[6]).Length();
+	const auto scaleZ = Vec3F(Transform[8], Transform[9], Transform[10]).Length();
+	const auto scale = Max(scaleX, Max(scaleY, scaleZ));
+
+	// Measure from the nearest point of the bounding sphere so large meshes do not drop detail up close.
+	const auto center = (BoundsMin + BoundsMax) * 0.5f;
+	const auto radius = (BoundsMax - center).Length() * scale;
+	const auto viewCenter = (Transform * C.GetViewMatrix()).Project(center);
+	const auto depth = viewCenter.Z - radius;
+	if (depth <= C.NearPlane) return 0;
+
+	const auto pixelsPerUnit = C.GetPixelsPerUnit(depth) * scale;
+
+	unsigned level = 0;
+	for (unsigned i = 0; i < Lods.size(); ++i) {
+		if (Lods[i]->LodError * pixelsPerUnit > PixelError) break;
+		level = i + 1;
+	}
+
+	return level;
+}
+
+void StaticMesh::BuildEdges() {
+	Edges.clear();
+	if (Indices.size() < 3) return;
+
+	// Vertices that only differ by normal or uv share their edges.
+	const auto welded = MeshOptimizer::WeldPositions(Vertices);
+
+	// Key every edge by its welded end points, lowest first, so both windings of a shared edge match.
+	std::vector<uint64_t> keys;
+	keys.reserve(Indices.size());
+	for (size_t i = 0; i + 2 < Indices.size(); i += 3) {
+		for (unsigned e = 0; e < 3; ++e) {
+			const auto a = welded[Indices[i + e]];
+			const auto b = welded[Indices[i + (e + 1) % 3]];
+			if (a == b) continue;
+
+			keys.emplace_back(a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a);
+		}
+	}
+
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+	Edges.reserve(keys.size() * 2);
+	for (const auto key : keys) {
+		Edges.emplace_back((unsigned)(key >> 32));
+		Edges.emplace_back((unsigned)(key & 0xFFFFFFFF));
+	}
+}
@@ -1,7 +1,12 @@
 #pragma once
+#include <memory>
 #include <vector>
-struct Vert;
-struct Vec2F;
+
+#include "Meshlet.h"
+#include "TriangleTree.h"
+#include "VertexStreams.h"
+
+struct Camera;
 
 class StaticMesh
 {
@@ -11,5 +16,56 @@ public:
 	std::vector<Vert> Vertices;
 	std::vector<unsigned> Indices;
 	std::vector<Vec2F> Uv;
-};
 
+	// Vertex index pairs of every unique triangle edge, used to draw wireframes. Vertices sharing a position share
+	// their edges so seams in the uv layout are only drawn once.
+	std::vector<unsigned> Edges;
+
+	// Structure of arrays copy of the positions, normals and colors of Vertices and of Uv for the batched projection
+	// and lighting kernels.
+	VertexStreams Streams;
+
+	// Clusters of about 64 triangles, culled before their vertices are shaded.
+	MeshletList Meshlets;
+
+	// Hierarchy over the triangles for ray queries.
+	TriangleTree Triangles;
+
+	// Model space bounding box of the vertices.
+	Vec3F BoundsMin, BoundsMax;
+
+	// Simplified versions of this mesh, each with about half the triangles of the one before it.
+	std::vector<std::shared_ptr<const StaticMesh>> Lods;
+
+	// Largest distance in model space this mesh strays from the mesh it was simplified from, 0 for source meshes.
+	float LodError;
+
+	/**
+	 * \brief Rebuilds the edge list, vertex streams, meshlets, triangle tree and bounds, call after changing Vertices,
+	 * Indices or Uv.
+	 */
+	void Rebuild();
+
+	/**
+	 * \brief Builds the LOD chain by simplifying this mesh, halving the triangles every level.
+	 * \param MaxLevels Most LODs to build, not counting this mesh.
+	 * \param MinTriangles Stops before a LOD would have fewer triangles than this.
+	 */
+	void BuildLods(unsigned MaxLevels = 4, unsigned MinTriangles = 64);
+
+	/**
+	 * \brief Gets the mesh of a detail level, clamped to the coarsest one.
+	 * \param Level 0 for this mesh, 1 for the first LOD and so on.
+	 */
+	const StaticMesh& GetLod(unsigned Level) const;
+
+	/**
+	 * \brief Picks the coarsest LOD whose error projects to no more than PixelError pixels on the screen of a camera.
+	 * \param Transform Model to world transform the mesh is drawn with.
+	 * \return Detail level to render, 0 for the full mesh.
+	 */
+	unsigned SelectLod(Mat4& Transform, const Camera& C, float PixelError) const;
+
+private:
+	void BuildEdges();
+};
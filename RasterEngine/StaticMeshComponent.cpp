@@ -3,19 +3,28 @@
 #include "GEngine.h"
 #include "BaseObject.h"
 
-StaticMeshComponent::StaticMeshComponent(StaticMesh Mesh):
+StaticMeshComponent::StaticMeshComponent(MeshHandle Mesh):
 	Sm(std::move(Mesh)),
-	Material(DEFAULT_SHADER) {}
+	Material(DEFAULT_SHADER),
+	RenderWire(false),
+	IsOccluder(false),
+	LodPixelError(1.0f) {}
 
-StaticMeshComponent::StaticMeshComponent(BaseObject* const Parent, StaticMesh Mesh): Component(Parent),
+StaticMeshComponent::StaticMeshComponent(BaseObject* const Parent, MeshHandle Mesh): Component(Parent),
 																					 Sm(std::move(Mesh)),
-																					 Material(DEFAULT_SHADER) {}
+																					 Material(DEFAULT_SHADER),
+																					 RenderWire(false),
+																					 IsOccluder(false),
+																					 LodPixelError(1.0f) {}
 
-StaticMeshComponent::StaticMeshComponent(BaseObject* const Parent, StaticMesh Mesh, Mat4 WorldTransform):
+StaticMeshComponent::StaticMeshComponent(BaseObject* const Parent, MeshHandle Mesh, Mat4 RelativeTransform):
 	Component(Parent),
 	Sm(std::move(Mesh)),
-	WorldTransform(std::move(WorldTransform)),
-	Material(DEFAULT_SHADER) {}
+	RelativeTransform(std::move(RelativeTransform)),
+	Material(DEFAULT_SHADER),
+	RenderWire(false),
+	IsOccluder(false),
+	LodPixelError(1.0f) {}
 
 void StaticMeshComponent::Start() {
 	
@@ -26,17 +35,106 @@ void StaticMeshComponent::Update() {
 }
 
 void StaticMeshComponent::Render() {
-	RenderHelper::CurrentShader = &Material;
+	if (!Sm) return;
+
+	auto* engine = GEngine::Get();
+
+	auto transform = GetWorldTransform();
+	if (!IsOccluder && !engine->Occlusion.IsVisible(transform, Sm->BoundsMin, Sm->BoundsMax)) return;
+
+	const auto level = SelectLod(transform);
+
+	RenderCommand command;
+	command.Material = &Material;
+	command.Transform = transform;
+	command.Mesh = &Sm->GetLod(level);
+
+	const auto center = (Sm->BoundsMin + Sm->BoundsMax) * 0.5f;
+	const auto depth = (transform * engine->MainCamera->GetViewMatrix()).Project(center).Z;
+
 	if(RenderWire) {
-		RenderHelper::DrawWireMesh(GEngine::Get()->MainCamera, GetParent()->WorldTransform, Sm.Vertices, Sm.Indices);
-	}
-	else {
-		RenderHelper::FillMesh(GEngine::Get()->MainCamera, GetParent()->WorldTransform, Sm.Vertices, Sm.Indices, Sm.Uv);
+		command.Kind = RenderCommand::Type::DrawWireMesh;
+		engine->Commands.Submit(RenderPass::Wire, depth, command);
+		return;
 	}
 
-	RenderHelper::CurrentShader = nullptr;
+	if (Material.StaticLightShader) command.StaticLight = &UpdateLightCache(level, transform);
+
+	// Lines do not write depth, only surfaces are drawn in the pre-pass.
+	if (engine->CurrentRenderPath == RenderPath::DepthPrepass) {
+		engine->Commands.Submit(RenderPass::DepthPrepass, depth, command);
+	}
+	engine->Commands.Submit(RenderPass::Opaque, depth, command);
 }
 
 void StaticMeshComponent::Destroy() {
 	
 }
+
+void StaticMeshComponent::RenderOcclusion() {
+	if (!IsOccluder || !Sm) return;
+
+	// Always the full mesh, simplified levels can pull their silhouettes in and hide what is visible.
+	auto transform = GetWorldTransform();
+	GEngine::Get()->Occlusion.DrawOccluder(transform, *Sm);
+}
+
+bool StaticMeshComponent::GetLocalBounds(Aabb& Bounds) const {
+	if (!Sm) return false;
+
+	Bounds = Aabb(Sm->BoundsMin, Sm->BoundsMax).GetTransformed(RelativeTransform);
+	return !Sm->Vertices.empty();
+}
+
+bool StaticMeshComponent::Raycast(const Vec3F& Origin, const Vec3F& Direction, RayHit& Hit) const {
+	if (!Sm) return false;
+
+	// Moving the ray into model space keeps distances along it the same, the direction scales with the mesh.
+	const auto toModel = GetWorldTransform().GetInverse();
+	auto direction = Direction;
+	direction.W = 0.0f;
+
+	return Sm->Triangles.Raycast(toModel.Project(Origin), toModel.Project(direction), Hit);
+}
+
+Mat4 StaticMeshComponent::GetWorldTransform() const {
+	return RelativeTransform * GetParent()->GetWorldTransform();
+}
+
+unsigned StaticMeshComponent::SelectLod(Mat4& Transform) const {
+	return Sm->SelectLod(Transform, *GEngine::Get()->MainCamera, LodPixelError);
+}
+
+void StaticMeshComponent::InvalidateLightCache() {
+	for (auto& cache : LightCaches) {
+		cache.IsValid = false;
+	}
+}
+
+const std::vector<Vec3F>& StaticMeshComponent::UpdateLightCache(const unsigned Level, const Mat4& Transform) {
+	if (LightCaches.size() <= Level) LightCaches.resize(Level + 1);
+
+	auto& cache = LightCaches[Level];
+	const auto version = GEngine::Get()->Lights.GetStaticVersion();
+	if (cache.IsValid && cache.Version == version && cache.Transform == Transform) return cache.Light;
+
+	const auto& mesh = Sm->GetLod(Level);
+	cache.Light.resize(mesh.Vertices.size());
+	if (Material.HasRegistryStaticLight()) {
+		// The stage is plain scene lighting, so the whole mesh goes through the batched lighting kernel.
+		GEngine::Get()->Lights.EvaluateStatic(mesh.Streams, Transform, nullptr, cache.Light.data());
+	}
+	else {
+		for (unsigned i = 0; i < mesh.Vertices.size(); ++i) {
+			auto v = mesh.Vertices[i];
+			Material.StaticLightShader(v, Transform);
+			cache.Light[i] = v.Light;
+		}
+	}
+
+	cache.Transform = Transform;
+	cache.Version = version;
+	cache.IsValid = true;
+
+	return cache.Light;
+}
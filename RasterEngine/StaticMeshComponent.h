@@ -1,30 +1,71 @@
 #pragma once
 #include "Component.h"
 #include "EngineDefines.h"
+#include "MeshRegistry.h"
 #include "Shader.h"
-#include "StaticMesh.h"
 
 class StaticMeshComponent :
     public Component
 {
 public:
-	explicit StaticMeshComponent(StaticMesh Mesh);
+	explicit StaticMeshComponent(MeshHandle Mesh);
 
-	StaticMeshComponent(BaseObject* Parent, StaticMesh Mesh);
+	StaticMeshComponent(BaseObject* Parent, MeshHandle Mesh);
 
-	StaticMeshComponent(BaseObject* Parent, StaticMesh Mesh, Mat4 WorldTransform);
+	StaticMeshComponent(BaseObject* Parent, MeshHandle Mesh, Mat4 RelativeTransform);
 
 	void Start() override;
 	void Update() override;
 	void Render() override;
 	void Destroy() override;
+	void RenderOcclusion() override;
+	bool GetLocalBounds(Aabb& Bounds) const override;
+	bool Raycast(const Vec3F& Origin, const Vec3F& Direction, RayHit& Hit) const override;
 
-	StaticMesh Sm;
+	// Mesh shared with every other component drawing it, see MeshRegistry.
+	MeshHandle Sm;
 
-	Mat4 WorldTransform;
+	// Transform of the mesh relative to its parent object.
+	Mat4 RelativeTransform;
 
 	Shader Material;
 
 	bool RenderWire;
+
+	// Draws this mesh into the occlusion buffer to hide the objects behind it. Occluders are never culled themselves.
+	bool IsOccluder;
+
+	// Largest error in pixels a LOD may show on screen before a more detailed level is used.
+	float LodPixelError;
+
+	/**
+	 * \brief Gets the matrix from model space to world space, the relative transform followed by the parent's.
+	 */
+	Mat4 GetWorldTransform() const;
+
+	/**
+	 * \brief Picks the coarsest LOD whose error projects to no more than LodPixelError pixels from the main camera.
+	 * \return Detail level to render, 0 for the full mesh.
+	 */
+	unsigned SelectLod(Mat4& Transform) const;
+
+	/**
+	 * \brief Forces the static lighting to be recalculated on the next render, call after changing the material.
+	 */
+	void InvalidateLightCache();
+
+private:
+	// Per vertex output of the materials static light shader, reused while the transform and lights are unchanged.
+	struct LightCacheEntry {
+		std::vector<Vec3F> Light;
+		Mat4 Transform;
+		unsigned Version = 0;
+		bool IsValid = false;
+	};
+
+	// One light cache per detail level, so switching LOD does not relight the others.
+	std::vector<LightCacheEntry> LightCaches;
+
+	const std::vector<Vec3F>& UpdateLightCache(unsigned Level, const Mat4& Transform);
 };
 
@@ -0,0 +1,445 @@
+#include "Texture.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+
+#include "EngineDefines.h"
+#include "celestial.h"
+#include "StoneHenge_Texture.h"
+
+namespace {
+	// Number of decoded blocks each thread keeps, indexed by an 8x8 window of block coordinates.
+	constexpr unsigned BlockCacheSize = 64;
+
+	struct DecodedBlock {
+		unsigned TextureId;
+		unsigned BlockIndex;
+		unsigned Texels[16];
+	};
+
+	// Ids start at 1 so the zero initialized cache entries never match a texture.
+	std::atomic<unsigned> NextTextureId{1};
+
+	thread_local DecodedBlock BlockCache[BlockCacheSize] = {};
+
+	// Texture coordinate change per pixel of the fragments being shaded, 0 when nothing set it.
+	thread_local float SampleFootprint = 0.0f;
+
+	unsigned ToRgb565(const float R, const float G, const float B) {
+		const auto r = ClampAndRound(R * 31.0f / 255.0f, 0.0f, 31.0f);
+		const auto g = ClampAndRound(G * 63.0f / 255.0f, 0.0f, 63.0f);
+		const auto b = ClampAndRound(B * 31.0f / 255.0f, 0.0f, 31.0f);
+
+		return r << 11 | g << 5 | b;
+	}
+
+	unsigned FromRgb565(const unsigned C) {
+		const auto r = (C >> 11) & 0x1F;
+		const auto g = (C >> 5) & 0x3F;
+		const auto b = C & 0x1F;
+
+		// Replicate the high bits into the low bits so 0x1F expands to 0xFF.
+		return 0xFF000000 | ((r << 3) | (r >> 2)) << 16 | ((g << 2) | (g >> 4)) << 8 | ((b << 3) | (b >> 2));
+	}
+
+	unsigned MixChannels(const unsigned A, const unsigned B, const unsigned WeightA, const unsigned WeightB) {
+		const auto total = WeightA + WeightB;
+		const auto r = (((A >> 16) & 0xFF) * WeightA + ((B >> 16) & 0xFF) * WeightB) / total;
+		const auto g = (((A >> 8) & 0xFF) * WeightA + ((B >> 8) & 0xFF) * WeightB) / total;
+		const auto b = ((A & 0xFF) * WeightA + (B & 0xFF) * WeightB) / total;
+
+		return 0xFF000000 | r << 16 | g << 8 | b;
+	}
+
+	/**
+	 * \brief Expands the two 565 endpoints of a color block into its four palette entries.
+	 * \param C0 First endpoint.
+	 * \param C1 Second endpoint.
+	 * \param AllowTransparent If true and C0 <= C1 the block uses three colors and index 3 is transparent black.
+	 * \param Palette Receives the AARRGGBB palette.
+	 */
+	void BuildColorPalette(const unsigned C0, const unsigned C1, const bool AllowTransparent, unsigned* Palette) {
+		Palette[0] = FromRgb565(C0);
+		Palette[1] = FromRgb565(C1);
+
+		if (C0 > C1 || !AllowTransparent) {
+			Palette[2] = MixChannels(Palette[0], Palette[1], 2, 1);
+			Palette[3] = MixChannels(Palette[0], Palette[1], 1, 2);
+		}
+		else {
+			Palette[2] = MixChannels(Palette[0], Palette[1], 1, 1);
+			Palette[3] = 0x00000000;
+		}
+	}
+
+	void BuildAlphaPalette(const unsigned A0, const unsigned A1, unsigned* Palette) {
+		Palette[0] = A0;
+		Palette[1] = A1;
+
+		if (A0 > A1) {
+			for (unsigned i = 1; i < 7; ++i) {
+				Palette[i + 1] = ((7 - i) * A0 + i * A1) / 7;
+			}
+		}
+		else {
+			for (unsigned i = 1; i < 5; ++i) {
+				Palette[i + 1] = ((5 - i) * A0 + i * A1) / 5;
+			}
+			Palette[6] = 0;
+			Palette[7] = 255;
+		}
+	}
+
+	unsigned ColorDistance(const unsigned A, const unsigned B) {
+		const int r = (int)((A >> 16) & 0xFF) - (int)((B >> 16) & 0xFF);
+		const int g = (int)((A >> 8) & 0xFF) - (int)((B >> 8) & 0xFF);
+		const int b = (int)(A & 0xFF) - (int)(B & 0xFF);
+
+		return (unsigned)(r * r + g * g + b * b);
+	}
+
+	/**
+	 * \brief Averages every channel of four texels, rounding to the nearest value.
+	 */
+	unsigned AverageTexels(const unsigned A, const unsigned B, const unsigned C, const unsigned D) {
+		unsigned result = 0;
+		for (unsigned shift = 0; shift < 32; shift += 8) {
+			const auto sum = ((A >> shift) & 0xFF) + ((B >> shift) & 0xFF) + ((C >> shift) & 0xFF) + ((D >> shift) & 0xFF);
+			result |= ((sum + 2) / 4) << shift;
+		}
+
+		return result;
+	}
+}
+
+const Texture CELESTIAL_TEXTURE{celestial_pixels, celestial_width, celestial_height, TextureFormat::BC1};
+const Texture STONEHENGE_TEXTURE{StoneHenge_pixels, StoneHenge_width, StoneHenge_height, TextureFormat::BC1};
+
+Texture::Texture(): Id(NextTextureId++), Width(0), Height(0), BlocksWide(0), BlocksHigh(0), Format(TextureFormat::ARGB8) {}
+
+Texture::Texture(const unsigned* BgraPixels, const unsigned Width, const unsigned Height, const TextureFormat Format):
+	Id(NextTextureId++),
+	Width(Width),
+	Height(Height),
+	BlocksWide((Width + 3) / 4),
+	BlocksHigh((Height + 3) / 4),
+	Format(Format) {
+	std::vector<unsigned> texels;
+	texels.reserve(Width * Height);
+	for (unsigned i = 0; i < Width * Height; ++i) {
+		texels.emplace_back(BGRA_TO_ARGB(BgraPixels[i]));
+	}
+
+	Encode(texels);
+	BuildMips(std::move(texels));
+}
+
+unsigned Texture::Sample(const Vec2F& Uv) const {
+	if (SampleFootprint <= 0.0f || Mips.empty()) return SampleLevel(Uv, 0);
+
+	// The level whose texels are closest to one pixel apart, each level halves the texels per pixel.
+	const auto lod = std::log2(SampleFootprint * (float)(Width > Height ? Width : Height));
+	return SampleLevel(Uv, lod < 0.5f ? 0 : Floor(Min(lod, 31.0f) + 0.5f));
+}
+
+unsigned Texture::SampleLevel(const Vec2F& Uv, const unsigned Level) const {
+	const auto& level = Level == 0 || Mips.empty() ? *this : Mips[(Level < Mips.size() ? Level : (unsigned)Mips.size()) - 1];
+
+	const auto x = Floor(Clamp(Uv.X) * (float)level.Width);
+	const auto y = Floor(Clamp(Uv.Y) * (float)level.Height);
+
+	return level.Fetch(x, y);
+}
+
+void Texture::SetSampleFootprint(const float UvPerPixel) {
+	SampleFootprint = UvPerPixel;
+}
+
+unsigned Texture::Fetch(unsigned X, unsigned Y) const {
+	if (Width == 0 || Height == 0) return 0;
+
+	if (X >= Width) X = Width - 1;
+	if (Y >= Height) Y = Height - 1;
+
+	if (Format == TextureFormat::ARGB8) {
+		return Texels[TwoD2OneD(X, Y, Width)];
+	}
+
+	const auto bx = X >> 2;
+	const auto by = Y >> 2;
+	const auto blockIndex = TwoD2OneD(bx, by, BlocksWide);
+
+	// Neighbouring blocks land in different slots so a triangle sweeping across the texture keeps its blocks cached.
+	auto& cached = BlockCache[((bx & 7) | (by & 7) << 3) ^ ((Id * 13) & (BlockCacheSize - 1))];
+	if (cached.TextureId != Id || cached.BlockIndex != blockIndex) {
+		DecodeBlock(blockIndex, cached.Texels);
+		cached.TextureId = Id;
+		cached.BlockIndex = blockIndex;
+	}
+
+	return cached.Texels[(Y & 3) * 4 + (X & 3)];
+}
+
+size_t Texture::GetSizeInBytes() const {
+	auto size = Texels.size() * sizeof(unsigned) + Blocks.size() * sizeof(uint64_t);
+	for (const auto& mip : Mips) {
+		size += mip.GetSizeInBytes();
+	}
+
+	return size;
+}
+
+unsigned Texture::GetMipCount() const {
+	return (unsigned)Mips.size() + 1;
+}
+
+unsigned Texture::GetWidth() const {
+	return Width;
+}
+
+unsigned Texture::GetHeight() const {
+	return Height;
+}
+
+TextureFormat Texture::GetFormat() const {
+	return Format;
+}
+
+void Texture::Encode(const std::vector<unsigned>& ArgbTexels) {
+	if (Format == TextureFormat::ARGB8) {
+		Texels = ArgbTexels;
+		return;
+	}
+
+	Blocks.reserve(BlocksWide * BlocksHigh * (Format == TextureFormat::BC3 ? 2 : 1));
+
+	unsigned blockTexels[16];
+	for (unsigned by = 0; by < BlocksHigh; ++by) {
+		for (unsigned bx = 0; bx < BlocksWide; ++bx) {
+			// Gather the 4x4 block, repeating the edge texels for textures that are not a multiple of 4.
+			for (unsigned i = 0; i < 16; ++i) {
+				auto x = bx * 4 + (i & 3);
+				auto y = by * 4 + (i >> 2);
+				if (x >= Width) x = Width - 1;
+				if (y >= Height) y = Height - 1;
+
+				blockTexels[i] = ArgbTexels[TwoD2OneD(x, y, Width)];
+			}
+
+			if (Format == TextureFormat::BC3) {
+				Blocks.emplace_back(EncodeAlphaBlock(blockTexels));
+				Blocks.emplace_back(EncodeColorBlock(blockTexels, false));
+			}
+			else {
+				Blocks.emplace_back(EncodeColorBlock(blockTexels, true));
+			}
+		}
+	}
+}
+
+void Texture::BuildMips(std::vector<unsigned> ArgbTexels) {
+	auto width = Width, height = Height;
+	while (width > 1 || height > 1) {
+		const auto mipWidth = width > 1 ? width / 2 : 1;
+		const auto mipHeight = height > 1 ? height / 2 : 1;
+
+		// Odd sizes drop their last row or column, the edge texels are repeated for a side that is already 1.
+		std::vector<unsigned> mipTexels(mipWidth * mipHeight);
+		for (unsigned y = 0; y < mipHeight; ++y) {
+			const auto y0 = y * 2;
+			const auto y1 = y0 + 1 < height ? y0 + 1 : y0;
+			for (unsigned x = 0; x < mipWidth; ++x) {
+				const auto x0 = x * 2;
+				const auto x1 = x0 + 1 < width ? x0 + 1 : x0;
+				mipTexels[TwoD2OneD(x, y, mipWidth)] = AverageTexels(
+					ArgbTexels[TwoD2OneD(x0, y0, width)], ArgbTexels[TwoD2OneD(x1, y0, width)],
+					ArgbTexels[TwoD2OneD(x0, y1, width)], ArgbTexels[TwoD2OneD(x1, y1, width)]);
+			}
+		}
+
+		Texture mip;
+		mip.Width = mipWidth;
+		mip.Height = mipHeight;
+		mip.BlocksWide = (mipWidth + 3) / 4;
+		mip.BlocksHigh = (mipHeight + 3) / 4;
+		mip.Format = Format;
+		mip.Encode(mipTexels);
+		Mips.emplace_back(std::move(mip));
+
+		ArgbTexels.swap(mipTexels);
+		width = mipWidth;
+		height = mipHeight;
+	}
+}
+
+void Texture::DecodeBlock(const unsigned BlockIndex, unsigned* Out) const {
+	if (Format == TextureFormat::BC3) {
+		unsigned alpha[16];
+		DecodeAlphaBlock(Blocks[BlockIndex * 2], alpha);
+		DecodeColorBlock(Blocks[BlockIndex * 2 + 1], Out, false);
+
+		for (unsigned i = 0; i < 16; ++i) {
+			Out[i] = (Out[i] & 0x00FFFFFF) | alpha[i] << 24;
+		}
+	}
+	else {
+		DecodeColorBlock(Blocks[BlockIndex], Out, true);
+	}
+}
+
+uint64_t Texture::EncodeColorBlock(const unsigned* BlockTexels, const bool AllowTransparent) {
+	// Collect the opaque texels, transparent ones are written as index 3 of a three color block.
+	float points[16][3];
+	unsigned count = 0;
+	bool hasTransparent = false;
+	for (unsigned i = 0; i < 16; ++i) {
+		if (AllowTransparent && (BlockTexels[i] >> 24) < 128) {
+			hasTransparent = true;
+			continue;
+		}
+
+		points[count][0] = (float)((BlockTexels[i] >> 16) & 0xFF);
+		points[count][1] = (float)((BlockTexels[i] >> 8) & 0xFF);
+		points[count][2] = (float)(BlockTexels[i] & 0xFF);
+		count++;
+	}
+
+	// Fully transparent block.
+	if (count == 0) {
+		return 0xFFFFFFFF00000000ull;
+	}
+
+	float mean[3] = {0, 0, 0};
+	for (unsigned i = 0; i < count; ++i) {
+		mean[0] += points[i][0];
+		mean[1] += points[i][1];
+		mean[2] += points[i][2];
+	}
+	mean[0] /= (float)count;
+	mean[1] /= (float)count;
+	mean[2] /= (float)count;
+
+	// Covariance of the block colors, the endpoints are placed along its principal axis.
+	float cov[6] = {0, 0, 0, 0, 0, 0};
+	for (unsigned i = 0; i < count; ++i) {
+		const auto r = points[i][0] - mean[0];
+		const auto g = points[i][1] - mean[1];
+		const auto b = points[i][2] - mean[2];
+		cov[0] += r * r;
+		cov[1] += r * g;
+		cov[2] += r * b;
+		cov[3] += g * g;
+		cov[4] += g * b;
+		cov[5] += b * b;
+	}
+
+	// A few power iterations are plenty to find the dominant axis of 16 colors.
+	float axis[3] = {1.0f, 1.0f, 1.0f};
+	for (int i = 0; i < 4; ++i) {
+		const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		const float length = std::sqrt(x * x + y * y + z * z);
+		if (length < 0.0001f) break;
+
+		axis[0] = x / length;
+		axis[1] = y / length;
+		axis[2] = z / length;
+	}
+
+	float minT = 0.0f, maxT = 0.0f;
+	for (unsigned i = 0; i < count; ++i) {
+		const auto t = (points[i][0] - mean[0]) * axis[0] + (points[i][1] - mean[1]) * axis[1] + (points[i][2] - mean[2]) * axis[2];
+		minT = Min(minT, t);
+		maxT = Max(maxT, t);
+	}
+
+	auto c0 = ToRgb565(mean[0] + axis[0] * maxT, mean[1] + axis[1] * maxT, mean[2] + axis[2] * maxT);
+	auto c1 = ToRgb565(mean[0] + axis[0] * minT, mean[1] + axis[1] * minT, mean[2] + axis[2] * minT);
+
+	// Endpoint order selects the block mode, three color mode is only wanted when there is transparency.
+	if (hasTransparent ? c0 > c1 : c0 < c1) {
+		Swap(c0, c1);
+	}
+
+	unsigned palette[4];
+	BuildColorPalette(c0, c1, AllowTransparent, palette);
+
+	// Index 3 is transparent black in three color mode, keep opaque texels away from it.
+	const bool threeColor = AllowTransparent && c0 <= c1;
+
+	uint64_t indices = 0;
+	for (unsigned i = 0; i < 16; ++i) {
+		unsigned best = 0;
+		if (threeColor && (BlockTexels[i] >> 24) < 128) {
+			best = 3;
+		}
+		else {
+			auto bestDistance = ColorDistance(BlockTexels[i], palette[0]);
+			for (unsigned j = 1; j < (threeColor ? 3u : 4u); ++j) {
+				const auto distance = ColorDistance(BlockTexels[i], palette[j]);
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = j;
+				}
+			}
+		}
+
+		indices |= (uint64_t)best << (i * 2);
+	}
+
+	return (uint64_t)c0 | (uint64_t)c1 << 16 | indices << 32;
+}
+
+uint64_t Texture::EncodeAlphaBlock(const unsigned* BlockTexels) {
+	unsigned a0 = 0, a1 = 255;
+	for (unsigned i = 0; i < 16; ++i) {
+		const auto a = BlockTexels[i] >> 24;
+		if (a > a0) a0 = a;
+		if (a < a1) a1 = a;
+	}
+
+	uint64_t block = (uint64_t)a0 | (uint64_t)a1 << 8;
+	if (a0 == a1) return block;
+
+	unsigned palette[8];
+	BuildAlphaPalette(a0, a1, palette);
+
+	for (unsigned i = 0; i < 16; ++i) {
+		const int a = (int)(BlockTexels[i] >> 24);
+
+		unsigned best = 0;
+		auto bestDistance = std::abs(a - (int)palette[0]);
+		for (unsigned j = 1; j < 8; ++j) {
+			const auto distance = std::abs(a - (int)palette[j]);
+			if (distance < bestDistance) {
+				bestDistance = distance;
+				best = j;
+			}
+		}
+
+		block |= (uint64_t)best << (16 + i * 3);
+	}
+
+	return block;
+}
+
+void Texture::DecodeColorBlock(const uint64_t Block, unsigned* Out, const bool AllowTransparent) {
+	unsigned palette[4];
+	BuildColorPalette((unsigned)(Block & 0xFFFF), (unsigned)((Block >> 16) & 0xFFFF), AllowTransparent, palette);
+
+	const auto indices = (unsigned)(Block >> 32);
+	for (unsigned i = 0; i < 16; ++i) {
+		Out[i] = palette[(indices >> (i * 2)) & 3];
+	}
+}
+
+void Texture::DecodeAlphaBlock(const uint64_t Block, unsigned* Out) {
+	unsigned palette[8];
+	BuildAlphaPalette((unsigned)(Block & 0xFF), (unsigned)((Block >> 8) & 0xFF), palette);
+
+	for (unsigned i = 0; i < 16; ++i) {
+		Out[i] = palette[(Block >> (16 + i * 3)) & 7];
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vec2F;
+
+/**
+ * \brief Storage layouts a texture can be imported into.
+ */
+enum class TextureFormat {
+	// Uncompressed AARRGGBB texels, 4 bytes per texel.
+	ARGB8,
+	// 4x4 blocks of two 565 endpoints and 2 bit indices with 1 bit alpha, 0.5 bytes per texel.
+	BC1,
+	// BC1 color block paired with an interpolated 8 bit alpha block, 1 byte per texel.
+	BC3
+};
+
+/**
+ * \brief Texture data imported from a texture header. Block compressed formats are encoded once on import and
+ * decoded 4x4 blocks at a time into a small per thread cache when sampled. A chain of box filtered mip levels is built
+ * on import so minified textures sample texels that cover about one pixel each.
+ */
+class Texture
+{
+public:
+	Texture();
+
+	/**
+	 * \brief Imports the texels of a texture header, encoding them into the requested format.
+	 * \param BgraPixels Texels in the BBGGRRAA layout written by the texture array exporter.
+	 * \param Width Width in texels of the texture.
+	 * \param Height Height in texels of the texture.
+	 * \param Format Storage format to encode the texels into.
+	 */
+	Texture(const unsigned* BgraPixels, unsigned Width, unsigned Height, TextureFormat Format);
+
+	/**
+	 * \brief Samples the nearest texel to the given uv coordinate in the mip level closest to the footprint set for this
+	 * thread, see SetSampleFootprint.
+	 * \param Uv Texture coordinate, clamped to 0-1.
+	 * \return Texel color in AARRGGBB.
+	 */
+	unsigned Sample(const Vec2F& Uv) const;
+
+	/**
+	 * \brief Samples the nearest texel to the given uv coordinate in one mip level.
+	 * \param Level 0 for the full resolution, clamped to the smallest level.
+	 */
+	unsigned SampleLevel(const Vec2F& Uv, unsigned Level) const;
+
+	/**
+	 * \brief Sets how far the texture coordinate moves per pixel for whatever this thread shades next. The rasterizer
+	 * sets it from the derivatives of every 2x2 quad it shades, 0 samples the full resolution.
+	 */
+	static void SetSampleFootprint(float UvPerPixel);
+
+	/**
+	 * \brief Reads a single texel, decoding its block if it is not already in this threads block cache.
+	 * \param X Column of the texel, clamped to the texture.
+	 * \param Y Row of the texel, clamped to the texture.
+	 * \return Texel color in AARRGGBB.
+	 */
+	unsigned Fetch(unsigned X, unsigned Y) const;
+
+	/**
+	 * \brief Gets the memory used by the texel data of this texture.
+	 * \return Size in bytes of the encoded texels of every mip level.
+	 */
+	size_t GetSizeInBytes() const;
+
+	/**
+	 * \return Number of mip levels, counting the full resolution.
+	 */
+	unsigned GetMipCount() const;
+
+	unsigned GetWidth() const;
+	unsigned GetHeight() const;
+	TextureFormat GetFormat() const;
+
+private:
+	// Identifies this textures blocks inside the per thread decoded block cache.
+	unsigned Id;
+
+	unsigned Width, Height;
+	unsigned BlocksWide, BlocksHigh;
+	TextureFormat Format;
+
+	// Texels for ARGB8 textures.
+	std::vector<unsigned> Texels;
+
+	// Encoded blocks for BC textures, one word per block for BC1 and an alpha word followed by a color word for BC3.
+	std::vector<uint64_t> Blocks;
+
+	// Every level after the full resolution one, each half the size of the one before down to 1x1.
+	std::vector<Texture> Mips;
+
+	/**
+	 * \brief Stores the texels of this level in its format.
+	 * \param ArgbTexels Width * Height texels in AARRGGBB.
+	 */
+	void Encode(const std::vector<unsigned>& ArgbTexels);
+
+	/**
+	 * \brief Builds the mip chain by averaging 2x2 texels of every level into one of the next.
+	 */
+	void BuildMips(std::vector<unsigned> ArgbTexels);
+
+	void DecodeBlock(unsigned BlockIndex, unsigned* Out) const;
+
+	static uint64_t EncodeColorBlock(const unsigned* BlockTexels, bool AllowTransparent);
+	static uint64_t EncodeAlphaBlock(const unsigned* BlockTexels);
+	static void DecodeColorBlock(uint64_t Block, unsigned* Out, bool AllowTransparent);
+	static void DecodeAlphaBlock(uint64_t Block, unsigned* Out);
+};
+
+// Textures used by the engine shaders, imported once at startup.
+extern const Texture CELESTIAL_TEXTURE;
+extern const Texture STONEHENGE_TEXTURE;
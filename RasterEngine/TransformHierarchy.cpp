@@ -0,0 +1,226 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <type_traits>
+
+constexpr unsigned TransformHierarchy::InvalidNode;
+
+TransformHierarchy::TransformHierarchy(): FirstDirty(InvalidNode), IsOrderDirty(false), DestroyedCount(0) {}
+
+unsigned TransformHierarchy::Create(BaseObject* const Owner, const unsigned Parent) {
+	const auto parentSlot = Parent == InvalidNode ? InvalidNode : GetSlot(Parent);
+
+	unsigned handle;
+	if (FreeHandles.empty()) {
+		handle = (unsigned)Slots.size();
+		Slots.emplace_back();
+	}
+	else {
+		handle = FreeHandles.back();
+		FreeHandles.pop_back();
+	}
+
+	const auto slot = (unsigned)Handles.size();
+	Slots[handle] = slot;
+
+	Parents.emplace_back(parentSlot);
+	Handles.emplace_back(handle);
+	Owners.emplace_back(Owner);
+	Locals.emplace_back();
+	Worlds.emplace_back();
+	IsDirty.emplace_back(0);
+	MarkDirty(slot);
+
+	// Roots can always go last, children only stay depth first when their parent's subtree is the last one.
+	if (parentSlot != InvalidNode) IsOrderDirty = true;
+
+	return handle;
+}
+
+void TransformHierarchy::Destroy(const unsigned Node) {
+	const auto slot = GetSlot(Node);
+
+	// An identity transform passes the world matrix of the parent on unchanged, which attaches the children to it
+	// without finding them.
+	Locals[slot] = Transform();
+	MarkDirty(slot);
+
+	Handles[slot] = InvalidNode;
+	Owners[slot] = nullptr;
+	Slots[Node] = InvalidNode;
+	FreeHandles.emplace_back(Node);
+	DestroyedCount++;
+}
+
+void TransformHierarchy::Clear() {
+	Parents.clear();
+	Handles.clear();
+	Owners.clear();
+	Locals.clear();
+	Worlds.clear();
+	IsDirty.clear();
+	Slots.clear();
+	FreeHandles.clear();
+	FirstDirty = InvalidNode;
+	IsOrderDirty = false;
+	DestroyedCount = 0;
+}
+
+void TransformHierarchy::SetParent(const unsigned Node, const unsigned Parent) {
+	const auto slot = GetSlot(Node);
+	const auto parentSlot = Parent == InvalidNode ? InvalidNode : GetSlot(Parent);
+
+	for (auto ancestor = parentSlot; ancestor != InvalidNode; ancestor = Parents[ancestor]) {
+		if (ancestor == slot) throw std::exception("Transform can not be parented to itself or a descendant");
+	}
+
+	if (Parents[slot] == parentSlot) return;
+
+	Parents[slot] = parentSlot;
+	MarkDirty(slot);
+	IsOrderDirty = true;
+}
+
+unsigned TransformHierarchy::GetParent(const unsigned Node) const {
+	const auto parentSlot = GetLivingParent(GetSlot(Node));
+	return parentSlot == InvalidNode ? InvalidNode : Handles[parentSlot];
+}
+
+BaseObject* TransformHierarchy::GetOwner(const unsigned Node) const {
+	return Node == InvalidNode ? nullptr : Owners[GetSlot(Node)];
+}
+
+void TransformHierarchy::SetLocal(const unsigned Node, const Transform& Local) {
+	const auto slot = GetSlot(Node);
+	Locals[slot] = Local;
+	MarkDirty(slot);
+}
+
+const Transform& TransformHierarchy::GetLocal(const unsigned Node) const {
+	return Locals[GetSlot(Node)];
+}
+
+const Mat4& TransformHierarchy::GetWorld(const unsigned Node) {
+	if (IsOrderDirty || FirstDirty != InvalidNode) Update();
+	return Worlds[GetSlot(Node)];
+}
+
+void TransformHierarchy::Update() {
+	if (IsOrderDirty || DestroyedCount * 2 > Parents.size()) Reorder();
+	if (FirstDirty == InvalidNode) return;
+
+	const auto count = (unsigned)Parents.size();
+	for (auto i = FirstDirty; i < count; ++i) {
+		const auto parent = Parents[i];
+
+		// A parent that was recomputed is still flagged, which carries the change down to all of its descendants.
+		if (!IsDirty[i]) {
+			if (parent == InvalidNode || !IsDirty[parent]) continue;
+			IsDirty[i] = 1;
+		}
+
+		// Composing matrices rather than transforms keeps the shear an uneven parent scale gives rotated children.
+		const auto local = Locals[i].ToMat4();
+		Worlds[i] = parent == InvalidNode ? local : local * Worlds[parent];
+	}
+
+	std::fill(IsDirty.begin() + FirstDirty, IsDirty.end(), (unsigned char)0);
+	FirstDirty = InvalidNode;
+}
+
+unsigned TransformHierarchy::GetCount() const {
+	return (unsigned)(Slots.size() - FreeHandles.size());
+}
+
+unsigned TransformHierarchy::GetSlot(const unsigned Node) const {
+	if (Node >= Slots.size() || Slots[Node] == InvalidNode) throw std::exception("Invalid transform node");
+	return Slots[Node];
+}
+
+unsigned TransformHierarchy::GetLivingParent(const unsigned Slot) const {
+	auto parent = Parents[Slot];
+	while (parent != InvalidNode && Handles[parent] == InvalidNode) parent = Parents[parent];
+	return parent;
+}
+
+void TransformHierarchy::MarkDirty(const unsigned Slot) {
+	IsDirty[Slot] = 1;
+	if (Slot < FirstDirty) FirstDirty = Slot;
+}
+
+void TransformHierarchy::Reorder() {
+	const auto count = (unsigned)Parents.size();
+
+	// Destroyed nodes are dropped, so their children move up to the closest ancestor left and have to be recomputed
+	// without them. Destroyed nodes keep their own parents, which lets every chain be followed whatever order the
+	// living nodes are rewritten in.
+	for (unsigned i = 0; i < count; ++i) {
+		if (Handles[i] == InvalidNode) continue;
+
+		const auto parent = GetLivingParent(i);
+		if (parent == Parents[i]) continue;
+
+		Parents[i] = parent;
+		IsDirty[i] = 1;
+	}
+
+	// Gather the children of every node, in their current order, into one list with an offset per node.
+	std::vector<unsigned> childOffsets(count + 1, 0);
+	std::vector<unsigned> roots;
+	for (unsigned i = 0; i < count; ++i) {
+		if (Handles[i] == InvalidNode) continue;
+
+		if (Parents[i] == InvalidNode) roots.emplace_back(i);
+		else childOffsets[Parents[i] + 1]++;
+	}
+
+	for (unsigned i = 0; i < count; ++i) childOffsets[i + 1] += childOffsets[i];
+
+	std::vector<unsigned> children(childOffsets[count]);
+	std::vector<unsigned> childCounts(count, 0);
+	for (unsigned i = 0; i < count; ++i) {
+		if (Handles[i] == InvalidNode || Parents[i] == InvalidNode) continue;
+
+		const auto parent = Parents[i];
+		children[childOffsets[parent] + childCounts[parent]++] = i;
+	}
+
+	// Walk the trees depth first, pushing children in reverse so they come out in their old order.
+	std::vector<unsigned> order;
+	order.reserve(count);
+	std::vector<unsigned> stack(roots.rbegin(), roots.rend());
+	while (!stack.empty()) {
+		const auto slot = stack.back();
+		stack.pop_back();
+		order.emplace_back(slot);
+
+		for (auto i = childOffsets[slot + 1]; i-- > childOffsets[slot];) stack.emplace_back(children[i]);
+	}
+
+	std::vector<unsigned> newSlots(count, InvalidNode);
+	for (unsigned i = 0; i < order.size(); ++i) newSlots[order[i]] = i;
+
+	const auto permute = [&order](auto& Values) {
+		std::remove_reference_t<decltype(Values)> sorted;
+		sorted.reserve(order.size());
+		for (const auto slot : order) sorted.emplace_back(std::move(Values[slot]));
+		Values.swap(sorted);
+	};
+
+	permute(Parents);
+	permute(Handles);
+	permute(Owners);
+	permute(Locals);
+	permute(Worlds);
+	permute(IsDirty);
+
+	FirstDirty = InvalidNode;
+	for (unsigned i = 0; i < order.size(); ++i) {
+		if (Parents[i] != InvalidNode) Parents[i] = newSlots[Parents[i]];
+		Slots[Handles[i]] = i;
+		if (IsDirty[i] && FirstDirty == InvalidNode) FirstDirty = i;
+	}
+
+	IsOrderDirty = false;
+	DestroyedCount = 0;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+
+#include "EngineDefines.h"
+
+class BaseObject;
+
+/**
+ * \brief Parent and child relationships between the transforms of objects. Every node has a local transform relative
+ * to its parent and a world matrix that is only recomputed when the node or one of its ancestors changed. Nodes are
+ * stored contiguously in depth first order so every parent comes before its children and all dirty world matrices are
+ * brought up to date in one forward pass. Destroyed nodes stay in that order as identity transforms until enough of
+ * them pile up to compact the arrays, so destroying a node never searches for its children.
+ */
+class TransformHierarchy
+{
+public:
+	// Handle of no node, the parent of root nodes.
+	static constexpr unsigned InvalidNode = ~0u;
+
+	TransformHierarchy();
+
+	/**
+	 * \brief Adds a node with an identity local transform.
+	 * \param Owner Object the node belongs to, returned by GetOwner.
+	 * \param Parent Node to attach to, or InvalidNode for a root.
+	 * \return Handle of the node, stable until it is destroyed.
+	 */
+	unsigned Create(BaseObject* Owner, unsigned Parent = InvalidNode);
+
+	/**
+	 * \brief Removes a node. Its children are attached to its parent and keep their local transforms.
+	 */
+	void Destroy(unsigned Node);
+
+	void Clear();
+
+	/**
+	 * \brief Attaches a node to a new parent, keeping its local transform.
+	 * \param Parent Node to attach to, or InvalidNode to make it a root. Throws if it is the node or a descendant.
+	 */
+	void SetParent(unsigned Node, unsigned Parent);
+	unsigned GetParent(unsigned Node) const;
+	BaseObject* GetOwner(unsigned Node) const;
+
+	/**
+	 * \brief Sets the scale, rotation and translation of a node relative to its parent.
+	 */
+	void SetLocal(unsigned Node, const Transform& Local);
+	const Transform& GetLocal(unsigned Node) const;
+
+	/**
+	 * \brief Gets the matrix from the space of a node to world space, updating the hierarchy first if anything changed.
+	 * \return Reference into the hierarchy, valid until the next node is created, reparented or destroyed. Any of them
+	 * can reorder or compact the arrays before the next update.
+	 */
+	const Mat4& GetWorld(unsigned Node);
+
+	/**
+	 * \brief Recomputes the world matrix of every node whose local transform or ancestors changed since the last
+	 * update, restoring depth first order first if nodes were reparented or many were destroyed.
+	 */
+	void Update();
+
+	unsigned GetCount() const;
+
+private:
+	// Per node in depth first order. Parents holds the position of the parent in this order, not its handle.
+	std::vector<unsigned> Parents;
+	std::vector<unsigned> Handles;
+	std::vector<BaseObject*> Owners;
+	std::vector<Transform> Locals;
+	std::vector<Mat4> Worlds;
+	std::vector<unsigned char> IsDirty;
+
+	// Position in depth first order of every handle, InvalidNode for destroyed handles.
+	std::vector<unsigned> Slots;
+	std::vector<unsigned> FreeHandles;
+
+	// First dirty position, nothing before it has to be visited when updating.
+	unsigned FirstDirty;
+
+	// Set when nodes were reparented and the order no longer matches the tree.
+	bool IsOrderDirty;
+
+	// Destroyed nodes still in the arrays, they are compacted away once they outnumber the living ones.
+	unsigned DestroyedCount;
+
+	unsigned GetSlot(unsigned Node) const;
+
+	/**
+	 * \return Closest ancestor of a position that was not destroyed, or InvalidNode.
+	 */
+	unsigned GetLivingParent(unsigned Slot) const;
+	void MarkDirty(unsigned Slot);
+
+	/**
+	 * \brief Sorts the nodes back into depth first order, dropping destroyed ones and attaching their children to
+	 * the closest ancestor left.
+	 */
+	void Reorder();
+};
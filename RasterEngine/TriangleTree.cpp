@@ -0,0 +1,122 @@
+#include "TriangleTree.h"
+
+#include <xmmintrin.h>
+
+namespace {
+	// Triangles per packet, leaves are kept close to one packet.
+	constexpr unsigned PacketSize = 4;
+
+	__m128 Dot(const __m128 Ax, const __m128 Ay, const __m128 Az, const __m128 Bx, const __m128 By, const __m128 Bz) {
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(Ax, Bx), _mm_mul_ps(Ay, By)), _mm_mul_ps(Az, Bz));
+	}
+}
+
+void TriangleTree::Build(const std::vector<Vert>& Vertices, const std::vector<unsigned>& Indices) {
+	const auto triangleCount = (unsigned)(Indices.size() / 3);
+
+	std::vector<Aabb> boxes(triangleCount);
+	for (unsigned t = 0; t < triangleCount; ++t) {
+		for (unsigned c = 0; c < 3; ++c) boxes[t].Grow(Vertices[Indices[t * 3 + c]].Pos);
+	}
+
+	// A whole packet is tested for about the cost of one triangle.
+	Tree.Build(boxes, 1.0f / PacketSize);
+
+	Packets.clear();
+	LeafPackets.assign(Tree.Nodes.size(), 0);
+	for (unsigned n = 0; n < Tree.Nodes.size(); ++n) {
+		const auto& node = Tree.Nodes[n];
+		if (!node.Count) continue;
+
+		LeafPackets[n] = (unsigned)Packets.size();
+		for (auto first = node.First; first < node.First + node.Count; first += PacketSize) {
+			Packet packet = {};
+			for (unsigned lane = 0; lane < PacketSize; ++lane) {
+				packet.Triangles[lane] = ~0u;
+				if (first + lane >= node.First + node.Count) continue;
+
+				const auto t = Tree.Items[first + lane];
+				const auto& a = Vertices[Indices[t * 3]].Pos;
+				const auto& b = Vertices[Indices[t * 3 + 1]].Pos;
+				const auto& c = Vertices[Indices[t * 3 + 2]].Pos;
+				const Vec3F corners[3] = {a, b - a, c - a};
+
+				for (unsigned axis = 0; axis < 3; ++axis) {
+					const auto get = [axis](const Vec3F& V) { return axis == 0 ? V.X : axis == 1 ? V.Y : V.Z; };
+					packet.Corner[axis][lane] = get(corners[0]);
+					packet.Edge1[axis][lane] = get(corners[1]);
+					packet.Edge2[axis][lane] = get(corners[2]);
+				}
+				packet.Triangles[lane] = t;
+			}
+
+			Packets.emplace_back(packet);
+		}
+	}
+}
+
+bool TriangleTree::Raycast(const Vec3F& Origin, const Vec3F& Direction, RayHit& Hit) const {
+	const Vec3F inverseDirection = {1.0f / Direction.X, 1.0f / Direction.Y, 1.0f / Direction.Z};
+
+	const auto originX = _mm_set1_ps(Origin.X), originY = _mm_set1_ps(Origin.Y), originZ = _mm_set1_ps(Origin.Z);
+	const auto dirX = _mm_set1_ps(Direction.X), dirY = _mm_set1_ps(Direction.Y), dirZ = _mm_set1_ps(Direction.Z);
+	const auto zero = _mm_setzero_ps();
+	const auto one = _mm_set1_ps(1.0f);
+
+	auto isHit = false;
+	Tree.TraverseRay(Origin, inverseDirection, Hit.Distance, [&](const unsigned NodeIndex) {
+		const auto& node = Tree.Nodes[NodeIndex];
+		const auto packetCount = (node.Count + PacketSize - 1) / PacketSize;
+
+		for (auto p = LeafPackets[NodeIndex]; p < LeafPackets[NodeIndex] + packetCount; ++p) {
+			const auto& packet = Packets[p];
+			const auto e1X = _mm_load_ps(packet.Edge1[0]), e1Y = _mm_load_ps(packet.Edge1[1]);
+			const auto e1Z = _mm_load_ps(packet.Edge1[2]);
+			const auto e2X = _mm_load_ps(packet.Edge2[0]), e2Y = _mm_load_ps(packet.Edge2[1]);
+			const auto e2Z = _mm_load_ps(packet.Edge2[2]);
+
+			// Moller Trumbore, solving for the distance and barycentric weights of four triangles at once. Zero sized
+			// padding triangles have no determinant and turn every comparison below false.
+			const auto pX = _mm_sub_ps(_mm_mul_ps(dirY, e2Z), _mm_mul_ps(dirZ, e2Y));
+			const auto pY = _mm_sub_ps(_mm_mul_ps(dirZ, e2X), _mm_mul_ps(dirX, e2Z));
+			const auto pZ = _mm_sub_ps(_mm_mul_ps(dirX, e2Y), _mm_mul_ps(dirY, e2X));
+			const auto inverseDeterminant = _mm_div_ps(one, Dot(e1X, e1Y, e1Z, pX, pY, pZ));
+
+			const auto tX = _mm_sub_ps(originX, _mm_load_ps(packet.Corner[0]));
+			const auto tY = _mm_sub_ps(originY, _mm_load_ps(packet.Corner[1]));
+			const auto tZ = _mm_sub_ps(originZ, _mm_load_ps(packet.Corner[2]));
+			const auto u = _mm_mul_ps(Dot(tX, tY, tZ, pX, pY, pZ), inverseDeterminant);
+
+			const auto qX = _mm_sub_ps(_mm_mul_ps(tY, e1Z), _mm_mul_ps(tZ, e1Y));
+			const auto qY = _mm_sub_ps(_mm_mul_ps(tZ, e1X), _mm_mul_ps(tX, e1Z));
+			const auto qZ = _mm_sub_ps(_mm_mul_ps(tX, e1Y), _mm_mul_ps(tY, e1X));
+			const auto v = _mm_mul_ps(Dot(dirX, dirY, dirZ, qX, qY, qZ), inverseDeterminant);
+			const auto distance = _mm_mul_ps(Dot(e2X, e2Y, e2Z, qX, qY, qZ), inverseDeterminant);
+
+			auto isInside = _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero));
+			isInside = _mm_and_ps(isInside, _mm_cmple_ps(_mm_add_ps(u, v), one));
+			isInside = _mm_and_ps(isInside, _mm_cmpge_ps(distance, zero));
+			isInside = _mm_and_ps(isInside, _mm_cmplt_ps(distance, _mm_set1_ps(Hit.Distance)));
+
+			const auto mask = _mm_movemask_ps(isInside);
+			if (!mask) continue;
+
+			alignas(16) float distances[PacketSize], us[PacketSize], vs[PacketSize];
+			_mm_store_ps(distances, distance);
+			_mm_store_ps(us, u);
+			_mm_store_ps(vs, v);
+
+			for (unsigned lane = 0; lane < PacketSize; ++lane) {
+				if (!(mask & (1 << lane)) || distances[lane] >= Hit.Distance) continue;
+
+				Hit.Distance = distances[lane];
+				Hit.U = us[lane];
+				Hit.V = vs[lane];
+				Hit.Triangle = packet.Triangles[lane];
+				isHit = true;
+			}
+		}
+	});
+
+	return isHit;
+}
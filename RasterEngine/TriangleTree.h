@@ -0,0 +1,61 @@
+#pragma once
+#include <cfloat>
+#include <vector>
+
+#include "Bvh.h"
+#include "VertexStreams.h"
+
+class BaseObject;
+
+/**
+ * \brief Closest hit found by a ray query.
+ */
+struct RayHit {
+	// Distance along the ray in multiples of its direction. Set it before a query to the furthest distance to look.
+	float Distance = FLT_MAX;
+
+	// Barycentric weights of the second and third corner of the triangle at the hit.
+	float U = 0.0f, V = 0.0f;
+
+	// Triangle hit, its corners are Indices[Triangle * 3] to Indices[Triangle * 3 + 2].
+	unsigned Triangle = ~0u;
+
+	// Object hit by scene queries.
+	BaseObject* Object = nullptr;
+};
+
+/**
+ * \brief Bounding volume hierarchy over the triangles of a mesh for ray queries. The triangles of every leaf are
+ * packed four to a packet so a ray is tested against a whole leaf at once.
+ */
+class TriangleTree
+{
+public:
+	/**
+	 * \brief Builds the tree, replacing anything built before.
+	 */
+	void Build(const std::vector<Vert>& Vertices, const std::vector<unsigned>& Indices);
+
+	/**
+	 * \brief Finds the closest triangle a ray passes through from either side.
+	 * \param Direction Direction of the ray, distances are measured in multiples of its length.
+	 * \param Hit Limits the query to Hit.Distance and receives the closest hit nearer than that.
+	 * \return True if Hit was updated.
+	 */
+	bool Raycast(const Vec3F& Origin, const Vec3F& Direction, RayHit& Hit) const;
+
+private:
+	// Four triangles as a corner and two edges in structure of arrays, unused lanes are zero sized triangles.
+	struct Packet {
+		float Corner[3][4];
+		float Edge1[3][4];
+		float Edge2[3][4];
+		unsigned Triangles[4];
+	};
+
+	Bvh Tree;
+	std::vector<Packet, AlignedAllocator<Packet, 16>> Packets;
+
+	// First packet of every leaf node, indexed by node.
+	std::vector<unsigned> LeafPackets;
+};
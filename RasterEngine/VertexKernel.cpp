@@ -0,0 +1,511 @@
+#include "VertexKernel.h"
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "EngineDefines.h"
+#include "Light.h"
+#include "VertexStreams.h"
+
+namespace {
+	// A light with everything that does not depend on the vertex worked out, see Light::Evaluate.
+	struct BatchLight {
+		LightType Type;
+
+		// Light color times intensity, clamped the way Color does.
+		float R, G, B;
+
+		float PosX, PosY, PosZ;
+
+		// Direction of spot lights, negated for directional lights so it points at the light.
+		float DirX, DirY, DirZ;
+
+		float Radius;
+		float OuterCone, ConeRange;
+		float Brightness;
+	};
+
+#if defined(__GNUC__) && !defined(_MSC_VER)
+	__attribute__((target("avx2")))
+#endif
+	__m256 ClampColor(const __m256 V) {
+		return _mm256_min_ps(_mm256_max_ps(V, _mm256_setzero_ps()), _mm256_set1_ps(255.0f));
+	}
+
+#if defined(__GNUC__) && !defined(_MSC_VER)
+	__attribute__((target("avx2")))
+#endif
+	__m256 ClampUnit(const __m256 V) {
+		return _mm256_min_ps(_mm256_max_ps(V, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+	}
+
+#if defined(__GNUC__) && !defined(_MSC_VER)
+	__attribute__((target("avx2")))
+#endif
+	__m256 Dot(const __m256 Ax, const __m256 Ay, const __m256 Az, const __m256 Bx, const __m256 By, const __m256 Bz) {
+		return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(Ax, Bx), _mm256_mul_ps(Ay, By)), _mm256_mul_ps(Az, Bz));
+	}
+}
+
+bool VertexKernel::HasAvx2() {
+	static const bool hasAvx2 = [] {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+
+		// AVX needs both processor support and the OS saving the ymm registers.
+		__cpuid(info, 1);
+		const auto hasOsAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6;
+
+		__cpuidex(info, 7, 0);
+		return hasOsAvx && (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}();
+
+	return hasAvx2;
+}
+
+void VertexKernel::Project(const VertexStreams& Streams, const Mat4& Transform, const Camera& C,
+						   std::vector<Vec2F>& Projected) {
+	float m[16];
+	FoldMatrix(Transform, C, m);
+
+	Projected.resize(Streams.Count);
+	if (HasAvx2()) {
+		ProjectAvx2(Streams, m, (float)C.ScreenWidth, (float)C.ScreenHeight, Projected);
+	}
+	else {
+		ProjectScalar(Streams, m, (float)C.ScreenWidth, (float)C.ScreenHeight, Projected);
+	}
+}
+
+void VertexKernel::ProjectIndexed(const VertexStreams& Streams, const Mat4& Transform, const Camera& C,
+								  const FrameVector<unsigned>& VertexIds, FrameVector<Vec2F>& Projected) {
+	float m[16];
+	FoldMatrix(Transform, C, m);
+
+	if (HasAvx2()) {
+		ProjectIndexedAvx2(Streams, m, (float)C.ScreenWidth, (float)C.ScreenHeight, VertexIds, Projected);
+	}
+	else {
+		ProjectIndexedScalar(Streams, m, (float)C.ScreenWidth, (float)C.ScreenHeight, VertexIds, Projected);
+	}
+}
+
+void VertexKernel::ProjectInstances(const VertexStreams& Streams, const Mat4* Transforms, const unsigned Count,
+									const Camera& C, const FrameVector<unsigned>& VertexIds,
+									FrameVector<Vec2F>& Projected) {
+	FrameVector<float> m(Count * 16);
+	for (unsigned i = 0; i < Count; ++i) {
+		FoldMatrix(Transforms[i], C, &m[i * 16]);
+	}
+
+	if (HasAvx2()) {
+		ProjectInstancesAvx2(Streams, m.data(), Count, (float)C.ScreenWidth, (float)C.ScreenHeight, VertexIds,
+							 Projected);
+	}
+	else {
+		ProjectInstancesScalar(Streams, m.data(), Count, (float)C.ScreenWidth, (float)C.ScreenHeight, VertexIds,
+							   Projected);
+	}
+}
+
+void VertexKernel::EvaluateLights(const VertexStreams& Streams, const Mat4& Transform, const Light* const* Lights,
+								  const unsigned LightCount, const Color& Ambient, const Color* Tint, Vec3F* Result) {
+	if (HasAvx2()) {
+		EvaluateLightsAvx2(Streams, Transform, Lights, LightCount, Ambient, Tint, Result);
+	}
+	else {
+		EvaluateLightsScalar(Streams, Transform, Lights, LightCount, Ambient, Tint, Result);
+	}
+}
+
+void VertexKernel::FoldMatrix(const Mat4& Transform, const Camera& C, float* M) {
+	// Fold the three matrices of Camera::Perspective into one so each vertex only pays for a single transform.
+	auto folded = Transform * C.GetViewMatrix() * C.GetPerspectiveProjection();
+
+	for (unsigned i = 0; i < 16; ++i) {
+		M[i] = folded[i];
+	}
+}
+
+#if defined(__GNUC__) && !defined(_MSC_VER)
+__attribute__((target("avx2")))
+#endif
+void VertexKernel::ProjectAvx2(const VertexStreams& Streams, const float* M, const float Width, const float Height,
+							   std::vector<Vec2F>& Projected) {
+	const auto m0 = _mm256_set1_ps(M[0]), m4 = _mm256_set1_ps(M[4]), m8 = _mm256_set1_ps(M[8]), m12 = _mm256_set1_ps(M[12]);
+	const auto m1 = _mm256_set1_ps(M[1]), m5 = _mm256_set1_ps(M[5]), m9 = _mm256_set1_ps(M[9]), m13 = _mm256_set1_ps(M[13]);
+	const auto m3 = _mm256_set1_ps(M[3]), m7 = _mm256_set1_ps(M[7]), m11 = _mm256_set1_ps(M[11]), m15 = _mm256_set1_ps(M[15]);
+
+	const auto one = _mm256_set1_ps(1.0f);
+	const auto half = _mm256_set1_ps(0.5f);
+	const auto width = _mm256_set1_ps(Width);
+	const auto height = _mm256_set1_ps(Height);
+
+	alignas(32) float sx[VertexStreams::BatchWidth], sy[VertexStreams::BatchWidth], sw[VertexStreams::BatchWidth];
+
+	for (size_t i = 0; i < Streams.Count; i += VertexStreams::BatchWidth) {
+		const auto x = _mm256_load_ps(&Streams.PosX[i]);
+		const auto y = _mm256_load_ps(&Streams.PosY[i]);
+		const auto z = _mm256_load_ps(&Streams.PosZ[i]);
+
+		const auto clipX = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, x), _mm256_mul_ps(m4, y)),
+													   _mm256_mul_ps(m8, z)), m12);
+		const auto clipY = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m1, x), _mm256_mul_ps(m5, y)),
+													   _mm256_mul_ps(m9, z)), m13);
+		const auto clipW = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m3, x), _mm256_mul_ps(m7, y)),
+													   _mm256_mul_ps(m11, z)), m15);
+
+		// Same screen mapping as Camera::Perspective.
+		const auto ndcX = _mm256_div_ps(clipX, clipW);
+		const auto ndcY = _mm256_div_ps(clipY, clipW);
+		_mm256_store_ps(sx, _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ndcX, half), half), width));
+		_mm256_store_ps(sy, _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(_mm256_mul_ps(ndcY, half), half)), height));
+		_mm256_store_ps(sw, clipW);
+
+		const auto count = Streams.Count - i < VertexStreams::BatchWidth ? Streams.Count - i : VertexStreams::BatchWidth;
+		for (size_t lane = 0; lane < count; ++lane) {
+			auto& p = Projected[i + lane];
+			p.X = sx[lane];
+			p.Y = sy[lane];
+			p.Z = sw[lane];
+		}
+	}
+}
+
+void VertexKernel::ProjectScalar(const VertexStreams& Streams, const float* M, const float Width, const float Height,
+								 std::vector<Vec2F>& Projected) {
+	for (size_t i = 0; i < Streams.Count; ++i) {
+		const auto x = Streams.PosX[i];
+		const auto y = Streams.PosY[i];
+		const auto z = Streams.PosZ[i];
+
+		const auto clipX = M[0] * x + M[4] * y + M[8] * z + M[12];
+		const auto clipY = M[1] * x + M[5] * y + M[9] * z + M[13];
+		const auto clipW = M[3] * x + M[7] * y + M[11] * z + M[15];
+
+		auto& p = Projected[i];
+		p.X = (clipX / clipW * 0.5f + 0.5f) * Width;
+		p.Y = (1.0f - (clipY / clipW * 0.5f + 0.5f)) * Height;
+		p.Z = clipW;
+	}
+}
+
+#if defined(__GNUC__) && !defined(_MSC_VER)
+__attribute__((target("avx2")))
+#endif
+void VertexKernel::ProjectIndexedAvx2(const VertexStreams& Streams, const float* M, const float Width,
+									  const float Height, const FrameVector<unsigned>& VertexIds,
+									  FrameVector<Vec2F>& Projected) {
+	const auto m0 = _mm256_set1_ps(M[0]), m4 = _mm256_set1_ps(M[4]), m8 = _mm256_set1_ps(M[8]), m12 = _mm256_set1_ps(M[12]);
+	const auto m1 = _mm256_set1_ps(M[1]), m5 = _mm256_set1_ps(M[5]), m9 = _mm256_set1_ps(M[9]), m13 = _mm256_set1_ps(M[13]);
+	const auto m3 = _mm256_set1_ps(M[3]), m7 = _mm256_set1_ps(M[7]), m11 = _mm256_set1_ps(M[11]), m15 = _mm256_set1_ps(M[15]);
+
+	const auto one = _mm256_set1_ps(1.0f);
+	const auto half = _mm256_set1_ps(0.5f);
+	const auto width = _mm256_set1_ps(Width);
+	const auto height = _mm256_set1_ps(Height);
+
+	alignas(32) int ids[VertexStreams::BatchWidth];
+	alignas(32) float sx[VertexStreams::BatchWidth], sy[VertexStreams::BatchWidth], sw[VertexStreams::BatchWidth];
+
+	for (size_t i = 0; i < VertexIds.size(); i += VertexStreams::BatchWidth) {
+		// The last batch repeats its first vertex to fill the lanes.
+		const auto count = VertexIds.size() - i < VertexStreams::BatchWidth ? VertexIds.size() - i : VertexStreams::BatchWidth;
+		for (size_t lane = 0; lane < VertexStreams::BatchWidth; ++lane) {
+			ids[lane] = (int)VertexIds[i + (lane < count ? lane : 0)];
+		}
+
+		const auto index = _mm256_load_si256(reinterpret_cast<const __m256i*>(ids));
+		const auto x = _mm256_i32gather_ps(Streams.PosX.data(), index, 4);
+		const auto y = _mm256_i32gather_ps(Streams.PosY.data(), index, 4);
+		const auto z = _mm256_i32gather_ps(Streams.PosZ.data(), index, 4);
+
+		const auto clipX = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, x), _mm256_mul_ps(m4, y)),
+													   _mm256_mul_ps(m8, z)), m12);
+		const auto clipY = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m1, x), _mm256_mul_ps(m5, y)),
+													   _mm256_mul_ps(m9, z)), m13);
+		const auto clipW = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m3, x), _mm256_mul_ps(m7, y)),
+													   _mm256_mul_ps(m11, z)), m15);
+
+		const auto ndcX = _mm256_div_ps(clipX, clipW);
+		const auto ndcY = _mm256_div_ps(clipY, clipW);
+		_mm256_store_ps(sx, _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ndcX, half), half), width));
+		_mm256_store_ps(sy, _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(_mm256_mul_ps(ndcY, half), half)), height));
+		_mm256_store_ps(sw, clipW);
+
+		for (size_t lane = 0; lane < count; ++lane) {
+			auto& p = Projected[ids[lane]];
+			p.X = sx[lane];
+			p.Y = sy[lane];
+			p.Z = sw[lane];
+		}
+	}
+}
+
+void VertexKernel::ProjectIndexedScalar(const VertexStreams& Streams, const float* M, const float Width,
+										const float Height, const FrameVector<unsigned>& VertexIds,
+										FrameVector<Vec2F>& Projected) {
+	for (const auto id : VertexIds) {
+		const auto x = Streams.PosX[id];
+		const auto y = Streams.PosY[id];
+		const auto z = Streams.PosZ[id];
+
+		const auto clipX = M[0] * x + M[4] * y + M[8] * z + M[12];
+		const auto clipY = M[1] * x + M[5] * y + M[9] * z + M[13];
+		const auto clipW = M[3] * x + M[7] * y + M[11] * z + M[15];
+
+		auto& p = Projected[id];
+		p.X = (clipX / clipW * 0.5f + 0.5f) * Width;
+		p.Y = (1.0f - (clipY / clipW * 0.5f + 0.5f)) * Height;
+		p.Z = clipW;
+	}
+}
+
+#if defined(__GNUC__) && !defined(_MSC_VER)
+__attribute__((target("avx2")))
+#endif
+void VertexKernel::ProjectInstancesAvx2(const VertexStreams& Streams, const float* M, const unsigned Count,
+										const float Width, const float Height, const FrameVector<unsigned>& VertexIds,
+										FrameVector<Vec2F>& Projected) {
+	const auto one = _mm256_set1_ps(1.0f);
+	const auto half = _mm256_set1_ps(0.5f);
+	const auto width = _mm256_set1_ps(Width);
+	const auto height = _mm256_set1_ps(Height);
+
+	alignas(32) int ids[VertexStreams::BatchWidth];
+	alignas(32) float sx[VertexStreams::BatchWidth], sy[VertexStreams::BatchWidth], sw[VertexStreams::BatchWidth];
+
+	for (size_t i = 0; i < VertexIds.size(); i += VertexStreams::BatchWidth) {
+		// The last batch repeats its first vertex to fill the lanes.
+		const auto count = VertexIds.size() - i < VertexStreams::BatchWidth ? VertexIds.size() - i : VertexStreams::BatchWidth;
+		for (size_t lane = 0; lane < VertexStreams::BatchWidth; ++lane) {
+			ids[lane] = (int)VertexIds[i + (lane < count ? lane : 0)];
+		}
+
+		const auto index = _mm256_load_si256(reinterpret_cast<const __m256i*>(ids));
+		const auto x = _mm256_i32gather_ps(Streams.PosX.data(), index, 4);
+		const auto y = _mm256_i32gather_ps(Streams.PosY.data(), index, 4);
+		const auto z = _mm256_i32gather_ps(Streams.PosZ.data(), index, 4);
+
+		for (unsigned instance = 0; instance < Count; ++instance) {
+			const auto* m = M + instance * 16;
+			const auto clipX = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[0]), x),
+																		 _mm256_mul_ps(_mm256_set1_ps(m[4]), y)),
+														   _mm256_mul_ps(_mm256_set1_ps(m[8]), z)), _mm256_set1_ps(m[12]));
+			const auto clipY = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[1]), x),
+																		 _mm256_mul_ps(_mm256_set1_ps(m[5]), y)),
+														   _mm256_mul_ps(_mm256_set1_ps(m[9]), z)), _mm256_set1_ps(m[13]));
+			const auto clipW = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m[3]), x),
+																		 _mm256_mul_ps(_mm256_set1_ps(m[7]), y)),
+														   _mm256_mul_ps(_mm256_set1_ps(m[11]), z)), _mm256_set1_ps(m[15]));
+
+			const auto ndcX = _mm256_div_ps(clipX, clipW);
+			const auto ndcY = _mm256_div_ps(clipY, clipW);
+			_mm256_store_ps(sx, _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ndcX, half), half), width));
+			_mm256_store_ps(sy, _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(_mm256_mul_ps(ndcY, half), half)), height));
+			_mm256_store_ps(sw, clipW);
+
+			auto* projected = &Projected[instance * Streams.Count];
+			for (size_t lane = 0; lane < count; ++lane) {
+				auto& p = projected[ids[lane]];
+				p.X = sx[lane];
+				p.Y = sy[lane];
+				p.Z = sw[lane];
+			}
+		}
+	}
+}
+
+void VertexKernel::ProjectInstancesScalar(const VertexStreams& Streams, const float* M, const unsigned Count,
+										  const float Width, const float Height,
+										  const FrameVector<unsigned>& VertexIds, FrameVector<Vec2F>& Projected) {
+	for (const auto id : VertexIds) {
+		const auto x = Streams.PosX[id];
+		const auto y = Streams.PosY[id];
+		const auto z = Streams.PosZ[id];
+
+		for (unsigned instance = 0; instance < Count; ++instance) {
+			const auto* m = M + instance * 16;
+			const auto clipX = m[0] * x + m[4] * y + m[8] * z + m[12];
+			const auto clipY = m[1] * x + m[5] * y + m[9] * z + m[13];
+			const auto clipW = m[3] * x + m[7] * y + m[11] * z + m[15];
+
+			auto& p = Projected[instance * Streams.Count + id];
+			p.X = (clipX / clipW * 0.5f + 0.5f) * Width;
+			p.Y = (1.0f - (clipY / clipW * 0.5f + 0.5f)) * Height;
+			p.Z = clipW;
+		}
+	}
+}
+
+#if defined(__GNUC__) && !defined(_MSC_VER)
+__attribute__((target("avx2")))
+#endif
+void VertexKernel::EvaluateLightsAvx2(const VertexStreams& Streams, const Mat4& Transform, const Light* const* Lights,
+									  const unsigned LightCount, const Color& Ambient, const Color* Tint,
+									  Vec3F* Result) {
+	auto transform = Transform;
+	const auto m0 = _mm256_set1_ps(transform[0]), m4 = _mm256_set1_ps(transform[4]), m8 = _mm256_set1_ps(transform[8]), m12 = _mm256_set1_ps(transform[12]);
+	const auto m1 = _mm256_set1_ps(transform[1]), m5 = _mm256_set1_ps(transform[5]), m9 = _mm256_set1_ps(transform[9]), m13 = _mm256_set1_ps(transform[13]);
+	const auto m2 = _mm256_set1_ps(transform[2]), m6 = _mm256_set1_ps(transform[6]), m10 = _mm256_set1_ps(transform[10]), m14 = _mm256_set1_ps(transform[14]);
+
+	FrameVector<BatchLight> lights(LightCount);
+	for (unsigned l = 0; l < LightCount; ++l) {
+		const auto& light = *Lights[l];
+		const auto color = light.LightColor * light.Intensity;
+		const auto direction = light.Type == LightType::Directional ? light.Direction * -1.0f : light.Direction;
+
+		auto& b = lights[l];
+		b.Type = light.Type;
+		b.R = color.R;
+		b.G = color.G;
+		b.B = color.B;
+		b.PosX = light.Position.X;
+		b.PosY = light.Position.Y;
+		b.PosZ = light.Position.Z;
+		b.DirX = direction.X;
+		b.DirY = direction.Y;
+		b.DirZ = direction.Z;
+		b.Radius = light.Radius;
+		b.OuterCone = light.OuterCone;
+		b.ConeRange = Max(light.InnerCone - light.OuterCone, 0.0001f);
+		b.Brightness = light.Brightness;
+	}
+
+	const auto zero = _mm256_setzero_ps();
+	const auto one = _mm256_set1_ps(1.0f);
+	const auto full = _mm256_set1_ps(255.0f);
+	const auto sign = _mm256_set1_ps(-0.0f);
+
+	alignas(32) float lr[VertexStreams::BatchWidth], lg[VertexStreams::BatchWidth], lb[VertexStreams::BatchWidth];
+
+	for (size_t i = 0; i < Streams.Count; i += VertexStreams::BatchWidth) {
+		// World space like Shader::GetWorldSpace, normals skip the translation and are normalized when not zero.
+		const auto x = _mm256_load_ps(&Streams.PosX[i]);
+		const auto y = _mm256_load_ps(&Streams.PosY[i]);
+		const auto z = _mm256_load_ps(&Streams.PosZ[i]);
+		const auto wx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, x), _mm256_mul_ps(m4, y)), _mm256_mul_ps(m8, z)), m12);
+		const auto wy = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m1, x), _mm256_mul_ps(m5, y)), _mm256_mul_ps(m9, z)), m13);
+		const auto wz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m2, x), _mm256_mul_ps(m6, y)), _mm256_mul_ps(m10, z)), m14);
+
+		const auto normX = _mm256_load_ps(&Streams.NormX[i]);
+		const auto normY = _mm256_load_ps(&Streams.NormY[i]);
+		const auto normZ = _mm256_load_ps(&Streams.NormZ[i]);
+		auto nx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, normX), _mm256_mul_ps(m4, normY)), _mm256_mul_ps(m8, normZ));
+		auto ny = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m1, normX), _mm256_mul_ps(m5, normY)), _mm256_mul_ps(m9, normZ));
+		auto nz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m2, normX), _mm256_mul_ps(m6, normY)), _mm256_mul_ps(m10, normZ));
+		const auto normalLength = _mm256_sqrt_ps(Dot(nx, ny, nz, nx, ny, nz));
+		const auto hasNormal = _mm256_cmp_ps(normalLength, zero, _CMP_GT_OQ);
+		nx = _mm256_blendv_ps(nx, _mm256_div_ps(nx, normalLength), hasNormal);
+		ny = _mm256_blendv_ps(ny, _mm256_div_ps(ny, normalLength), hasNormal);
+		nz = _mm256_blendv_ps(nz, _mm256_div_ps(nz, normalLength), hasNormal);
+
+		auto albedoR = _mm256_load_ps(&Streams.ColorR[i]);
+		auto albedoG = _mm256_load_ps(&Streams.ColorG[i]);
+		auto albedoB = _mm256_load_ps(&Streams.ColorB[i]);
+		if (Tint) {
+			albedoR = ClampColor(_mm256_div_ps(_mm256_mul_ps(albedoR, _mm256_set1_ps(Tint->R)), full));
+			albedoG = ClampColor(_mm256_div_ps(_mm256_mul_ps(albedoG, _mm256_set1_ps(Tint->G)), full));
+			albedoB = ClampColor(_mm256_div_ps(_mm256_mul_ps(albedoB, _mm256_set1_ps(Tint->B)), full));
+		}
+
+		auto sumR = zero, sumG = zero, sumB = zero;
+		for (const auto& light : lights) {
+			// Every step clamps to 0-255 the way the Color operators of Light::Evaluate do.
+			auto r = ClampColor(_mm256_mul_ps(_mm256_set1_ps(light.R), albedoR));
+			auto g = ClampColor(_mm256_mul_ps(_mm256_set1_ps(light.G), albedoG));
+			auto b = ClampColor(_mm256_mul_ps(_mm256_set1_ps(light.B), albedoB));
+
+			const auto dirX = _mm256_set1_ps(light.DirX);
+			const auto dirY = _mm256_set1_ps(light.DirY);
+			const auto dirZ = _mm256_set1_ps(light.DirZ);
+
+			auto mask = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			if (light.Type == LightType::Directional) {
+				const auto ratio = ClampUnit(Dot(dirX, dirY, dirZ, nx, ny, nz));
+				r = ClampColor(_mm256_mul_ps(r, ratio));
+				g = ClampColor(_mm256_mul_ps(g, ratio));
+				b = ClampColor(_mm256_mul_ps(b, ratio));
+			}
+			else {
+				auto tx = _mm256_sub_ps(_mm256_set1_ps(light.PosX), wx);
+				auto ty = _mm256_sub_ps(_mm256_set1_ps(light.PosY), wy);
+				auto tz = _mm256_sub_ps(_mm256_set1_ps(light.PosZ), wz);
+				const auto distance = _mm256_sqrt_ps(Dot(tx, ty, tz, tx, ty, tz));
+				const auto radius = _mm256_set1_ps(light.Radius);
+
+				const auto attenuation = _mm256_sub_ps(one, ClampUnit(_mm256_div_ps(distance, radius)));
+				const auto hasDistance = _mm256_cmp_ps(distance, zero, _CMP_GT_OQ);
+				tx = _mm256_blendv_ps(tx, _mm256_div_ps(tx, distance), hasDistance);
+				ty = _mm256_blendv_ps(ty, _mm256_div_ps(ty, distance), hasDistance);
+				tz = _mm256_blendv_ps(tz, _mm256_div_ps(tz, distance), hasDistance);
+
+				const auto ratio = ClampUnit(Dot(tx, ty, tz, nx, ny, nz));
+				mask = _mm256_and_ps(_mm256_cmp_ps(distance, radius, _CMP_LT_OQ), _mm256_cmp_ps(ratio, zero, _CMP_GT_OQ));
+
+				const auto falloff = _mm256_mul_ps(attenuation, attenuation);
+				r = ClampColor(_mm256_mul_ps(ClampColor(_mm256_mul_ps(r, ratio)), falloff));
+				g = ClampColor(_mm256_mul_ps(ClampColor(_mm256_mul_ps(g, ratio)), falloff));
+				b = ClampColor(_mm256_mul_ps(ClampColor(_mm256_mul_ps(b, ratio)), falloff));
+
+				if (light.Type == LightType::Spot) {
+					const auto cosAngle = Dot(_mm256_xor_ps(tx, sign), _mm256_xor_ps(ty, sign), _mm256_xor_ps(tz, sign),
+											  dirX, dirY, dirZ);
+					const auto cone = ClampUnit(_mm256_div_ps(_mm256_sub_ps(cosAngle, _mm256_set1_ps(light.OuterCone)),
+															  _mm256_set1_ps(light.ConeRange)));
+					r = ClampColor(_mm256_mul_ps(r, cone));
+					g = ClampColor(_mm256_mul_ps(g, cone));
+					b = ClampColor(_mm256_mul_ps(b, cone));
+				}
+			}
+
+			const auto brightness = _mm256_set1_ps(light.Brightness);
+			sumR = ClampColor(_mm256_add_ps(sumR, _mm256_and_ps(ClampColor(_mm256_mul_ps(r, brightness)), mask)));
+			sumG = ClampColor(_mm256_add_ps(sumG, _mm256_and_ps(ClampColor(_mm256_mul_ps(g, brightness)), mask)));
+			sumB = ClampColor(_mm256_add_ps(sumB, _mm256_and_ps(ClampColor(_mm256_mul_ps(b, brightness)), mask)));
+		}
+
+		sumR = ClampColor(_mm256_add_ps(sumR, _mm256_set1_ps(Ambient.R)));
+		sumG = ClampColor(_mm256_add_ps(sumG, _mm256_set1_ps(Ambient.G)));
+		sumB = ClampColor(_mm256_add_ps(sumB, _mm256_set1_ps(Ambient.B)));
+		_mm256_store_ps(lr, _mm256_div_ps(sumR, full));
+		_mm256_store_ps(lg, _mm256_div_ps(sumG, full));
+		_mm256_store_ps(lb, _mm256_div_ps(sumB, full));
+
+		const auto count = Streams.Count - i < VertexStreams::BatchWidth ? Streams.Count - i : VertexStreams::BatchWidth;
+		for (size_t lane = 0; lane < count; ++lane) {
+			Result[i + lane] = {lr[lane], lg[lane], lb[lane]};
+		}
+	}
+}
+
+void VertexKernel::EvaluateLightsScalar(const VertexStreams& Streams, const Mat4& Transform, const Light* const* Lights,
+										const unsigned LightCount, const Color& Ambient, const Color* Tint,
+										Vec3F* Result) {
+	for (size_t i = 0; i < Streams.Count; ++i) {
+		// World space like Shader::GetWorldSpace.
+		const auto pos = Transform.Project({Streams.PosX[i], Streams.PosY[i], Streams.PosZ[i]});
+		Vec3F norm(Streams.NormX[i], Streams.NormY[i], Streams.NormZ[i]);
+		norm.W = 0.0f;
+		auto normal = Transform.Project(norm);
+		if (normal.Length() > 0.0f) Vec3F::Normalize(normal);
+
+		auto albedo = Color(255.0f, Streams.ColorR[i], Streams.ColorG[i], Streams.ColorB[i]);
+		if (Tint) albedo = Color::Modulate(albedo, *Tint);
+
+		Color sum{0, 0, 0, 0};
+		for (unsigned l = 0; l < LightCount; ++l) {
+			sum += Lights[l]->Evaluate(pos, normal, albedo);
+		}
+		sum += Ambient;
+
+		Result[i] = {sum.R / 255.0f, sum.G / 255.0f, sum.B / 255.0f};
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+
+#include "FrameArena.h"
+
+struct Camera;
+struct Color;
+struct Light;
+struct Mat4;
+struct Vec2F;
+struct Vec3F;
+struct VertexStreams;
+
+/**
+ * \brief Batched vertex transforms and lighting over VertexStreams. Runs eight vertices at a time with AVX2 when the
+ * processor supports it and falls back to the same math one vertex at a time otherwise.
+ */
+class VertexKernel
+{
+public:
+	/**
+	 * \brief Projects every vertex to the screen through one folded world, view and projection matrix.
+	 * \param Projected Receives the screen positions with the view depth in Z, one per vertex.
+	 */
+	static void Project(const VertexStreams& Streams, const Mat4& Transform, const Camera& C,
+						std::vector<Vec2F>& Projected);
+
+	/**
+	 * \brief Projects only the listed vertices, gathering their positions eight at a time.
+	 * \param VertexIds Vertices to project.
+	 * \param Projected Receives the screen position of each listed vertex at its vertex index, must already hold
+	 * every vertex.
+	 */
+	static void ProjectIndexed(const VertexStreams& Streams, const Mat4& Transform, const Camera& C,
+							   const FrameVector<unsigned>& VertexIds, FrameVector<Vec2F>& Projected);
+
+	/**
+	 * \brief Projects the listed vertices once for every instance of a mesh. Each batch of positions is gathered once
+	 * and run through the folded matrix of every instance while it is still in registers.
+	 * \param Transforms Model to world transform of every instance.
+	 * \param Projected Receives the screen position of vertex v of instance i at i * Streams.Count + v, must already
+	 * hold Count * Streams.Count entries.
+	 */
+	static void ProjectInstances(const VertexStreams& Streams, const Mat4* Transforms, unsigned Count, const Camera& C,
+								 const FrameVector<unsigned>& VertexIds, FrameVector<Vec2F>& Projected);
+
+	/**
+	 * \brief Lights every vertex with the given lights and ambient from the position, normal and color streams, the
+	 * same sum as LightRegistry::EvaluateStatic with each vertex color as albedo, down to the clamping of every step.
+	 * \param Transform Model to world transform of the vertices.
+	 * \param Lights Lights to sum, their Evaluate is what the kernel reproduces.
+	 * \param Ambient Ambient color already scaled by its intensity.
+	 * \param Tint Multiplied into the vertex colors first like Color::Modulate, or nullptr to use them as they are.
+	 * \param Result Receives the light of every vertex in 0-1, must hold Streams.Count entries.
+	 */
+	static void EvaluateLights(const VertexStreams& Streams, const Mat4& Transform, const Light* const* Lights,
+							   unsigned LightCount, const Color& Ambient, const Color* Tint, Vec3F* Result);
+
+	/**
+	 * \brief Checks once whether the processor and OS support the AVX2 kernels.
+	 */
+	static bool HasAvx2();
+
+private:
+	static void ProjectAvx2(const VertexStreams& Streams, const float* M, float Width, float Height,
+							std::vector<Vec2F>& Projected);
+
+	static void ProjectScalar(const VertexStreams& Streams, const float* M, float Width, float Height,
+							  std::vector<Vec2F>& Projected);
+
+	static void ProjectIndexedAvx2(const VertexStreams& Streams, const float* M, float Width, float Height,
+								   const FrameVector<unsigned>& VertexIds, FrameVector<Vec2F>& Projected);
+
+	static void ProjectIndexedScalar(const VertexStreams& Streams, const float* M, float Width, float Height,
+									 const FrameVector<unsigned>& VertexIds, FrameVector<Vec2F>& Projected);
+
+	static void ProjectInstancesAvx2(const VertexStreams& Streams, const float* M, unsigned Count, float Width,
+									 float Height, const FrameVector<unsigned>& VertexIds,
+									 FrameVector<Vec2F>& Projected);
+
+	static void ProjectInstancesScalar(const VertexStreams& Streams, const float* M, unsigned Count, float Width,
+									   float Height, const FrameVector<unsigned>& VertexIds,
+									   FrameVector<Vec2F>& Projected);
+
+	static void EvaluateLightsAvx2(const VertexStreams& Streams, const Mat4& Transform, const Light* const* Lights,
+								   unsigned LightCount, const Color& Ambient, const Color* Tint, Vec3F* Result);
+
+	static void EvaluateLightsScalar(const VertexStreams& Streams, const Mat4& Transform, const Light* const* Lights,
+									 unsigned LightCount, const Color& Ambient, const Color* Tint, Vec3F* Result);
+
+	/**
+	 * \brief Folds the world, view and projection matrices into one.
+	 */
+	static void FoldMatrix(const Mat4& Transform, const Camera& C, float* M);
+};
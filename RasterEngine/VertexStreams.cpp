@@ -0,0 +1,37 @@
+#include "VertexStreams.h"
+
+#include "EngineDefines.h"
+
+VertexStreams VertexStreams::Build(const std::vector<Vert>& Vertices, const std::vector<Vec2F>& Uv) {
+	VertexStreams s;
+	s.Count = Vertices.size();
+	s.CornerCount = Uv.size();
+
+	const auto padded = Padded(s.Count);
+	for (auto* stream : {&s.PosX, &s.PosY, &s.PosZ, &s.NormX, &s.NormY, &s.NormZ, &s.ColorR, &s.ColorG, &s.ColorB}) {
+		stream->assign(padded, 0.0f);
+	}
+
+	for (size_t i = 0; i < s.Count; ++i) {
+		const auto& v = Vertices[i];
+		s.PosX[i] = v.Pos.X;
+		s.PosY[i] = v.Pos.Y;
+		s.PosZ[i] = v.Pos.Z;
+		s.NormX[i] = v.Norm.X;
+		s.NormY[i] = v.Norm.Y;
+		s.NormZ[i] = v.Norm.Z;
+		s.ColorR[i] = v.C.R;
+		s.ColorG[i] = v.C.G;
+		s.ColorB[i] = v.C.B;
+	}
+
+	const auto paddedCorners = Padded(s.CornerCount);
+	s.U.assign(paddedCorners, 0.0f);
+	s.V.assign(paddedCorners, 0.0f);
+	for (size_t i = 0; i < s.CornerCount; ++i) {
+		s.U[i] = Uv[i].X;
+		s.V[i] = Uv[i].Y;
+	}
+
+	return s;
+}
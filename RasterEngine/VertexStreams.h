@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+struct Vert;
+struct Vec2F;
+
+/**
+ * \brief Allocator handing out memory aligned for full width vector loads.
+ */
+template<typename T, size_t Alignment>
+struct AlignedAllocator {
+	using value_type = T;
+
+	template<typename U>
+	struct rebind {
+		using other = AlignedAllocator<U, Alignment>;
+	};
+
+	AlignedAllocator() = default;
+
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(const size_t Count) {
+#ifdef _MSC_VER
+		void* pointer = _aligned_malloc(Count * sizeof(T), Alignment);
+#else
+		void* pointer = aligned_alloc(Alignment, (Count * sizeof(T) + Alignment - 1) / Alignment * Alignment);
+#endif
+		if (!pointer) throw std::bad_alloc();
+
+		return static_cast<T*>(pointer);
+	}
+
+	void deallocate(T* Pointer, size_t) {
+#ifdef _MSC_VER
+		_aligned_free(Pointer);
+#else
+		free(Pointer);
+#endif
+	}
+
+	template<typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+
+	template<typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+/**
+ * \brief Structure of arrays copy of a meshes vertices for the batched vertex kernels. Every stream is 32 byte aligned
+ * and padded with zeroes to a multiple of the batch width, so kernels never need a scalar tail.
+ */
+struct VertexStreams {
+	static constexpr size_t BatchWidth = 8;
+
+	using Stream = std::vector<float, AlignedAllocator<float, 32>>;
+
+	// Number of real vertices, the streams hold this rounded up to the batch width.
+	size_t Count = 0;
+
+	Stream PosX, PosY, PosZ;
+	Stream NormX, NormY, NormZ;
+
+	// Vertex colors in 0-255, the albedo the lighting kernel reads.
+	Stream ColorR, ColorG, ColorB;
+
+	// Texture coordinates are stored per triangle corner like StaticMesh::Uv, padded the same way.
+	size_t CornerCount = 0;
+	Stream U, V;
+
+	/**
+	 * \brief Splits AoS vertices and corner uvs into padded streams.
+	 */
+	static VertexStreams Build(const std::vector<Vert>& Vertices, const std::vector<Vec2F>& Uv);
+
+	static size_t Padded(size_t Count) {
+		return (Count + BatchWidth - 1) / BatchWidth * BatchWidth;
+	}
+};
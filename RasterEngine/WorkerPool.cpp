@@ -0,0 +1,62 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(const unsigned ThreadCount): CurrentJob(nullptr), CurrentContext(nullptr), Generation(0),
+													Busy(0), IsStopping(false) {
+	Threads.reserve(ThreadCount);
+	for (unsigned i = 0; i < ThreadCount; ++i) {
+		Threads.emplace_back(&WorkerPool::WorkerLoop, this);
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(Mux);
+		IsStopping = true;
+	}
+	WakeUp.notify_all();
+
+	for (auto& thread : Threads) {
+		thread.join();
+	}
+}
+
+unsigned WorkerPool::GetThreadCount() const {
+	return (unsigned)Threads.size() + 1;
+}
+
+void WorkerPool::Dispatch(void (*Job)(const void*), const void* Context) {
+	{
+		std::lock_guard<std::mutex> lock(Mux);
+		CurrentJob = Job;
+		CurrentContext = Context;
+		Busy = (unsigned)Threads.size();
+		Generation++;
+	}
+	WakeUp.notify_all();
+
+	Job(Context);
+
+	// The job lives on the callers stack, no worker may still be running it once this returns.
+	std::unique_lock<std::mutex> lock(Mux);
+	Finished.wait(lock, [this] { return Busy == 0; });
+}
+
+void WorkerPool::WorkerLoop() {
+	uint64_t lastGeneration = 0;
+
+	std::unique_lock<std::mutex> lock(Mux);
+	while (true) {
+		WakeUp.wait(lock, [this, lastGeneration] { return IsStopping || Generation != lastGeneration; });
+		if (IsStopping) return;
+
+		lastGeneration = Generation;
+		const auto job = CurrentJob;
+		const auto context = CurrentContext;
+
+		lock.unlock();
+		job(context);
+		lock.lock();
+
+		if (--Busy == 0) Finished.notify_one();
+	}
+}
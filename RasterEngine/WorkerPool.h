@@ -0,0 +1,58 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief Worker threads that are started once and woken to run a job together. Starting threads costs far more than
+ * the work handed to them each frame, and workers that outlive a frame keep their thread local caches warm.
+ */
+class WorkerPool
+{
+public:
+	/**
+	 * \param ThreadCount Number of workers, the thread calling Run works alongside them.
+	 */
+	explicit WorkerPool(unsigned ThreadCount);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	/**
+	 * \brief Runs a job on every worker and the calling thread at once, returning when all of them are done. Jobs
+	 * split the work between themselves, usually through an atomic counter.
+	 * \param J Called without arguments, referenced rather than copied so running never allocates.
+	 */
+	template<typename Job>
+	void Run(const Job& J) {
+		Dispatch([](const void* Context) { (*static_cast<const Job*>(Context))(); }, &J);
+	}
+
+	/**
+	 * \return Number of threads running a job, counting the caller.
+	 */
+	unsigned GetThreadCount() const;
+
+private:
+	std::vector<std::thread> Threads;
+
+	std::mutex Mux;
+	std::condition_variable WakeUp;
+	std::condition_variable Finished;
+
+	// Job of the current run, Generation changes with every run so each worker runs it exactly once.
+	void (*CurrentJob)(const void*);
+	const void* CurrentContext;
+	uint64_t Generation;
+
+	// Workers still running the current job.
+	unsigned Busy;
+
+	bool IsStopping;
+
+	void Dispatch(void (*Job)(const void*), const void* Context);
+	void WorkerLoop();
+};